@@ -0,0 +1,284 @@
+#include "CBatchPipeline.h"
+#include "CBoundedQueue.h"
+#include "CImage.h"
+#include "CMappedFile.h"
+#include "CNetpbm.h"
+#include "CSparseEdges.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QThread>
+
+struct CBatchJob
+{
+    CMappedFile * mapped;                   // Backs input for PGM and PPM files, else 0
+    QImage input, output;
+    CMatrix<uchar> * edges;                 // Instead of output, when it is written as a mapped PGM
+    CSparseEdges * sparse;                  // Instead of output, for the "edges" format
+    QString cacheKey;                       // Empty without a cache
+    CBatchImageStats stats;
+
+    CBatchJob() : mapped(0), edges(0), sparse(0) {}
+    ~CBatchJob() { input = QImage(); delete mapped; delete edges; delete sparse; }
+};
+
+CBatchOptions::CBatchOptions()
+        : sigma(1), useR(true), useG(true), useB(true),
+          thresholdLow(0.007), thresholdHigh(0.099), autoThresholds(false), thresholdRule(CMagnitudeHistogram::RulePercentile),
+          highPercentile(0.8), lowRatio(0.4), precision(CImage::PrecisionDouble),
+          gradientOperator(CImage::OperatorPrewitt), pyramid(false),
+          workers(qMax(1, QThread::idealThreadCount())), threadsPerImage(1), queueDepth(4),
+          outputFormat("png"), dumpSuppressed(false), profiler(0), cache(0)
+{
+}
+
+CBatchPipeline::CBatchPipeline(const CBatchOptions& options)
+        : mOptions(options), mWallSeconds(0)
+{
+}
+
+// What shapes mSuppressed besides sigma and the channels; a pyramid with no level to halve to is canny() in double
+static QString cacheVariant(const CBatchOptions& options)
+{
+    if(!options.pyramid) return CImage::cacheVariant(options.precision, options.gradientOperator);
+    if(CImage::pyramidLevel(options.sigma) == 0) return CImage::cacheVariant(CImage::PrecisionDouble);
+    return CImage::pyramidCacheVariant(CIMAGE_PYRAMID_FLAG);
+}
+
+void CBatchPipeline::run(const QStringList& files)
+{
+    QElapsedTimer wall;
+    wall.start();
+
+    if(!mOptions.outputDir.isEmpty())
+        QDir().mkpath(mOptions.outputDir);
+
+    QMap<QString, QString> clashes;
+    if(!mOptions.outputDir.isEmpty())
+        clashes = outputClashes(files);
+
+    CBoundedQueue<CBatchJob*> decoded(mOptions.queueDepth), computed(mOptions.queueDepth);
+    QAtomicInt computing(qMax(1u, mOptions.workers));
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1u, mOptions.workers) + 1);
+
+    pool.start(newTask([&]() {
+        for(int i = 0; i < files.size(); i++) {
+            CBatchJob * job = new CBatchJob();
+            job->stats.path = files[i];
+            job->stats.ok = false;
+            job->stats.width = job->stats.height = 0;
+            job->stats.thresholdLow = mOptions.thresholdLow;
+            job->stats.thresholdHigh = mOptions.thresholdHigh;
+            job->stats.computeSeconds = job->stats.encodeSeconds = 0;
+            job->stats.cached = false;
+            if(clashes.contains(files[i])) {
+                job->stats.error = "output name already taken by " + clashes.value(files[i]);
+                decoded.push(job);
+                continue;
+            }
+
+            // A mapped file is hashed in place; other files are read once more, which is still cheaper than decoding
+            QElapsedTimer timer;
+            timer.start();
+            bool netpbm = CNetpbmFile::isNetpbm(files[i]), skip = false;
+            if(netpbm) {
+                job->mapped = new CMappedFile();
+                if(job->mapped->mapNetpbm(files[i]))
+                    job->input = job->mapped->image();
+            }
+            if(mOptions.cache != 0 && (!netpbm || !job->input.isNull())) {
+                CStageTimer stage(mOptions.profiler, "sourceHash", 0);
+                QByteArray hash = netpbm ? CSuppressedCache::hashBytes(job->mapped->mMap, job->mapped->mSize)
+                                         : CSuppressedCache::hashFile(files[i]);
+                if(!hash.isEmpty())
+                    job->cacheKey = CSuppressedCache::key(hash, mOptions.sigma, mOptions.useR, mOptions.useG, mOptions.useB,
+                                                          cacheVariant(mOptions));
+                skip = !netpbm && !job->cacheKey.isEmpty() && mOptions.cache->contains(job->cacheKey);
+            }
+            if(!netpbm && !skip)
+                job->input = QImage(files[i]);
+            qint64 ns = timer.nsecsElapsed();
+            job->stats.decodeSeconds = ns / 1e9;
+            if(skip)
+                job->stats.ok = true;
+            else if(job->input.isNull())
+                job->stats.error = job->mapped != 0 ? job->mapped->mError : "could not decode";
+            else {
+                job->stats.ok = true;
+                job->stats.width = job->input.width();
+                job->stats.height = job->input.height();
+                if(mOptions.profiler)
+                    mOptions.profiler->record("decode", ns, (qint64)job->input.bytesPerLine() * job->input.height(),
+                                              (qint64)job->stats.width * job->stats.height, 1);
+            }
+            decoded.push(job);
+        }
+        decoded.close();
+    }));
+
+    for(uint w = 0; w < qMax(1u, mOptions.workers); w++)
+        pool.start(newTask([&]() {
+            // One band pool per worker, shared by its jobs rather than created per image
+            QThreadPool bands;
+            bands.setMaxThreadCount(qMax(1u, mOptions.threadsPerImage));
+            CBatchJob * job;
+            while(decoded.pop(job)) {
+                if(job->stats.ok) {
+                    QElapsedTimer timer;
+                    timer.start();
+                    CImage image(job->input, &bands);
+                    image.mProfiler = mOptions.profiler;
+                    image.mKeepDirection = mOptions.outputFormat == "edges";
+                    job->stats.cached = !job->cacheKey.isEmpty() && mOptions.cache->fetch(job->cacheKey, image);
+                    if(!job->stats.cached) {
+                        // The decoder skipped it as cached, and the entry has been evicted since
+                        if(job->input.isNull())
+                            *image.mImage = *image.mOriginalImage = job->input = QImage(job->stats.path);
+                        if(job->input.isNull()) {
+                            job->stats.ok = false;
+                            job->stats.error = "could not decode";
+                            computed.push(job);
+                            continue;
+                        }
+                        if(mOptions.pyramid)
+                            image.cannyPyramid(mOptions.sigma, mOptions.useR, mOptions.useG, mOptions.useB);
+                        else
+                            image.canny(mOptions.sigma, mOptions.useR, mOptions.useG, mOptions.useB, mOptions.precision,
+                                        mOptions.gradientOperator);
+                        if(!job->cacheKey.isEmpty()) {
+                            image.mCache = mOptions.cache;
+                            image.storeInCache(job->cacheKey);
+                        }
+                    }
+                    job->stats.width = image.mWidth;
+                    job->stats.height = image.mHeight;
+                    if(mOptions.autoThresholds)
+                        image.autoThresholds(mOptions.thresholdRule, job->stats.thresholdLow, job->stats.thresholdHigh,
+                                             mOptions.highPercentile, mOptions.lowRatio);
+                    if(mOptions.dumpSuppressed && !mOptions.outputDir.isEmpty()) {
+                        QString name = outputName(job->stats.path) + "_suppressed.cmat";
+                        if(!image.saveSuppressed(QDir(mOptions.outputDir).filePath(name), &job->stats.error))
+                            job->stats.ok = false;
+                    }
+                    if(mOptions.outputFormat == "edges") {
+                        job->sparse = new CSparseEdges();
+                        image.sparseHysteresis(job->stats.thresholdLow, job->stats.thresholdHigh, *job->sparse);
+                    } else if(mOptions.outputFormat == "pgm")
+                        job->edges = image.hysteresis(*image.mSuppressed, job->stats.thresholdLow, job->stats.thresholdHigh);
+                    else {
+                        CMatrix<uchar> * traced = image.hysteresis(*image.mSuppressed, job->stats.thresholdLow, job->stats.thresholdHigh);
+                        CStageTimer stage(mOptions.profiler, "exportEdges", (qint64)traced->mHeight * traced->mWidth);
+                        QImage * edges = traced->toNewImage();
+                        stage.mBytes = (qint64)edges->bytesPerLine() * edges->height();
+                        stage.stop();
+                        job->output = *edges;
+                        delete edges;
+                        delete traced;
+                    }
+                    job->input = QImage();
+                    delete job->mapped;
+                    job->mapped = 0;
+                    job->stats.computeSeconds = timer.nsecsElapsed() / 1e9;
+                }
+                computed.push(job);
+            }
+            if(!computing.deref())
+                computed.close();
+        }));
+
+    CBatchJob * job;
+    while(computed.pop(job)) {
+        if(job->stats.ok && !mOptions.outputDir.isEmpty()) {
+            QElapsedTimer timer;
+            timer.start();
+            QString name = outputName(job->stats.path) + "_edges." + mOptions.outputFormat;
+            job->stats.outputPath = QDir(mOptions.outputDir).filePath(name);
+            qint64 bytes;
+            if(job->edges != 0) {
+                bytes = (qint64)job->stats.width * job->stats.height;
+                if(!CMappedFile::saveEdges(*job->edges, job->stats.outputPath, &job->stats.error))
+                    job->stats.ok = false;
+            } else if(job->sparse != 0) {
+                bytes = job->sparse->mChainPoints.size() * sizeof(CEdgePoint);
+                if(!job->sparse->save(job->stats.outputPath, &job->stats.error))
+                    job->stats.ok = false;
+            } else {
+                bytes = (qint64)job->output.bytesPerLine() * job->output.height();
+                if(!job->output.save(job->stats.outputPath)) {
+                    job->stats.ok = false;
+                    job->stats.error = "could not write " + job->stats.outputPath;
+                }
+            }
+            qint64 ns = timer.nsecsElapsed();
+            job->stats.encodeSeconds = ns / 1e9;
+            if(mOptions.profiler && job->stats.ok)
+                mOptions.profiler->record("encode", ns, bytes, (qint64)job->stats.width * job->stats.height, 1);
+        }
+        mResults.append(job->stats);
+        if(mOnImageDone) mOnImageDone(job->stats);
+        delete job;
+    }
+
+    pool.waitForDone();
+    mWallSeconds = wall.nsecsElapsed() / 1e9;
+}
+
+uint CBatchPipeline::succeeded() const
+{
+    uint n = 0;
+    for(int i = 0; i < mResults.size(); i++)
+        if(mResults[i].ok) n++;
+    return n;
+}
+
+double CBatchPipeline::megapixels() const
+{
+    double mp = 0;
+    for(int i = 0; i < mResults.size(); i++)
+        if(mResults[i].ok) mp += mResults[i].megapixels();
+    return mp;
+}
+
+QStringList CBatchPipeline::imageNameFilters()
+{
+    return QStringList() << "*.png" << "*.jpg" << "*.jpeg" << "*.bmp" << "*.gif"
+                         << "*.tif" << "*.tiff" << "*.ppm" << "*.pgm" << "*.xpm";
+}
+
+// Directories are replaced by the images directly inside them, sorted by name
+QStringList CBatchPipeline::expandInputs(const QStringList& paths)
+{
+    QStringList files;
+    for(int i = 0; i < paths.size(); i++) {
+        QFileInfo info(paths[i]);
+        if(info.isDir()) {
+            QDir dir(paths[i]);
+            QStringList names = dir.entryList(imageNameFilters(), QDir::Files, QDir::Name);
+            for(int j = 0; j < names.size(); j++)
+                files.append(dir.filePath(names[j]));
+        } else
+            files.append(paths[i]);
+    }
+    return files;
+}
+
+QString CBatchPipeline::outputName(const QString& path)
+{
+    return QFileInfo(path).completeBaseName();
+}
+
+QMap<QString, QString> CBatchPipeline::outputClashes(const QStringList& files)
+{
+    QMap<QString, QString> owners, clashes;
+    for(int i = 0; i < files.size(); i++) {
+        QString name = outputName(files[i]).toLower();
+        if(owners.contains(name))
+            clashes.insert(files[i], owners.value(name));
+        else
+            owners.insert(name, files[i]);
+    }
+    return clashes;
+}
@@ -0,0 +1,80 @@
+#ifndef CBATCHPIPELINE_H
+#define CBATCHPIPELINE_H
+
+#include "globals.h"
+#include "CImage.h"
+#include "CSuppressedCache.h"
+#include <QMap>
+#include <functional>
+
+/* Headless edge detection over many files. Decoding, Canny and encoding run as three stages
+ * connected by bounded queues: one decoder thread, mWorkers compute threads, and the thread
+ * that called run() as the encoder. The queue depth bounds how many decoded frames are in
+ * memory at once, and while one image computes the next is already decoding. Binary PGM and
+ * PPM inputs skip the codecs: they are mapped, and Canny reads the mapped raster. */
+
+struct CBatchOptions
+{
+    double sigma;
+    bool useR, useG, useB;
+    double thresholdLow, thresholdHigh;
+    bool autoThresholds;                    // Per image from its magnitude histogram, instead of the two above
+    CMagnitudeHistogram::Rule thresholdRule;
+    double highPercentile, lowRatio;        // See CMagnitudeHistogram::thresholds
+    CImage::Precision precision;
+    CImage::Operator gradientOperator;
+    bool pyramid;                           // CImage::cannyPyramid, in double with Prewitt whatever the precision and operator
+    uint workers;                           // Images processed concurrently
+    uint threadsPerImage;                   // Row-band threads inside each canny() call
+    uint queueDepth;                        // Frames allowed to wait between two stages
+    QString outputDir;                      // Empty: compute only, write nothing
+    QString outputFormat;                   // Suffix understood by QImage::save; "pgm" is written through a mapping,
+                                            // "edges" as chains (see CSparseEdges)
+    bool dumpSuppressed;                    // Also write <name>_suppressed.cmat, a raw CMatrix dump (see CMappedFile)
+    CProfiler * profiler;                   // Optional; gets every image's stages plus decode and encode
+    CSuppressedCache * cache;               // Optional; images found in it skip decoding and go straight to hysteresis
+
+    CBatchOptions();
+};
+
+struct CBatchImageStats
+{
+    QString path, outputPath;
+    bool ok;
+    QString error;
+    uint width, height;
+    double thresholdLow, thresholdHigh;     // Those used, automatic or not
+    bool cached;                            // mSuppressed came from CBatchOptions::cache
+    double decodeSeconds, computeSeconds, encodeSeconds;
+
+    double megapixels() const { return width * (double)height / 1e6; }
+};
+
+class CBatchPipeline
+{
+public:
+    CBatchOptions mOptions;
+    QList<CBatchImageStats> mResults;       // In completion order
+    double mWallSeconds;
+
+    // Called on run()'s thread as each image finishes
+    std::function<void(const CBatchImageStats&)> mOnImageDone;
+
+    CBatchPipeline(const CBatchOptions& options);
+
+    void run(const QStringList& files);
+
+    uint succeeded() const;
+    double megapixels() const;              // Of the images that succeeded
+
+    static QStringList expandInputs(const QStringList& paths);
+    static QString outputName(const QString& path);     // <name> of <name>_edges.<format> and <name>_suppressed.cmat
+
+    /* Inputs whose outputName() an earlier one already has, mapped to that earlier input: a.jpg
+     * after a.png, or img.png from a second directory, would overwrite its outputs. run() fails
+     * them rather than overwrite; names are compared ignoring case, as some file systems do. */
+    static QMap<QString, QString> outputClashes(const QStringList& files);
+    static QStringList imageNameFilters();
+};
+
+#endif // CBATCHPIPELINE_H
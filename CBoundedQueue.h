@@ -0,0 +1,56 @@
+#ifndef CBOUNDEDQUEUE_H
+#define CBOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <queue>
+
+/* Blocking FIFO between pipeline stages. push() waits while the queue is full, so a fast
+ * producer cannot run ahead of its consumers by more than `capacity` items; pop() waits
+ * while it is empty. Once close() is called, push() refuses new items and pop() returns
+ * false after the remaining ones are drained. */
+
+template<typename T> class CBoundedQueue
+{
+public:
+    uint mCapacity;
+    bool mClosed;
+    std::queue<T> mItems;
+    QMutex mMutex;
+    QWaitCondition mNotFull, mNotEmpty;
+
+    CBoundedQueue(uint capacity) : mCapacity(qMax(1u, capacity)), mClosed(false) {}
+
+    bool push(const T& item)
+    {
+        QMutexLocker lock(&mMutex);
+        while(!mClosed && mItems.size() >= mCapacity)
+            mNotFull.wait(&mMutex);
+        if(mClosed) return false;
+        mItems.push(item);
+        mNotEmpty.wakeOne();
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        QMutexLocker lock(&mMutex);
+        while(!mClosed && mItems.empty())
+            mNotEmpty.wait(&mMutex);
+        if(mItems.empty()) return false;
+        item = mItems.front();
+        mItems.pop();
+        mNotFull.wakeOne();
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker lock(&mMutex);
+        mClosed = true;
+        mNotFull.wakeAll();
+        mNotEmpty.wakeAll();
+    }
+};
+
+#endif // CBOUNDEDQUEUE_H
@@ -0,0 +1,195 @@
+#include "CCannyWorker.h"
+#include "CSuppressedCache.h"
+
+CCannyRequest::CCannyRequest()
+        : mLoad(0), mCanny(false), mSigma(1), mUseR(true), mUseG(true), mUseB(true),
+          mDisplay(DisplayHysteresis), mLow(0.007), mHigh(0.099), mRule(CMagnitudeHistogram::RulePercentile)
+{
+}
+
+bool CCannyRequest::sameCanny(const CCannyRequest& other) const
+{
+    return mPath == other.mPath && mLoad == other.mLoad && mSigma == other.mSigma &&
+           mUseR == other.mUseR && mUseG == other.mUseG && mUseB == other.mUseB;
+}
+
+CCannyWorker::CCannyWorker(CSuppressedCache * cache, QObject * parent)
+        : QObject(parent), mProfiler(true), mCache(cache), mGeneration(0), mDoneGeneration(0), mQuit(false),
+          mCancel(0), mImage(0), mProgress(0), mInCanny(false)
+{
+    mProfiler.mOnRecord = [this](const QString& stage, qint64, qint64) {
+        if(mInCanny) stageDone(stage);
+    };
+    mThread.setMaxThreadCount(1);
+    mThread.start(newTask([this]() { loop(); }));
+}
+
+CCannyWorker::~CCannyWorker()
+{
+    {
+        QMutexLocker locker(&mMutex);
+        mQuit = true;
+        mCancel.storeRelease(1);
+        mWake.wakeAll();
+    }
+    mThread.waitForDone();
+    delete mImage;
+}
+
+QStringList CCannyWorker::cannyStages()
+{
+    return QStringList() << "ingest" << "blur" << "gradient" << "suppression" << "export";
+}
+
+void CCannyWorker::load(const QString& path)
+{
+    QMutexLocker locker(&mMutex);
+    CCannyRequest wanted = mWanted;
+    wanted.mPath = path;
+    wanted.mLoad++;
+    wanted.mCanny = false;
+    request(wanted);
+}
+
+void CCannyWorker::canny(double sigma, bool useR, bool useG, bool useB)
+{
+    QMutexLocker locker(&mMutex);
+    CCannyRequest wanted = mWanted;
+    wanted.mCanny = true;
+    wanted.mSigma = sigma;
+    wanted.mUseR = useR;
+    wanted.mUseG = useG;
+    wanted.mUseB = useB;
+    request(wanted);
+}
+
+void CCannyWorker::showSuppressed()
+{
+    QMutexLocker locker(&mMutex);
+    CCannyRequest wanted = mWanted;
+    wanted.mDisplay = CCannyRequest::DisplaySuppressed;
+    request(wanted);
+}
+
+void CCannyWorker::showHysteresis(double low, double high)
+{
+    QMutexLocker locker(&mMutex);
+    CCannyRequest wanted = mWanted;
+    wanted.mDisplay = CCannyRequest::DisplayHysteresis;
+    wanted.mLow = low;
+    wanted.mHigh = high;
+    request(wanted);
+}
+
+void CCannyWorker::showAutoThresholds(CMagnitudeHistogram::Rule rule)
+{
+    QMutexLocker locker(&mMutex);
+    CCannyRequest wanted = mWanted;
+    wanted.mDisplay = CCannyRequest::DisplayAuto;
+    wanted.mRule = rule;
+    request(wanted);
+}
+
+// Replaces whatever was wanted before; the loop only ever works towards the latest request
+void CCannyWorker::request(const CCannyRequest& wanted)
+{
+    if(!wanted.sameCanny(mWanted))
+        mCancel.storeRelease(1);
+    mWanted = wanted;
+    mGeneration++;
+    mWake.wakeOne();
+}
+
+void CCannyWorker::loop()
+{
+    for(;;) {
+        CCannyRequest wanted;
+        quint64 generation;
+        {
+            QMutexLocker locker(&mMutex);
+            while(!mQuit && mDoneGeneration == mGeneration)
+                mWake.wait(&mMutex);
+            if(mQuit) return;
+            wanted = mWanted;
+            generation = mGeneration;
+            mCancel.storeRelease(0);
+        }
+
+        step(wanted, generation);
+
+        QMutexLocker locker(&mMutex);
+        mDoneGeneration = generation;
+    }
+}
+
+// From mHave to wanted, redoing only what differs
+void CCannyWorker::step(const CCannyRequest& wanted, quint64 generation)
+{
+    if(mImage == 0 || wanted.mPath != mHave.mPath || wanted.mLoad != mHave.mLoad) {
+        delete mImage;
+        mImage = new CImage(wanted.mPath);
+        mImage->mProfiler = &mProfiler;
+        mImage->mCache = mCache;
+        mImage->mCancel = &mCancel;
+        mHave = wanted;
+        mHave.mCanny = false;
+        emit loaded(*mImage->mOriginalImage);
+    }
+    if(!wanted.mCanny || mImage->mImage->isNull()) return;
+
+    if(!mHave.mCanny || !wanted.sameCanny(mHave)) {
+        // Shares of the expected time, from each stage's mean per pixel so far
+        QStringList stages = cannyStages();
+        QVector<CStageStats> stats = mProfiler.stages();
+        mExpected = QVector<double>(stages.size(), 0.);
+        double total = 0;
+        bool known = true;
+        for(int s = 0; s < stages.size(); s++) {
+            for(int k = 0; k < stats.size(); k++)
+                if(stats[k].mStage == stages[s] && stats[k].mPixels > 0)
+                    mExpected[s] = (double)stats[k].mTotalNs / stats[k].mPixels;
+            known = known && mExpected[s] > 0;
+            total += mExpected[s];
+        }
+        for(int s = 0; s < stages.size(); s++)
+            mExpected[s] = known ? mExpected[s] / total : 1. / stages.size();
+
+        mProgress = 0;
+        emit progress(0, stages[0]);
+        mInCanny = true;
+        bool done = mImage->canny(wanted.mSigma, wanted.mUseR, wanted.mUseG, wanted.mUseB);
+        mInCanny = false;
+        emit progress(100, QString());
+        if(!done) return;
+        mHave = wanted;
+        mHave.mCanny = true;
+    }
+
+    double low = wanted.mLow, high = wanted.mHigh;
+    bool automatic = wanted.mDisplay == CCannyRequest::DisplayAuto && mImage->autoThresholds(wanted.mRule, low, high);
+    if(wanted.mDisplay == CCannyRequest::DisplaySuppressed)
+        mImage->useSuppressed();
+    else
+        mImage->useHysteresis(low, high);
+
+    // Automatic thresholds move the sliders, which must not jump back under the user's hand
+    if(automatic && superseded(generation)) return;
+    emit resultReady(*mImage->mImage, low, high, automatic);
+}
+
+bool CCannyWorker::superseded(quint64 generation)
+{
+    QMutexLocker locker(&mMutex);
+    return generation != mGeneration;
+}
+
+void CCannyWorker::stageDone(const QString& stage)
+{
+    QStringList stages = cannyStages();
+    int s = stages.indexOf(stage);
+    if(s < 0) return;
+    mProgress += mExpected[s];
+    // The end is reported by step(), also when canny() stops early
+    if(s + 1 < stages.size())
+        emit progress(qMin(99, qRound(100 * mProgress)), stages[s + 1]);
+}
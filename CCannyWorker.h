@@ -0,0 +1,87 @@
+#ifndef CCANNYWORKER_H
+#define CCANNYWORKER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include "globals.h"
+#include "CImage.h"
+
+/* The window's image work, on a thread of its own so the window never waits for it. The window
+ * only states what it wants to see - a file, canny() settings, how to show the result - and
+ * the worker computes whatever is missing between what it holds and the latest such request.
+ * Requests that arrive while it is busy are coalesced: a slider dragged through fifty positions
+ * during one hysteresis costs one more hysteresis, not fifty. A request for another file or
+ * other canny() settings cancels the canny() in flight (see CImage::mCancel), which stops at
+ * its next stage; one that only changes how the result is shown lets it finish.
+ *
+ * Results come back as queued signals carrying shared copies of the images, so the window never
+ * touches the worker's CImage. Progress through canny() is the share of the expected time its
+ * stages have taken, from their mean time per pixel in earlier runs; equal shares until every
+ * stage has run once. */
+
+struct CCannyRequest
+{
+    enum Display { DisplaySuppressed, DisplayHysteresis, DisplayAuto };
+
+    QString mPath;
+    uint mLoad;                             // Bumped by every load(), so a reload rereads the file
+    bool mCanny;                            // canny() wanted on the loaded image
+    double mSigma;
+    bool mUseR, mUseG, mUseB;
+    Display mDisplay;
+    double mLow, mHigh;                     // For DisplayHysteresis
+    CMagnitudeHistogram::Rule mRule;        // For DisplayAuto
+
+    CCannyRequest();
+    bool sameCanny(const CCannyRequest& other) const;       // Same load and canny() settings
+};
+
+class CCannyWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    CProfiler mProfiler;                    // Of the worker's CImage; logs every stage
+    CSuppressedCache * mCache;              // Not owned, 0 for none
+    QThreadPool mThread;                    // One thread, running loop()
+    QMutex mMutex;                          // Guards the four below
+    QWaitCondition mWake;
+    CCannyRequest mWanted;                  // The latest request
+    quint64 mGeneration, mDoneGeneration;   // Of mWanted, and of the last request the loop finished
+    bool mQuit;
+    QAtomicInt mCancel;                     // Set by a request that makes the canny() in flight useless
+
+    // Only touched by the worker thread
+    CImage * mImage;
+    CCannyRequest mHave;                    // What mImage holds; mCanny once canny() has completed
+    QVector<double> mExpected;              // Share of canny() per stage of cannyStages()
+    double mProgress;                       // Sum of the shares of the stages done, while in canny()
+    bool mInCanny;
+
+    CCannyWorker(CSuppressedCache * cache = 0, QObject * parent = 0);
+    ~CCannyWorker();
+
+    // Return at once; what they lead to arrives as signals
+    void load(const QString& path);
+    void canny(double sigma, bool useR, bool useG, bool useB);
+    void showSuppressed();
+    void showHysteresis(double low, double high);
+    void showAutoThresholds(CMagnitudeHistogram::Rule rule);
+
+    static QStringList cannyStages();       // Those canny() records, in order
+
+signals:
+    void loaded(QImage original);           // Null when the file could not be read
+    void resultReady(QImage result, double low, double high, bool automatic);
+    void progress(int percent, QString stage);
+
+protected:
+    void request(const CCannyRequest& wanted);              // The caller holds mMutex
+    void loop();
+    void step(const CCannyRequest& wanted, quint64 generation);
+    bool superseded(quint64 generation);                    // A newer request has arrived
+    void stageDone(const QString& stage);
+};
+
+#endif // CCANNYWORKER_H
@@ -0,0 +1,54 @@
+#include "CCannyWorkspace.h"
+#include "CImage.h"
+
+CCannyWorkspace::CCannyWorkspace()
+        : mBlock(0), mCapacity(0), mUsed(0), mFrames(0), mGrowths(0), mSigma(0), mGaussian(0)
+{
+}
+
+CCannyWorkspace::~CCannyWorkspace()
+{
+    for(int i = 0; i < mOverflow.size(); i++)
+        qFreeAligned(mOverflow[i]);
+    qFreeAligned(mBlock);
+    delete mGaussian;
+}
+
+void CCannyWorkspace::beginFrame()
+{
+    size_t needed = mUsed.loadAcquire();
+    for(int i = 0; i < mOverflow.size(); i++)
+        qFreeAligned(mOverflow[i]);
+    mOverflow.clear();
+    if(needed > mCapacity) {
+        qFreeAligned(mBlock);
+        mBlock = (char*)qMallocAligned(needed, CMATRIX_ALIGNMENT);
+        mCapacity = needed;
+        mGrowths++;
+    }
+    mUsed.storeRelease(0);
+    mFrames++;
+}
+
+void * CCannyWorkspace::take(size_t bytes)
+{
+    bytes = (bytes + CMATRIX_ALIGNMENT - 1) / CMATRIX_ALIGNMENT * CMATRIX_ALIGNMENT;
+    size_t offset = mUsed.fetchAndAddRelaxed(bytes);
+    if(offset + bytes <= mCapacity)
+        return mBlock + offset;
+
+    void * overflow = qMallocAligned(bytes, CMATRIX_ALIGNMENT);
+    QMutexLocker locker(&mMutex);
+    mOverflow.append(overflow);
+    return overflow;
+}
+
+CMatD& CCannyWorkspace::gaussian(double sigma)
+{
+    if(mGaussian == 0 || sigma != mSigma) {
+        delete mGaussian;
+        mGaussian = new CMatD(CImage::gaussianFilter1D(sigma));
+        mSigma = sigma;
+    }
+    return *mGaussian;
+}
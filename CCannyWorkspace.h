@@ -0,0 +1,44 @@
+#ifndef CCANNYWORKSPACE_H
+#define CCANNYWORKSPACE_H
+
+#include "globals.h"
+#include <QAtomicInteger>
+#include <QMutex>
+
+/* Scratch memory for CImage::canny, kept from frame to frame. Every intermediate matrix of a
+ * frame is carved out of one aligned block with a bump pointer, and beginFrame() hands the
+ * whole block back. A frame that outgrows the block (the first one, or one at a larger
+ * resolution) is served from the heap past the end; the next beginFrame() frees that overflow
+ * and enlarges the block to the size the frame needed. From then on, frames of that size
+ * allocate nothing. take() is thread-safe, so row bands can take scratch concurrently. */
+
+class CCannyWorkspace
+{
+public:
+    char * mBlock;
+    size_t mCapacity;
+    QAtomicInteger<quint64> mUsed;          // Bytes taken this frame, overflow included
+    QMutex mMutex;                          // Guards mOverflow
+    QVector<void*> mOverflow;               // Heap blocks taken past mCapacity this frame
+    uint mFrames, mGrowths;
+
+    double mSigma;                          // Kernel cache for gaussian()
+    CMatD * mGaussian;
+
+    CCannyWorkspace();
+    ~CCannyWorkspace();
+
+    void beginFrame();
+    void * take(size_t bytes);              // CMATRIX_ALIGNMENT-aligned, valid until the next beginFrame()
+    template<typename T> T * take(uint height, uint width);
+
+    CMatD& gaussian(double sigma);          // CImage::gaussianFilter1D(sigma), recomputed only when sigma changes
+};
+
+// Room for a height x width CMatrix<T>, with its row padding; wrap it in a view constructor
+template<typename T> T * CCannyWorkspace::take(uint height, uint width)
+{
+    return (T*)take(sizeof(T) * (size_t)height * CMatrix<T>::strideFor(width));
+}
+
+#endif // CCANNYWORKSPACE_H
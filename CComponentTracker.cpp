@@ -0,0 +1,155 @@
+#include "CComponentTracker.h"
+
+quint32 CComponentTracker::findRoot(QVector<quint32>& parent, quint32 x)
+{
+    while(parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+quint32 CComponentTracker::unite(QVector<quint32>& parent, QVector<uchar>& strong, quint32 a, quint32 b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if(a == b) return a;
+    if(b < a) qSwap(a, b);
+    parent[b] = a;
+    strong[a] |= strong[b];
+    return a;
+}
+
+// Read-only find, for when every band looks up labels at once
+static quint32 rootOf(const quint32 * parent, quint32 x)
+{
+    while(parent[x] != x)
+        x = parent[x];
+    return x;
+}
+
+uint CComponentTracker::labelRow(const double * g, uint width, double thresholdLow, double thresholdHigh, QVector<CEdgeRun>& runs,
+                                 uint aboveBegin, uint aboveEnd, QVector<quint32>& parent, QVector<uchar>& strong)
+{
+    uint first = runs.size(), p = aboveBegin;
+    for(uint j = 0; j < width; ) {
+        if(!(g[j] >= thresholdLow)) { j++; continue; }
+        uint begin = j;
+        bool isStrong = false;
+        for(; j < width && g[j] >= thresholdLow; j++)
+            isStrong = isStrong || g[j] >= thresholdHigh;
+
+        // Runs above that end before begin - 1 cannot touch this run or any later one
+        while(p < aboveEnd && runs[p].mEnd < begin) p++;
+        quint32 label = 0;
+        bool labelled = false;
+        for(uint q = p; q < aboveEnd && runs[q].mBegin <= j; q++) {
+            label = labelled ? unite(parent, strong, label, runs[q].mLabel) : findRoot(parent, runs[q].mLabel);
+            labelled = true;
+        }
+        if(!labelled) {
+            label = parent.size();
+            parent.append(label);
+            strong.append(0);
+        }
+        if(isStrong) strong[label] = 1;
+        CEdgeRun run = { begin, j, label };
+        runs.append(run);
+    }
+    return runs.size() - first;
+}
+
+// out gets 1 on pixels >= low that are 8-connected through such pixels to one >= high
+void CComponentTracker::track(CMatD& grad, double thresholdLow, double thresholdHigh, CMatrix<uchar>& out, QThreadPool * pool)
+{
+    uint h = grad.mHeight, w = grad.mWidth;
+    uint threads = pool ? pool->maxThreadCount() : 1;
+    uint count = qMin(h, threads * CPARALLEL_BANDS_PER_THREAD);
+    if(count == 0) return;
+    mBands.resize(count);
+    for(uint b = 0; b < count; b++) {
+        mBands[b].mRowBegin = (quint64)h * b / count;
+        mBands[b].mRowEnd = (quint64)h * (b + 1) / count;
+    }
+
+    // Every band labels its own rows
+    parallelBands(pool, count, [&](uint bandBegin, uint bandEnd) {
+        for(uint b = bandBegin; b < bandEnd; b++) {
+            Band& band = mBands[b];
+            band.mRuns.resize(0);
+            band.mParent.resize(0);
+            band.mStrong.resize(0);
+            band.mRowStart.resize(band.mRowEnd - band.mRowBegin + 1);
+            band.mRowStart[0] = 0;
+            uint above = 0;
+            for(uint i = band.mRowBegin; i < band.mRowEnd; i++) {
+                uint start = band.mRuns.size();
+                labelRow(grad.row(i), w, thresholdLow, thresholdHigh, band.mRuns, above, start, band.mParent, band.mStrong);
+                above = start;
+                band.mRowStart[i - band.mRowBegin + 1] = band.mRuns.size();
+            }
+        }
+    });
+
+    quint32 labels = 0;
+    for(uint b = 0; b < count; b++) {
+        mBands[b].mOffset = labels;
+        labels += mBands[b].mParent.size();
+    }
+    mParent.resize(labels);
+    mStrong.resize(labels);
+
+    // Into the global tables, every label pointing straight at its band root; runs take the root
+    parallelBands(pool, count, [&](uint bandBegin, uint bandEnd) {
+        for(uint b = bandBegin; b < bandEnd; b++) {
+            Band& band = mBands[b];
+            for(int k = 0; k < band.mParent.size(); k++) {
+                quint32 root = findRoot(band.mParent, k);
+                mParent[band.mOffset + k] = band.mOffset + root;
+                mStrong[band.mOffset + k] = band.mStrong[root];
+            }
+            for(int r = 0; r < band.mRuns.size(); r++)
+                band.mRuns[r].mLabel = mParent[band.mOffset + band.mRuns[r].mLabel];
+        }
+    });
+
+    // The first row of each band against the last row of the band above
+    for(uint b = 1; b < count; b++) {
+        const Band& upper = mBands[b-1], & lower = mBands[b];
+        uint aboveBegin = upper.mRowStart[upper.mRowEnd - upper.mRowBegin - 1], aboveEnd = upper.mRuns.size();
+        uint p = aboveBegin;
+        for(uint r = 0; r < lower.mRowStart[1]; r++) {
+            const CEdgeRun& run = lower.mRuns[r];
+            while(p < aboveEnd && upper.mRuns[p].mEnd < run.mBegin) p++;
+            for(uint q = p; q < aboveEnd && upper.mRuns[q].mBegin <= run.mEnd; q++)
+                unite(mParent, mStrong, upper.mRuns[q].mLabel, run.mLabel);
+        }
+    }
+
+    // Nothing changes the tables from here, so every band can read them
+    parallelBands(pool, count, [&](uint bandBegin, uint bandEnd) {
+        const quint32 * parent = mParent.constData();
+        const uchar * strong = mStrong.constData();
+        for(uint b = bandBegin; b < bandEnd; b++) {
+            const Band& band = mBands[b];
+            for(uint i = band.mRowBegin; i < band.mRowEnd; i++) {
+                uchar * o = out.row(i);
+                memset(o, 0, w);
+                for(uint r = band.mRowStart[i - band.mRowBegin]; r < band.mRowStart[i - band.mRowBegin + 1]; r++) {
+                    const CEdgeRun& run = band.mRuns[r];
+                    if(strong[rootOf(parent, run.mLabel)])
+                        memset(o + run.mBegin, 1, run.mEnd - run.mBegin);
+                }
+            }
+        }
+    });
+}
+
+size_t CComponentTracker::bytes() const
+{
+    size_t total = mParent.capacity() * sizeof(quint32) + mStrong.capacity();
+    for(int b = 0; b < mBands.size(); b++)
+        total += mBands[b].mRuns.capacity() * sizeof(CEdgeRun) + mBands[b].mRowStart.capacity() * sizeof(quint32) +
+                 mBands[b].mParent.capacity() * sizeof(quint32) + mBands[b].mStrong.capacity();
+    return total;
+}
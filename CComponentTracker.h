@@ -0,0 +1,54 @@
+#ifndef CCOMPONENTTRACKER_H
+#define CCOMPONENTTRACKER_H
+
+#include "globals.h"
+
+/* Hysteresis as connected components, for many threads. The frame is cut into row bands,
+ * a fixed number per thread. Each band labels its runs of pixels >= the low threshold row by
+ * row, joining every run to the runs of the row above that it touches (8-connected: they
+ * overlap once widened by one pixel) with a union-find of its own, whose roots carry whether
+ * the component has a pixel >= high. The bands' tables are then laid end to end, the runs on
+ * either side of each band border are joined, and every band writes its rows: a run is an
+ * edge when its root is strong. That is the same set of pixels the flood fill of CEdgeTracker
+ * accepts, whatever the band layout.
+ *
+ * Only the border joins are serial, one row pair per band, so they cost a few rows of work.
+ * Memory is per run rather than per pixel, and is kept between calls. */
+
+// Candidates [mBegin, mEnd) of one row, and their component
+struct CEdgeRun
+{
+    quint32 mBegin, mEnd, mLabel;
+};
+
+class CComponentTracker
+{
+public:
+    struct Band
+    {
+        uint mRowBegin, mRowEnd;
+        QVector<CEdgeRun> mRuns;            // Row after row
+        QVector<quint32> mRowStart;         // Of each row in mRuns, and the end
+        QVector<quint32> mParent;           // Union-find over the band's runs, then their global labels
+        QVector<uchar> mStrong;
+        quint32 mOffset;                    // Of the band's labels in the global tables
+    };
+
+    QVector<Band> mBands;
+    QVector<quint32> mParent;               // Global union-find
+    QVector<uchar> mStrong;
+
+    void track(CMatD& grad, double thresholdLow, double thresholdHigh, CMatrix<uchar>& out, QThreadPool * pool);
+    size_t bytes() const;
+
+    /* Appends the runs of row g to runs, each joined to those of runs[aboveBegin, aboveEnd) it
+     * touches; a run that touches none starts a new label. Returns how many were appended. */
+    static uint labelRow(const double * g, uint width, double thresholdLow, double thresholdHigh, QVector<CEdgeRun>& runs,
+                         uint aboveBegin, uint aboveEnd, QVector<quint32>& parent, QVector<uchar>& strong);
+
+    // Union-find where a root is always the smallest label of its set, and carries the set's strong flag
+    static quint32 findRoot(QVector<quint32>& parent, quint32 x);
+    static quint32 unite(QVector<quint32>& parent, QVector<uchar>& strong, quint32 a, quint32 b);
+};
+
+#endif // CCOMPONENTTRACKER_H
@@ -0,0 +1,68 @@
+#include "CEdgeTracker.h"
+
+CEdgeTracker::CEdgeTracker(uint height, uint width)
+        : mHeight(0), mWidth(0), mPaddedWidth(0)
+{
+    resize(height, width);
+}
+
+void CEdgeTracker::resize(uint height, uint width)
+{
+    if(height == mHeight && width == mWidth) return;
+    mHeight = height;
+    mWidth = width;
+    mPaddedWidth = width + 2;
+    mLabels.resize((height + 2) * mPaddedWidth);
+    mLabels.fill(Below);
+    mStack.resize(height * width);
+
+    int w = mPaddedWidth, k = 0;
+    for(int dx = -1; dx <= 1; dx++)
+        for(int dy = -1; dy <= 1; dy++)
+            if(dx != 0 || dy != 0) mOffsets[k++] = dx*w + dy;
+}
+
+// out gets 1 on pixels >= low that are 8-connected through such pixels to one >= high
+void CEdgeTracker::track(CMatD& grad, double thresholdLow, double thresholdHigh, CMatrix<uchar>& out)
+{
+    resize(grad.mHeight, grad.mWidth);
+    uchar * labels = mLabels.data();
+    uint * stack = mStack.data();
+
+    // Interior labels; the border stays Below from resize()
+    for(uint i = 0; i < mHeight; i++) {
+        const double * g = grad.row(i);
+        uchar * l = labels + (i+1)*mPaddedWidth + 1;
+        for(uint j = 0; j < mWidth; j++)
+            l[j] = g[j] >= thresholdLow ? Weak : Below;
+    }
+
+    for(uint i = 0; i < mHeight; i++) {
+        const double * g = grad.row(i);
+        uint rowStart = (i+1)*mPaddedWidth + 1;
+        for(uint j = 0; j < mWidth; j++) {
+            if(g[j] < thresholdHigh || labels[rowStart + j] != Weak) continue;
+
+            uint top = 0;
+            labels[rowStart + j] = Edge;
+            stack[top++] = rowStart + j;
+            while(top > 0) {
+                uint p = stack[--top];
+                for(int k = 0; k < 8; k++) {
+                    uint n = p + mOffsets[k];
+                    if(labels[n] == Weak) {
+                        labels[n] = Edge;
+                        stack[top++] = n;
+                    }
+                }
+            }
+        }
+    }
+
+    for(uint i = 0; i < mHeight; i++) {
+        const uchar * l = labels + (i+1)*mPaddedWidth + 1;
+        uchar * o = out.row(i);
+        for(uint j = 0; j < mWidth; j++)
+            o[j] = l[j] == Edge;
+    }
+}
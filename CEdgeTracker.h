@@ -0,0 +1,30 @@
+#ifndef CEDGETRACKER_H
+#define CEDGETRACKER_H
+
+#include "globals.h"
+
+/* One-shot hysteresis without a queue of coordinate pairs. Pixels are labelled in a buffer
+ * with a one-pixel border on every side, so the 8 neighbours of any pixel are fixed offsets
+ * that never need a bounds check (the border is labelled as below threshold). Accepted pixels
+ * go on a flat stack of linear indices, preallocated to the frame size: every pixel is
+ * pushed at most once, so it can never overflow. Both buffers belong to the tracker and are
+ * reused while the frame size stays the same. */
+
+class CEdgeTracker
+{
+public:
+    enum Label { Below = 0, Weak = 1, Edge = 2 };
+
+    uint mHeight, mWidth, mPaddedWidth;
+    QVector<uchar> mLabels;                 // (mHeight+2) x mPaddedWidth
+    QVector<uint> mStack;
+    int mOffsets[8];                        // Neighbour offsets in mLabels
+
+    CEdgeTracker(uint height, uint width);
+
+    void resize(uint height, uint width);
+    size_t bytes() const { return mLabels.size() + mStack.size() * sizeof(uint); }
+    void track(CMatD& grad, double thresholdLow, double thresholdHigh, CMatrix<uchar>& out);
+};
+
+#endif // CEDGETRACKER_H
@@ -0,0 +1,229 @@
+#include "CFrameStream.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QPair>
+#include <algorithm>
+
+CStreamOptions::CStreamOptions()
+        : sigma(1), useR(true), useG(true), useB(true),
+          thresholdLow(0.007), thresholdHigh(0.099), autoThresholds(false), thresholdRule(CMagnitudeHistogram::RulePercentile),
+          highPercentile(0.8), lowRatio(0.4), precision(CImage::PrecisionDouble),
+          threadsPerStage(1), profiler(0)
+{
+}
+
+CFrameStream::CFrameStream(const CStreamOptions& options)
+        : mOptions(options), mFree(CFRAMESTREAM_SLOTS), mReady(CFRAMESTREAM_SLOTS + 1),
+          mSuppressed(0), mEdges(0), mRunning(false), mPushed(0), mDone(0), mWallSeconds(0)
+{
+    mFront = new CImage(0, 0);
+    mBack = new CImage(0, 0);
+    mFront->setThreadCount(mOptions.threadsPerStage);
+    mBack->setThreadCount(mOptions.threadsPerStage);
+    mFront->mProfiler = mBack->mProfiler = mOptions.profiler;
+    mBackThread.setMaxThreadCount(1);
+    for(int s = 0; s < CFRAMESTREAM_SLOTS; s++)
+        mFree.push(s);
+}
+
+CFrameStream::~CFrameStream()
+{
+    finish();
+    delete mSuppressed;
+    delete mEdges;
+    delete mFront;
+    delete mBack;
+}
+
+bool CFrameStream::push(const QImage& frame)
+{
+    if(frame.isNull()) return false;
+
+    // The back stage runs until finish() sends it -1
+    if(!mRunning) {
+        if(mPushed == 0) mWall.start();
+        mRunning = true;
+        mBackThread.start(newTask([this]() {
+            int s;
+            while(mReady.pop(s) && s >= 0) {
+                switch(mOptions.precision) {
+                case CImage::PrecisionFloat: back<float>(mSlots[s]); break;
+                case CImage::PrecisionFixed: back<short>(mSlots[s]); break;
+                default: back<double>(mSlots[s]);
+                }
+                mFree.push(s);
+            }
+        }));
+    }
+
+    int s = 0;
+    mFree.pop(s);
+    mSlots[s].mPushed.start();
+    mSlots[s].mIndex = mPushed++;
+    switch(mOptions.precision) {
+    case CImage::PrecisionFloat: front<float, float>(frame, mSlots[s]); break;
+    case CImage::PrecisionFixed: front<uchar, short>(frame, mSlots[s]); break;
+    default: front<double, double>(frame, mSlots[s]);
+    }
+    mReady.push(s);
+    return true;
+}
+
+// Wraps the caller's buffer without copying it; it only has to live until push() returns
+bool CFrameStream::push(const uchar * data, uint width, uint height, uint bytesPerLine, QImage::Format format)
+{
+    if(data == 0) return false;
+    return push(QImage(data, width, height, bytesPerLine, format));
+}
+
+void CFrameStream::finish()
+{
+    if(!mRunning) return;
+    mReady.push(-1);
+    mBackThread.waitForDone();
+    mRunning = false;
+    mWallSeconds = mWall.nsecsElapsed() / 1e9;
+}
+
+uint CFrameStream::run(const QStringList& files)
+{
+    uint before = mDone;
+    CBoundedQueue<QImage> decoded(CFRAMESTREAM_SLOTS);
+    QThreadPool decoder;
+    decoder.start(newTask([&]() {
+        for(int i = 0; i < files.size(); i++) {
+            CStageTimer stage(mOptions.profiler, "decode", 0);
+            QImage frame(files[i]);
+            stage.mPixels = (qint64)frame.width() * frame.height();
+            stage.stop();
+            if(!decoded.push(frame)) break;
+        }
+        decoded.close();
+    }));
+
+    QImage frame;
+    while(decoded.pop(frame))
+        push(frame);
+    decoder.waitForDone();
+    finish();
+    return mDone - before;
+}
+
+double CFrameStream::framesPerSecond() const
+{
+    return mWallSeconds > 0 ? mDone / mWallSeconds : 0;
+}
+
+/* The images directly inside dir whose base names end in a number, in numeric order, so that
+ * frame_9 comes before frame_10 whether or not the numbers are zero-padded */
+QStringList CFrameStream::numberedFrames(const QString& dir)
+{
+    QDir d(dir);
+    QStringList names = d.entryList(CBatchPipeline::imageNameFilters(), QDir::Files, QDir::Name);
+    QList<QPair<qint64, QString> > numbered;
+    for(int i = 0; i < names.size(); i++) {
+        QString base = QFileInfo(names[i]).completeBaseName();
+        int digits = base.size();
+        while(digits > 0 && base[digits-1].isDigit()) digits--;
+        if(digits == base.size()) continue;
+        numbered.append(qMakePair(base.mid(digits).toLongLong(), d.filePath(names[i])));
+    }
+    std::stable_sort(numbered.begin(), numbered.end());
+    QStringList files;
+    for(int i = 0; i < numbered.size(); i++)
+        files.append(numbered[i].second);
+    return files;
+}
+
+// Ingest, blur and gradient of one frame; the gradient goes to the slot, the rest is front scratch
+template<typename In, typename T> void CFrameStream::front(const QImage& frame, CStreamSlot& slot)
+{
+    uint h = frame.height(), w = frame.width();
+    qint64 pixels = (qint64)w * h;
+    uint threads = mFront->threadCount();
+    CCannyWorkspace * scratch = mFront->mWorkspace;
+    scratch->beginFrame();
+    CMatD& gaussian = scratch->gaussian(mOptions.sigma);
+    mFront->mHeight = h;
+    mFront->mWidth = w;
+
+    CStageTimer ingest(mOptions.profiler, "ingest", pixels);
+    CMatrix<In> image(scratch->take<In>(h, w), h, w);
+    image.fromImage(&frame, mOptions.useR, mOptions.useG, mOptions.useB);
+    ingest.stop();
+
+    CStageTimer blurStage(mOptions.profiler, "blur", pixels, threads);
+    CMatrix<T> filtered(scratch->take<T>(h, w), h, w);
+    mFront->blur(image, filtered, gaussian);
+    blurStage.stop();
+
+    CStageTimer gradientStage(mOptions.profiler, "gradient", pixels, threads);
+    slot.mWorkspace.beginFrame();
+    slot.mHeight = h;
+    slot.mWidth = w;
+    slot.mMagnitude = slot.mWorkspace.take<T>(h, w);
+    slot.mDirection = slot.mWorkspace.take<uchar>(h, w);
+    CMatrix<T> magnitude((T*)slot.mMagnitude, h, w);
+    CMatrix<uchar> direction(slot.mDirection, h, w);
+    parallelBands(mFront->mPool, h, [&](uint rowBegin, uint rowEnd) {
+        mFront->gradient(filtered, magnitude, direction, rowBegin, rowEnd);
+    });
+    gradientStage.stop();
+}
+
+// Suppression and hysteresis of the frame in the slot, then mOnFrame
+template<typename T> void CFrameStream::back(CStreamSlot& slot)
+{
+    uint h = slot.mHeight, w = slot.mWidth;
+    qint64 pixels = (qint64)w * h;
+    mBack->mHeight = h;
+    mBack->mWidth = w;
+    mBack->mWorkspace->beginFrame();
+    CMatrix<T> magnitude((T*)slot.mMagnitude, h, w);
+    CMatrix<uchar> direction(slot.mDirection, h, w);
+
+    CStageTimer suppressionStage(mOptions.profiler, "suppression", pixels, mBack->threadCount());
+    if(mSuppressed != 0 && (mSuppressed->mHeight != h || mSuppressed->mWidth != w)) {
+        delete mSuppressed;
+        delete mEdges;
+        mSuppressed = 0;
+    }
+    if(mSuppressed == 0) {
+        mSuppressed = new CMatD(h, w);
+        mEdges = new CMatrix<uchar>(h, w);
+        suppressionStage.mBytes = mSuppressed->bytes() + mEdges->bytes();
+    }
+    CMagnitudeHistogram * histogram = 0;
+    if(mOptions.autoThresholds) {
+        if(mBack->mHistogram == 0) mBack->mHistogram = new CMagnitudeHistogram();
+        histogram = mBack->mHistogram;
+        histogram->clear();
+    }
+    parallelBands(mBack->mPool, h, [&](uint rowBegin, uint rowEnd) {
+        mBack->suppression(*mSuppressed, magnitude, direction, rowBegin, rowEnd, histogram);
+    });
+    suppressionStage.stop();
+
+    CStreamFrame done;
+    done.thresholdLow = mOptions.thresholdLow;
+    done.thresholdHigh = mOptions.thresholdHigh;
+    if(histogram)
+        histogram->thresholds(mOptions.thresholdRule, done.thresholdLow, done.thresholdHigh, mOptions.highPercentile, mOptions.lowRatio);
+
+    CStageTimer hysteresisStage(mOptions.profiler, "hysteresis", pixels);
+    if(mBack->mTracker == 0) {
+        mBack->mTracker = new CEdgeTracker(h, w);
+        hysteresisStage.mBytes = mBack->mTracker->bytes();
+    }
+    mBack->mTracker->track(*mSuppressed, done.thresholdLow, done.thresholdHigh, *mEdges);
+    hysteresisStage.stop();
+
+    done.index = slot.mIndex;
+    done.suppressed = mSuppressed;
+    done.edges = mEdges;
+    done.latencySeconds = slot.mPushed.nsecsElapsed() / 1e9;
+    if(mOnFrame) mOnFrame(done);
+    mDone++;
+}
@@ -0,0 +1,89 @@
+#ifndef CFRAMESTREAM_H
+#define CFRAMESTREAM_H
+
+#include "globals.h"
+#include "CImage.h"
+#include "CBatchPipeline.h"
+#include "CBoundedQueue.h"
+#include <functional>
+
+/* Edge detection over a sequence of frames, such as a camera feed. The pipeline is split in
+ * two stages: the front (ingest, blur, gradient) runs on the thread that calls push(), the
+ * back (suppression, hysteresis) on a thread of the stream's own. The gradient of a frame is
+ * written into one of two slots, so while the back stage works on frame N the front is
+ * already blurring frame N+1 into the other slot. Every buffer - the slots, the stages'
+ * workspaces, the suppressed and edge matrices - is kept from frame to frame and only
+ * reallocated when the frame size changes. */
+
+#define CFRAMESTREAM_SLOTS 2
+
+struct CStreamOptions
+{
+    double sigma;
+    bool useR, useG, useB;
+    double thresholdLow, thresholdHigh;
+    bool autoThresholds;                    // Per frame from its magnitude histogram, instead of the two above
+    CMagnitudeHistogram::Rule thresholdRule;
+    double highPercentile, lowRatio;
+    CImage::Precision precision;
+    uint threadsPerStage;                   // Row-band threads inside each of the two stages
+    CProfiler * profiler;                   // Optional; gets the stages of every frame
+
+    CStreamOptions();
+};
+
+// One finished frame, handed to mOnFrame; the matrices are only valid during the call
+struct CStreamFrame
+{
+    uint index;                             // Order of push(), from 0
+    CMatD * suppressed;
+    CMatrix<uchar> * edges;                 // 1 on edge pixels, see CEdgeTracker::track
+    double thresholdLow, thresholdHigh;     // Those used, automatic or not
+    double latencySeconds;                  // From push() to the end of hysteresis
+};
+
+// A gradient computed by the front stage and waiting for the back stage
+struct CStreamSlot
+{
+    CCannyWorkspace mWorkspace;             // Holds mMagnitude and mDirection
+    void * mMagnitude;                      // Of the stream's working type
+    uchar * mDirection;
+    uint mHeight, mWidth, mIndex;
+    QElapsedTimer mPushed;
+};
+
+class CFrameStream
+{
+public:
+    CStreamOptions mOptions;
+    CImage * mFront, * mBack;               // Pools, workspaces and tracker of each stage
+    CStreamSlot mSlots[CFRAMESTREAM_SLOTS];
+    CBoundedQueue<int> mFree, mReady;       // Slot numbers on their way between the stages
+    CMatD * mSuppressed;
+    CMatrix<uchar> * mEdges;
+    QThreadPool mBackThread;
+    bool mRunning;                          // The back stage's loop is started
+    uint mPushed, mDone;
+    QElapsedTimer mWall;
+    double mWallSeconds;                    // From the first push() to finish()
+
+    // Called on the back stage's thread, in push() order
+    std::function<void(const CStreamFrame&)> mOnFrame;
+
+    CFrameStream(const CStreamOptions& options);
+    ~CFrameStream();
+
+    bool push(const QImage& frame);         // False for a null frame, which is skipped
+    bool push(const uchar * data, uint width, uint height, uint bytesPerLine, QImage::Format format);
+    void finish();                          // Waits for the frames in flight; push() may follow
+
+    uint run(const QStringList& files);     // Decodes on a thread of its own; returns frames processed
+    double framesPerSecond() const;
+
+    static QStringList numberedFrames(const QString& dir);
+
+    template<typename In, typename T> void front(const QImage& frame, CStreamSlot& slot);
+    template<typename T> void back(CStreamSlot& slot);
+};
+
+#endif // CFRAMESTREAM_H
@@ -0,0 +1,160 @@
+#include "CHysteresisIndex.h"
+#include <algorithm>
+
+struct CGradientOrder
+{
+    const double * mValues;
+    bool operator()(uint a, uint b) const { return mValues[a] > mValues[b]; }
+};
+
+static uint findRoot(QVector<uint>& parent, uint p)
+{
+    uint root = p;
+    while(parent[root] != root) root = parent[root];
+    while(parent[p] != root) {
+        uint next = parent[p];
+        parent[p] = root;
+        p = next;
+    }
+    return root;
+}
+
+CHysteresisIndex::CHysteresisIndex(CMatD& grad)
+        : mHeight(grad.mHeight), mWidth(grad.mWidth), mGlobalMax(0),
+          mCachedLow(-1), mMarkedLeaves(0), mFilled(false), mEdges(grad.mHeight, grad.mWidth, 0)
+{
+    // Gradients packed without row padding, so a pixel is one linear index
+    QVector<double> values(mHeight * mWidth);
+    for(uint i = 0; i < mHeight; i++)
+        memcpy(values.data() + i*mWidth, grad.row(i), mWidth * sizeof(double));
+
+    for(uint p = 0; p < mHeight * mWidth; p++)
+        if(values[p] > 0) mPixels.append(p);
+    mLeafCount = mPixels.size();
+
+    CGradientOrder order = { values.data() };
+    std::sort(mPixels.begin(), mPixels.end(), order);
+    if(mLeafCount > 0) mGlobalMax = values[mPixels[0]];
+
+    mLevel.reserve(2 * mLeafCount);
+    mMax.reserve(2 * mLeafCount);
+    mParent.reserve(2 * mLeafCount);
+    for(uint k = 0; k < mLeafCount; k++) {
+        mLevel.append(values[mPixels[k]]);
+        mMax.append(values[mPixels[k]]);
+        mParent.append(-1);
+    }
+
+    // Union-find over pixels; each set's root remembers the tree node standing for the set
+    QVector<uint> set(mHeight * mWidth);
+    QVector<int> nodeOf(mHeight * mWidth, -1);
+    QVector<uchar> added(mHeight * mWidth, 0);
+    for(uint k = 0; k < mLeafCount; k++) {
+        uint p = mPixels[k];
+        int x = p / mWidth, y = p % mWidth;
+        set[p] = p;
+        nodeOf[p] = k;
+        added[p] = 1;
+
+        for(int dx = -1; dx <= 1; dx++)
+            for(int dy = -1; dy <= 1; dy++) {
+                int nx = x + dx, ny = y + dy;
+                if(nx < 0 || nx >= (int)mHeight || ny < 0 || ny >= (int)mWidth) continue;
+                uint q = nx*mWidth + ny;
+                if(!added[q]) continue;
+
+                uint rp = findRoot(set, p), rq = findRoot(set, q);
+                if(rp == rq) continue;
+
+                int a = nodeOf[rp], b = nodeOf[rq];
+                int merged = mLevel.size();
+                mLevel.append(values[p]);
+                mMax.append(qMax(mMax[a], mMax[b]));
+                mParent.append(-1);
+                mParent[a] = merged;
+                mParent[b] = merged;
+
+                set[rq] = rp;
+                nodeOf[rp] = merged;
+            }
+    }
+
+    mRootAt.resize(mLevel.size());
+}
+
+// Leaves are sorted by decreasing gradient, so the active ones are a prefix
+uint CHysteresisIndex::activeLeaves(double thresholdLow)
+{
+    uint lo = 0, hi = mLeafCount;
+    while(lo < hi) {
+        uint mid = (lo + hi) / 2;
+        if(mLevel[mid] >= thresholdLow) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Merge nodes are created at non-increasing levels, so the active ones are a prefix too
+uint CHysteresisIndex::activeNodes(double thresholdLow)
+{
+    uint lo = mLeafCount, hi = mLevel.size();
+    while(lo < hi) {
+        uint mid = (lo + hi) / 2;
+        if(mLevel[mid] >= thresholdLow) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+CMatrix<uchar>& CHysteresisIndex::evaluate(double thresholdLow, double thresholdHigh)
+{
+    if(mFilled) {
+        for(uint i = 0; i < mHeight; i++)
+            memset(mEdges.row(i), 0, mWidth);
+        mFilled = false;
+        mMarkedLeaves = 0;
+    }
+
+    // Every pixel passes a non-positive low, and together they are one component
+    if(thresholdLow <= 0) {
+        if(mHeight * mWidth > 0 && mGlobalMax >= thresholdHigh) {
+            for(uint i = 0; i < mHeight; i++)
+                memset(mEdges.row(i), 1, mWidth);
+            mFilled = true;
+        }
+        return mEdges;
+    }
+
+    uint leaves = activeLeaves(thresholdLow);
+
+    if(thresholdLow != mCachedLow) {
+        uint nodes = activeNodes(thresholdLow);
+        for(int n = (int)nodes - 1; n >= (int)mLeafCount; n--) {
+            int p = mParent[n];
+            mRootAt[n] = (p >= 0 && p < (int)nodes) ? mRootAt[p] : n;
+        }
+        for(int n = (int)leaves - 1; n >= 0; n--) {
+            int p = mParent[n];
+            mRootAt[n] = (p >= 0 && p < (int)nodes) ? mRootAt[p] : n;
+        }
+        mCachedLow = thresholdLow;
+    }
+
+    for(uint k = 0; k < leaves; k++) {
+        uint p = mPixels[k];
+        mEdges.at(p / mWidth, p % mWidth) = mMax[mRootAt[k]] >= thresholdHigh ? 1 : 0;
+    }
+    for(uint k = leaves; k < mMarkedLeaves; k++) {
+        uint p = mPixels[k];
+        mEdges.at(p / mWidth, p % mWidth) = 0;
+    }
+    mMarkedLeaves = leaves;
+
+    return mEdges;
+}
+
+size_t CHysteresisIndex::bytes() const
+{
+    return mPixels.size() * sizeof(uint) + (mLevel.size() + mMax.size()) * sizeof(double)
+            + (mParent.size() + mRootAt.size()) * sizeof(int) + mEdges.bytes();
+}
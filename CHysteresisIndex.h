@@ -0,0 +1,47 @@
+#ifndef CHYSTERESISINDEX_H
+#define CHYSTERESISINDEX_H
+
+#include "globals.h"
+
+/* Precomputed hysteresis over one suppressed gradient image, for re-thresholding while the
+ * sliders move. Hysteresis keeps a pixel when it is >= low and 8-connected through pixels
+ * >= low to a pixel >= high. So for a given low, the answer only depends on the connected
+ * components of {grad >= low} and the largest gradient in each.
+ *
+ * The index is the merge tree of those components over every possible low: pixels are added
+ * in decreasing gradient order, every pixel is a leaf, and each time a pixel joins two
+ * components a node records the level (that pixel's gradient) and the merged maximum.
+ * Leaves and merge nodes are numbered in creation order, so the nodes active at a given low
+ * are two prefixes of the arrays and every parent has a larger number than its children.
+ *
+ * evaluate(low, high) finds the component root of every active node in one top-down pass
+ * (skipped when only high changed), then marks the active pixels whose root maximum is
+ * >= high. Both passes are linear in the number of pixels >= low: no flood fill, no queue,
+ * no allocation. The result equals CImage::hysteresis exactly. */
+
+class CHysteresisIndex
+{
+public:
+    uint mHeight, mWidth;
+    uint mLeafCount;                        // Pixels with a non-zero gradient
+    QVector<uint> mPixels;                  // Their linear indices, by decreasing gradient
+    QVector<double> mLevel, mMax;           // Per node: level it became active, largest gradient below it
+    QVector<int> mParent;                   // Per node, -1 at the roots
+    double mGlobalMax;
+
+    QVector<int> mRootAt;                   // Component root of each node for mCachedLow
+    double mCachedLow;
+    uint mMarkedLeaves;                     // Prefix of mPixels that may be set in mEdges
+    bool mFilled;                           // mEdges was set everywhere (low <= 0)
+    CMatrix<uchar> mEdges;                  // Last result: 1 on edges, 0 elsewhere
+
+    CHysteresisIndex(CMatD& grad);
+
+    CMatrix<uchar>& evaluate(double thresholdLow, double thresholdHigh);
+
+    uint activeLeaves(double thresholdLow);
+    uint activeNodes(double thresholdLow);
+    size_t bytes() const;
+};
+
+#endif // CHYSTERESISINDEX_H
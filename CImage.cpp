@@ -1,118 +1,807 @@
 #include "CImage.h"
+#include "CSuppressedCache.h"
+#include "CSparseEdges.h"
+#include <QPair>
+#include <algorithm>
 
 CImage::CImage(uint w, uint h)
-        : mWidth(w), mHeight(h)
+        : CImage(QImage(w, h, QImage::Format_RGB32))
 {
-    mSuppressed = 0;
-    mImage = new QImage(w, h, QImage::Format_RGB32);
-    mOriginalImage = new QImage(w, h, QImage::Format_RGB32);
 }
 
+// Check mImage->isNull() afterwards: the engine reports nothing itself, so it can run headless
 CImage::CImage(QString file)
+        : CImage(QImage(file))
+{
+    mSourcePath = file;
+}
+
+CImage::CImage(const QImage& image, QThreadPool * pool)
+        : mWidth(image.width()), mHeight(image.height())
 {
     mSuppressed = 0;
-    mImage = new QImage(file);
-    if(mImage->isNull())
-        QMessageBox::critical(0, "Oops", "Couldn't load that, sorry!");
-    mOriginalImage = new QImage(file);
+    mSuppressedFile = 0;
+    mHysteresisIndex = 0;
+    mHistogram = 0;
+    mKeepDirection = false;
+    mDirection = 0;
+    mTracker = 0;
+    mComponents = 0;
+    mWorkspace = new CCannyWorkspace();
+    mProfiler = 0;
+    mCache = 0;
+    mCancel = 0;
+    mOwnsPool = pool == 0;
+    mPool = mOwnsPool ? new QThreadPool() : pool;
+    mImage = new QImage(image);
+    mOriginalImage = new QImage(image);
 }
 
 CImage::~CImage()
 {
     delete mImage;
+    delete mOriginalImage;
     if(mSuppressed != 0) delete mSuppressed;
+    delete mSuppressedFile;
+    delete mHysteresisIndex;
+    delete mHistogram;
+    delete mDirection;
+    delete mTracker;
+    delete mComponents;
+    delete mWorkspace;
+    if(mOwnsPool) delete mPool;
+}
+
+void CImage::setThreadCount(uint threads)
+{
+    mPool->setMaxThreadCount(qMax(1u, threads));
+}
+
+uint CImage::threadCount()
+{
+    return mPool->maxThreadCount();
+}
+
+bool CImage::saveSuppressed(const QString& path, QString * error)
+{
+    if(mSuppressed == 0) {
+        if(error) *error = "nothing to save before canny()";
+        return false;
+    }
+    CStageTimer stage(mProfiler, "saveSuppressed", (qint64)mSuppressed->mHeight * mSuppressed->mWidth);
+    stage.mBytes = mSuppressed->bytes();
+    return CMappedFile::saveMatrix(*mSuppressed, path, error);
+}
+
+bool CImage::loadSuppressed(const QString& path, QString * error)
+{
+    CStageTimer stage(mProfiler, "loadSuppressed", 0);
+    CMappedFile * file = new CMappedFile();
+    CMatD * suppressed = file->mapMatrix<double>(path);
+    if(suppressed == 0) {
+        if(error) *error = file->mError;
+        delete file;
+        return false;
+    }
+    delete mSuppressed;
+    delete mSuppressedFile;
+    delete mHysteresisIndex;
+    mHysteresisIndex = 0;
+    delete mDirection;
+    mDirection = 0;
+    mSuppressed = suppressed;
+    mSuppressedFile = file;
+    mHeight = suppressed->mHeight;
+    mWidth = suppressed->mWidth;
+    stage.mPixels = (qint64)mHeight * mWidth;
+
+    // Counting the rows also faults the mapping in
+    if(mHistogram == 0) mHistogram = new CMagnitudeHistogram();
+    mHistogram->clear();
+    QVector<uint> bins(CHISTOGRAM_BINS, 0);
+    for(uint i = 0; i < mHeight; i++)
+        CMagnitudeHistogram::count(mSuppressed->row(i), mWidth, bins.data());
+    mHistogram->add(bins.constData());
+    return true;
 }
 
 void CImage::useSuppressed()
 {
     if(mSuppressed == 0) return;
-    delete mImage;
-    mImage = mSuppressed->toNewImage();
+    exportImage(*mSuppressed);
 }
 
+// Meant for repeated calls with new thresholds: the first call indexes mSuppressed
 void CImage::useHysteresis(double thresholdLow, double thresholdHigh)
 {
     if(mSuppressed == 0) return;
-    CMatrix<int> * traced = hysteresis(*mSuppressed, thresholdLow, thresholdHigh);
+    qint64 pixels = (qint64)mSuppressed->mHeight * mSuppressed->mWidth;
+    if(mHysteresisIndex == 0) {
+        CStageTimer stage(mProfiler, "hysteresisIndex", pixels);
+        mHysteresisIndex = new CHysteresisIndex(*mSuppressed);
+        stage.mBytes = mHysteresisIndex->bytes();
+    }
+    CStageTimer stage(mProfiler, "hysteresisEvaluate", pixels);
+    CMatrix<uchar>& traced = mHysteresisIndex->evaluate(thresholdLow, thresholdHigh);
+    stage.stop();
 
-    delete mImage;
-    mImage = traced->toNewImage();
+    exportImage(traced);
+}
 
+void CImage::sparseHysteresis(double thresholdLow, double thresholdHigh, CSparseEdges& out)
+{
+    if(mSuppressed == 0) return;
+    CMatrix<uchar> * traced = hysteresis(*mSuppressed, thresholdLow, thresholdHigh);
+    CStageTimer stage(mProfiler, "sparseEdges", (qint64)traced->mHeight * traced->mWidth);
+    out.extract(*traced, mDirection);
+    stage.mBytes = (out.mRuns.size() + out.mRowStart.size()) * sizeof(quint32) +
+                   (out.mPoints.size() + out.mChainPoints.size()) * sizeof(CEdgePoint);
     delete traced;
 }
 
-void CImage::canny(double blurSigma, bool useR, bool useG, bool useB)
+bool CImage::prepareDirection()
+{
+    if(!mKeepDirection) {
+        delete mDirection;
+        mDirection = 0;
+        return false;
+    }
+    if(mDirection != 0 && (mDirection->mHeight != mHeight || mDirection->mWidth != mWidth)) {
+        delete mDirection;
+        mDirection = 0;
+    }
+    if(mDirection == 0) mDirection = new CMatrix<uchar>(mHeight, mWidth);
+    return true;
+}
+
+// Thresholds for useHysteresis() or hysteresis() from the last canny(); false before the first
+bool CImage::autoThresholds(CMagnitudeHistogram::Rule rule, double& thresholdLow, double& thresholdHigh,
+                            double highPercentile, double lowRatio)
+{
+    if(mHistogram == 0) return false;
+    return mHistogram->thresholds(rule, thresholdLow, thresholdHigh, highPercentile, lowRatio);
+}
+
+// Writes m rescaled to 8-bit levels into mImage, reusing its buffer when it can
+template<typename T> void CImage::exportImage(CMatrix<T>& m)
+{
+    CStageTimer stage(mProfiler, "export", (qint64)m.mHeight * m.mWidth);
+    const uchar * before = mImage->constBits();
+    m.toImage(*mImage);
+    if(mImage->constBits() != before)
+        stage.mBytes = (qint64)mImage->bytesPerLine() * mImage->height();
+}
+
+/* Arithmetic of each working type. Sum holds any CStencil response without overflow, Wide its
+ * products with the direction bin slopes, unit() is the value that stands for intensity 1.0,
+ * and the slopes are scaled by slopeScale() so that the fixed-point type can test them in
+ * integers. magnitude() brings the response to Prewitt's scale (see CStencil::scale). */
+template<typename T> struct CWorkingType
 {
-    timing("Starting Canny edge detection.", true);
-    CMatD gaussian = gaussianFilter(blurSigma);
+    typedef T Sum;
+    typedef T Wide;
+    static T magnitude(Sum gx, Sum gy, double scale) { return std::sqrt(gx*gx + gy*gy) * (T)scale; }
+    static Sum slopeScale() { return 1; }
+    static Sum tan1() { return 0.41421356237309503; }
+    static Sum tan3() { return 2.4142135623730949; }
+    static double unit() { return 1; }
+};
+
+/* Blurred levels with 4 fractional bits (see blur()): at most 4080, so Prewitt sums stay below
+ * 2^14 and Scharr's below 2^16, but a Scharr sum times tan3() needs more than 32 bits */
+template<> struct CWorkingType<short>
+{
+    typedef int Sum;
+    typedef qint64 Wide;
+    static short magnitude(int gx, int gy, double scale) { return (short)lrint(sqrt((double)gx*gx + (double)gy*gy) * scale); }
+    static int slopeScale() { return 1 << 15; }
+    static int tan1() { return 13573; }
+    static int tan3() { return 79109; }
+    static double unit() { return 256 * 16; }
+};
+
+bool CImage::canny(double blurSigma, bool useR, bool useG, bool useB, Precision precision, Operator op)
+{
+    // The variant is a QString, so it is only built with a cache: without one a frame allocates nothing
+    QString key = mCache ? cacheKey(blurSigma, useR, useG, useB, cacheVariant(precision, op)) : QString();
+    if(!key.isEmpty() && mCache->fetch(key, *this)) return true;
+
+    bool done;
+    switch(precision) {
+    case PrecisionFloat: done = cannyAs<float, float>(blurSigma, useR, useG, useB, op); break;
+    case PrecisionFixed: done = cannyAs<uchar, short>(blurSigma, useR, useG, useB, op); break;
+    default: done = cannyAs<double, double>(blurSigma, useR, useG, useB, op);
+    }
+    if(done) storeInCache(key);
+    return done;
+}
+
+QByteArray CImage::sourceHash()
+{
+    if(mSourceHash.isEmpty() && !mSourcePath.isEmpty()) {
+        CStageTimer stage(mProfiler, "sourceHash", (qint64)mWidth * mHeight);
+        mSourceHash = CSuppressedCache::hashFile(mSourcePath);
+    }
+    return mSourceHash;
+}
+
+// Prewitt adds nothing, which keeps the keys written before there was a choice
+QString CImage::cacheVariant(Precision precision, Operator op)
+{
+    QString variant = precision == PrecisionFloat ? "float" : precision == PrecisionFixed ? "fixed" : "double";
+    if(op == OperatorSobel) variant += "-sobel";
+    else if(op == OperatorScharr) variant += "-scharr";
+    return variant;
+}
 
-    CMatD image(mImage, useR, useG, useB);
-    mHeight = image.mHeight;
-    mWidth = image.mWidth;
+QString CImage::pyramidCacheVariant(double flagThreshold)
+{
+    return "pyramid" + QString::number(flagThreshold, 'g', 17);
+}
 
-    timing("Matrix constructed.");
+// Empty without a cache or a source to key it by
+QString CImage::cacheKey(double blurSigma, bool useR, bool useG, bool useB, const QString& variant)
+{
+    if(mCache == 0 || sourceHash().isEmpty()) return QString();
+    return CSuppressedCache::key(mSourceHash, blurSigma, useR, useG, useB, variant);
+}
 
-    CMatD * filtered = image.filterBy(gaussian);
+void CImage::storeInCache(const QString& key)
+{
+    if(key.isEmpty() || mSuppressed == 0) return;
+    CStageTimer stage(mProfiler, "cacheStore", (qint64)mWidth * mHeight);
+    stage.mBytes = mSuppressed->bytes();
+    mCache->store(key, *mSuppressed);
+}
 
-    timing("Matrix filtered.");
+// The pipeline on input matrices of type In and blurred/gradient matrices of type T
+template<typename In, typename T> bool CImage::cannyAs(double blurSigma, bool useR, bool useG, bool useB, Operator op)
+{
+    // Every intermediate is a view into the workspace; the stages' byte counts are what they take from it
+    mWorkspace->beginFrame();
+    mHeight = mImage->height();
+    mWidth = mImage->width();
+
+    CStageTimer ingest(mProfiler, "ingest", (qint64)mWidth * mHeight);
+    CMatrix<In> image(mWorkspace->take<In>(mHeight, mWidth), mHeight, mWidth);
+    image.fromImage(mImage, useR, useG, useB);
+    ingest.mBytes = image.bytes();
+    ingest.stop();
+    if(cancelled()) return false;
+
+    if(!runStages<In, T>(image, blurSigma, op)) return false;
+    exportImage(image);
+    return true;
+}
 
-    CMatD prewittX(3, 3, 0), prewittY(3, 3, 0);
-    for(uint i = 0; i < 3; i++) {
-        prewittX[i][0] = -1;
-        prewittX[i][2] = +1;
-        prewittY[0][i] = -1;
-        prewittY[2][i] = +1;
+template<typename In, typename T> bool CImage::runStages(CMatrix<In>& in, double blurSigma, Operator op,
+                                                         CMatD * suppressed, CMagnitudeHistogram * histogram)
+{
+    CMatD& gaussian = mWorkspace->gaussian(blurSigma);
+    mHeight = in.mHeight;
+    mWidth = in.mWidth;
+    qint64 pixels = (qint64)mWidth * mHeight;
+    uint threads = threadCount();
+
+    // The separable passes take a scratch matrix of the output's size
+    CStageTimer blurStage(mProfiler, "blur", pixels, threads);
+    CMatrix<T> filtered(mWorkspace->take<T>(mHeight, mWidth), mHeight, mWidth);
+    blur(in, filtered, gaussian);
+    blurStage.mBytes = 2 * filtered.bytes();
+    blurStage.stop();
+    if(cancelled()) return false;
+
+    CStageTimer gradientStage(mProfiler, "gradient", pixels, threads);
+    CMatrix<T> magnitude(mWorkspace->take<T>(mHeight, mWidth), mHeight, mWidth);
+    CMatrix<uchar> direction(mWorkspace->take<uchar>(mHeight, mWidth), mHeight, mWidth);
+    parallelBands(mPool, mHeight, [&](uint rowBegin, uint rowEnd) {
+        switch(op) {
+        case OperatorSobel: gradient<CSobel>(filtered, magnitude, direction, rowBegin, rowEnd); break;
+        case OperatorScharr: gradient<CScharr>(filtered, magnitude, direction, rowBegin, rowEnd); break;
+        default: gradient<CPrewitt>(filtered, magnitude, direction, rowBegin, rowEnd);
+        }
+    });
+    gradientStage.mBytes = magnitude.bytes() + direction.bytes();
+    gradientStage.stop();
+    if(cancelled()) return false;
+
+    CStageTimer suppressionStage(mProfiler, "suppression", pixels, threads);
+    bool keep = false;
+    if(suppressed == 0) {
+        // mSuppressed outlives the frame, so it is reused rather than taken from the workspace; a mapped one is read-only
+        delete mHysteresisIndex;
+        mHysteresisIndex = 0;
+        if(mSuppressed != 0 && (mSuppressed->mHeight != mHeight || mSuppressed->mWidth != mWidth || mSuppressedFile != 0)) {
+            delete mSuppressed;
+            mSuppressed = 0;
+            delete mSuppressedFile;
+            mSuppressedFile = 0;
+        }
+        if(mSuppressed == 0) {
+            mSuppressed = new CMatD(mHeight, mWidth);
+            suppressionStage.mBytes = mSuppressed->bytes();
+        }
+        if(mHistogram == 0) {
+            mHistogram = new CMagnitudeHistogram();
+            suppressionStage.mBytes += mHistogram->mBins.size() * sizeof(quint64);
+        }
+        suppressed = mSuppressed;
+        histogram = mHistogram;
+        keep = prepareDirection();
     }
+    if(histogram) histogram->clear();
+    parallelBands(mPool, mHeight, [&](uint rowBegin, uint rowEnd) {
+        suppression(*suppressed, magnitude, direction, rowBegin, rowEnd, histogram);
+        for(uint i = rowBegin; keep && i < rowEnd; i++)
+            memcpy(mDirection->row(i), direction.row(i), mWidth);
+    });
+    suppressionStage.stop();
+    return true;
+}
 
-    CMatD * gradX = filtered->filterBy(prewittX);
-    CMatD * gradY = filtered->filterBy(prewittY);
+/* Halving steps for a blur of sigma: each one is a sigma-1 blur and a decimation, which adds
+ * 4^k/4 to the variance at level k. Stops while the blur left for the coarse level is still at
+ * least one of its pixels, below which its gradient would be too coarse to flag edges. */
+uint CImage::pyramidLevel(double sigma)
+{
+    uint level = 0;
+    while(level < CIMAGE_PYRAMID_LEVELS) {
+        double scale = pow(4., level + 1);
+        if(sigma*sigma - (scale - 1) / 3 < scale) break;
+        level++;
+    }
+    return level;
+}
 
-    CMatD * grad = new CMatD(gradX);
-    CMatD * temp = new CMatD(gradY);
+// Sigma-1 blur, then every other row and column into out, of size ((h+1)/2, (w+1)/2)
+void CImage::halve(CMatD& in, CMatD& out)
+{
+    CMatD kernel = gaussianFilter1D(1);
+    CMatD blurred(mWorkspace->take<double>(in.mHeight, in.mWidth), in.mHeight, in.mWidth);
+    blur(in, blurred, kernel);
+    parallelBands(mPool, out.mHeight, [&](uint rowBegin, uint rowEnd) {
+        for(uint i = rowBegin; i < rowEnd; i++) {
+            const double * b = blurred.row(2*i);
+            double * o = out.row(i);
+            for(uint j = 0; j < out.mWidth; j++)
+                o[j] = b[2*j];
+        }
+    });
+}
 
-    grad->squareElementsInPlace();
-    temp->squareElementsInPlace();
-    grad->operator +=(*temp);
-    grad->squareRootElementsInPlace();
+double CImage::cannyPyramid(double blurSigma, bool useR, bool useG, bool useB, double flagThreshold)
+{
+    // With no level to halve to, the result is canny()'s, and so are the cache entries
+    uint levels = pyramidLevel(blurSigma);
+    if(levels == 0) {
+        return canny(blurSigma, useR, useG, useB) ? 1 : -1;
+    }
+    QString key = mCache ? cacheKey(blurSigma, useR, useG, useB, pyramidCacheVariant(flagThreshold)) : QString();
+    if(!key.isEmpty() && mCache->fetch(key, *this)) return 0;
+
+    mWorkspace->beginFrame();
+    CMatD& gaussian = mWorkspace->gaussian(blurSigma);
+    mHeight = mImage->height();
+    mWidth = mImage->width();
+    qint64 pixels = (qint64)mWidth * mHeight;
+    uint threads = threadCount();
+
+    CStageTimer ingest(mProfiler, "ingest", pixels);
+    CMatD image(mWorkspace->take<double>(mHeight, mWidth), mHeight, mWidth);
+    image.fromImage(mImage, useR, useG, useB);
+    ingest.stop();
+    if(cancelled()) return -1;
+
+    CStageTimer pyramidStage(mProfiler, "pyramid", pixels, threads);
+    CMatD level(image.row(0), mHeight, mWidth);
+    for(uint l = 0; l < levels; l++) {
+        uint h = (level.mHeight + 1) / 2, w = (level.mWidth + 1) / 2;
+        CMatD next(mWorkspace->take<double>(h, w), h, w);
+        halve(level, next);
+        level.mData = next.mData;
+        level.mHeight = h;
+        level.mWidth = w;
+        level.mStride = next.mStride;
+    }
+    pyramidStage.stop();
+    if(cancelled()) return -1;
+
+    // The rest of the blur and the gradient at the coarse level; its magnitudes are per coarse pixel
+    CStageTimer coarseStage(mProfiler, "coarse", (qint64)level.mHeight * level.mWidth, threads);
+    uint ch = level.mHeight, cw = level.mWidth, step = 1 << levels;
+    double residual = sqrt(blurSigma*blurSigma - (step*step - 1) / 3.) / step;
+    CMatD coarseKernel = gaussianFilter1D(residual);
+    CMatD coarse(mWorkspace->take<double>(ch, cw), ch, cw), coarseMagnitude(mWorkspace->take<double>(ch, cw), ch, cw);
+    CMatrix<uchar> coarseDirection(mWorkspace->take<uchar>(ch, cw), ch, cw);
+    blur(level, coarse, coarseKernel);
+    parallelBands(mPool, ch, [&](uint rowBegin, uint rowEnd) {
+        gradient(coarse, coarseMagnitude, coarseDirection, rowBegin, rowEnd);
+    });
+    CMatD coarseSuppressed(coarse.row(0), ch, cw);
+    parallelBands(mPool, ch, [&](uint rowBegin, uint rowEnd) {
+        suppression(coarseSuppressed, coarseMagnitude, coarseDirection, rowBegin, rowEnd);
+    });
+
+    // A tile is flagged if a coarse candidate lies within two coarse pixels of it
+    const uint tile = CIMAGE_PYRAMID_TILE;
+    uint tileRows = (mHeight + tile - 1) / tile, tileColumns = (mWidth + tile - 1) / tile;
+    uchar * flags = (uchar*)mWorkspace->take(tileRows * tileColumns);
+    double flagLevel = flagThreshold * step;
+    uint flagged = 0;
+    for(uint t = 0; t < tileRows; t++)
+        for(uint u = 0; u < tileColumns; u++) {
+            int i0 = qMax(0, (int)(t*tile >> levels) - 2), i1 = qMin((int)ch - 1, (int)((qMin(mHeight, (t+1)*tile) - 1) >> levels) + 2);
+            int j0 = qMax(0, (int)(u*tile >> levels) - 2), j1 = qMin((int)cw - 1, (int)((qMin(mWidth, (u+1)*tile) - 1) >> levels) + 2);
+            bool hit = false;
+            for(int i = i0; i <= i1 && !hit; i++)
+                for(int j = j0; j <= j1 && !hit; j++)
+                    hit = coarseSuppressed.at(i,j) >= flagLevel;
+            flags[t*tileColumns + u] = hit;
+            flagged += hit;
+        }
+    coarseStage.stop();
+    if(cancelled()) return -1;
+
+    CStageTimer refineStage(mProfiler, "refine", pixels, threads);
+    delete mHysteresisIndex;
+    mHysteresisIndex = 0;
+    if(mSuppressed != 0 && (mSuppressed->mHeight != mHeight || mSuppressed->mWidth != mWidth || mSuppressedFile != 0)) {
+        delete mSuppressed;
+        mSuppressed = 0;
+        delete mSuppressedFile;
+        mSuppressedFile = 0;
+    }
+    if(mSuppressed == 0) {
+        mSuppressed = new CMatD(mHeight, mWidth);
+        refineStage.mBytes = mSuppressed->bytes();
+    }
+    if(mHistogram == 0) mHistogram = new CMagnitudeHistogram();
+    mHistogram->clear();
+    delete mDirection;
+    mDirection = 0;
+
+    /* Each run of flagged tiles in a tile row is redone from the input with a halo of the
+     * kernel radius plus the two rows and columns that the gradient and suppression reach, so
+     * every pixel of the run sees exactly the neighbourhood it has in the whole frame */
+    uint halo = (gaussian.mWidth - 1) / 2 + 2;
+    const uint maxRun = 8;
+    QAtomicInt nextTileRow(0);
+    parallelBands(mPool, threads, [&](uint, uint) {
+        // One set of patch buffers per thread, for runs of up to maxRun tiles
+        uint patchRows = tile + 2*halo, patchColumns = maxRun*tile + 2*halo;
+        double * patchIn = mWorkspace->take<double>(patchRows, patchColumns);
+        double * patchRowPass = mWorkspace->take<double>(patchRows, patchColumns);
+        double * patchBlurred = mWorkspace->take<double>(patchRows, patchColumns);
+        double * patchMagnitude = mWorkspace->take<double>(patchRows, patchColumns);
+        uchar * patchDirection = mWorkspace->take<uchar>(patchRows, patchColumns);
+        uint * bins = (uint*)mWorkspace->take(CHISTOGRAM_BINS * sizeof(uint));
+        memset(bins, 0, CHISTOGRAM_BINS * sizeof(uint));
+
+        for(uint t = nextTileRow.fetchAndAddRelaxed(1); t < tileRows; t = nextTileRow.fetchAndAddRelaxed(1)) {
+            uint r0 = t*tile, r1 = qMin(mHeight, r0 + tile);
+            for(uint i = r0; i < r1; i++)
+                memset(mSuppressed->row(i), 0, mWidth * sizeof(double));
+
+            for(uint u = 0; u < tileColumns; u++) {
+                if(!flags[t*tileColumns + u]) continue;
+                uint runEnd = u + 1;
+                while(runEnd < tileColumns && runEnd - u < maxRun && flags[t*tileColumns + runEnd]) runEnd++;
+                uint c0 = u*tile, c1 = qMin(mWidth, runEnd*tile);
+                u = runEnd - 1;
+
+                uint pr0 = r0 > halo ? r0 - halo : 0, pr1 = qMin(mHeight, r1 + halo);
+                uint pc0 = c0 > halo ? c0 - halo : 0, pc1 = qMin(mWidth, c1 + halo);
+                uint ph = pr1 - pr0, pw = pc1 - pc0;
+                CMatD in(patchIn, ph, pw), rows(patchRowPass, ph, pw), blurred(patchBlurred, ph, pw);
+                CMatD magnitude(patchMagnitude, ph, pw);
+                CMatrix<uchar> direction(patchDirection, ph, pw);
+                for(uint i = 0; i < ph; i++)
+                    memcpy(in.row(i), image.row(pr0 + i) + pc0, pw * sizeof(double));
+                in.filterRows(rows, gaussian, 0, ph);
+                rows.filterColumns(blurred, gaussian, 0, ph);
+                gradient(blurred, magnitude, direction, 0, ph);
+
+                // Suppression writes over the row pass, which is no longer needed
+                suppression(rows, magnitude, direction, r0 - pr0, r1 - pr0);
+                for(uint i = r0; i < r1; i++) {
+                    double * o = mSuppressed->row(i) + c0;
+                    memcpy(o, rows.row(i - pr0) + (c0 - pc0), (c1 - c0) * sizeof(double));
+                    CMagnitudeHistogram::count(o, c1 - c0, bins);
+                }
+            }
+        }
+        mHistogram->add(bins);
+    });
+    refineStage.stop();
 
-    CMatD * theta = CMatD::atan2(*gradY, *gradX);
-    CMatrix<int> * thetaClamped = new CMatrix<int>(mHeight, mWidth);
+    exportImage(image);
+    storeInCache(key);
+    return (double)flagged / (tileRows * tileColumns);
+}
 
-    timing("Gradient and angle calculated.");
+void CImage::cannyRegions(const QVector<QRect>& rects, double blurSigma, bool useR, bool useG, bool useB, Precision precision)
+{
+    switch(precision) {
+    case PrecisionFloat: cannyRegionsAs<float, float>(rects, blurSigma, useR, useG, useB); break;
+    case PrecisionFixed: cannyRegionsAs<uchar, short>(rects, blurSigma, useR, useG, useB); break;
+    default: cannyRegionsAs<double, double>(rects, blurSigma, useR, useG, useB);
+    }
+}
 
-    for(uint i = 0; i < mHeight; i++)
-        for(uint j = 0; j < mWidth; j++) {
-            double t = theta->at(i,j);
-            if(t < 0) t += M_PI;
+template<typename In, typename T> void CImage::cannyRegionsAs(const QVector<QRect>& rects, double blurSigma, bool useR, bool useG, bool useB)
+{
+    mHeight = mImage->height();
+    mWidth = mImage->width();
+    QRect frame(0, 0, mWidth, mHeight);
+    QVector<QRect> clipped;
+    QRect bounds;
+    qint64 pixels = 0;
+    for(int k = 0; k < rects.size(); k++) {
+        QRect r = rects[k].intersected(frame);
+        if(r.isEmpty()) continue;
+        clipped.append(r);
+        bounds = bounds.united(r);
+        pixels += (qint64)r.width() * r.height();
+    }
+    uint threads = threadCount();
+    CStageTimer stage(mProfiler, "regions", pixels, threads);
+
+    delete mHysteresisIndex;
+    mHysteresisIndex = 0;
+    if(mSuppressed != 0 && (mSuppressed->mHeight != mHeight || mSuppressed->mWidth != mWidth || mSuppressedFile != 0)) {
+        delete mSuppressed;
+        mSuppressed = 0;
+        delete mSuppressedFile;
+        mSuppressedFile = 0;
+    }
+    if(mSuppressed == 0) {
+        mSuppressed = new CMatD(mHeight, mWidth);
+        stage.mBytes = mSuppressed->bytes();
+    }
+    if(mHistogram == 0) mHistogram = new CMagnitudeHistogram();
+    mHistogram->clear();
+    bool keep = prepareDirection();
+    parallelBands(mPool, mHeight, [&](uint rowBegin, uint rowEnd) {
+        for(uint i = rowBegin; i < rowEnd; i++) {
+            memset(mSuppressed->row(i), 0, mWidth * sizeof(double));
+            if(keep) memset(mDirection->row(i), 0, mWidth);
+        }
+    });
+
+    // One patch at a time, each stage over its rows in bands as in canny()
+    for(int k = 0; k < clipped.size(); k++) {
+        mWorkspace->beginFrame();
+        CMatD& gaussian = mWorkspace->gaussian(blurSigma);
+        uint halo = (gaussian.mWidth - 1) / 2 + 2;
+        uint r0 = clipped[k].top(), r1 = clipped[k].bottom() + 1, c0 = clipped[k].left(), c1 = clipped[k].right() + 1;
+        uint pr0 = r0 > halo ? r0 - halo : 0, pr1 = qMin(mHeight, r1 + halo);
+        uint pc0 = c0 > halo ? c0 - halo : 0, pc1 = qMin(mWidth, c1 + halo);
+        uint ph = pr1 - pr0, pw = pc1 - pc0;
+
+        CMatrix<In> in(mWorkspace->take<In>(ph, pw), ph, pw);
+        in.fromImage(mImage, useR, useG, useB, pr0, pc0);
+        CMatrix<T> blurred(mWorkspace->take<T>(ph, pw), ph, pw);
+        blur(in, blurred, gaussian);
+        CMatrix<T> magnitude(mWorkspace->take<T>(ph, pw), ph, pw);
+        CMatrix<uchar> direction(mWorkspace->take<uchar>(ph, pw), ph, pw);
+        parallelBands(mPool, ph, [&](uint rowBegin, uint rowEnd) {
+            gradient(blurred, magnitude, direction, rowBegin, rowEnd);
+        });
+        CMatD out(mWorkspace->take<double>(ph, pw), ph, pw);
+        parallelBands(mPool, r1 - r0, [&](uint rowBegin, uint rowEnd) {
+            suppression(out, magnitude, direction, r0 - pr0 + rowBegin, r0 - pr0 + rowEnd);
+            for(uint i = r0 + rowBegin; i < r0 + rowEnd; i++) {
+                memcpy(mSuppressed->row(i) + c0, out.row(i - pr0) + (c0 - pc0), (c1 - c0) * sizeof(double));
+                if(keep) memcpy(mDirection->row(i) + c0, direction.row(i - pr0) + (c0 - pc0), c1 - c0);
+            }
+        });
+    }
 
-            if(t <= M_PI/8) thetaClamped->at(i,j) = 3;
-            else if(t <= 3*M_PI/8) thetaClamped->at(i,j) = 2;
-            else if(t <= 5*M_PI/8) thetaClamped->at(i,j) = 1;
-            else if(t <= 7*M_PI/8) thetaClamped->at(i,j) = 4;
-            else thetaClamped->at(i,j) = 3;
+    // Each row's spans merged, so an overlap is counted once
+    uint * bins = (uint*)mWorkspace->take(CHISTOGRAM_BINS * sizeof(uint));
+    memset(bins, 0, CHISTOGRAM_BINS * sizeof(uint));
+    QVector<QPair<uint, uint> > spans;
+    for(int i = bounds.top(); i <= bounds.bottom(); i++) {
+        spans.resize(0);
+        for(int k = 0; k < clipped.size(); k++)
+            if(i >= clipped[k].top() && i <= clipped[k].bottom())
+                spans.append(qMakePair((uint)clipped[k].left(), (uint)clipped[k].right() + 1));
+        std::sort(spans.begin(), spans.end());
+        uint end = 0;
+        for(int s = 0; s < spans.size(); s++) {
+            uint begin = qMax(spans[s].first, end);
+            if(spans[s].second > begin)
+                CMagnitudeHistogram::count(mSuppressed->row(i) + begin, spans[s].second - begin, bins);
+            end = qMax(end, spans[s].second);
         }
+    }
+    mHistogram->add(bins);
+}
 
-    if(mSuppressed != 0) delete mSuppressed;
-    mSuppressed = suppression(*grad, *thetaClamped);
+// Implicitly 0-padded, like CMatrix::filterBy, with every pass split into row bands
+void CImage::filter(CMatD& in, CMatD& out, CMatD& kernel)
+{
+    CMatD * columnKernel, * rowKernel;
+    if(kernel.separate(&columnKernel, &rowKernel)) {
+        filterSeparable(in, out, *columnKernel, *rowKernel);
+        delete columnKernel;
+        delete rowKernel;
+        return;
+    }
+    parallelBands(mPool, in.mHeight, [&](uint rowBegin, uint rowEnd) {
+        in.filterByDirect(out, kernel, rowBegin, rowEnd);
+    });
+}
 
-    timing("Clamped and suppressed.");
+template<typename T> void CImage::filterSeparable(CMatrix<T>& in, CMatrix<T>& out, CMatrix<T>& columnKernel, CMatrix<T>& rowKernel)
+{
+    CMatrix<T> rows(in.mHeight, in.mWidth);
+    filterSeparable(in, out, columnKernel, rowKernel, rows);
+}
 
-    delete mImage;
-    mImage = image.toNewImage();
+// `rows` receives the row pass and must have the size of `in`
+template<typename T> void CImage::filterSeparable(CMatrix<T>& in, CMatrix<T>& out, CMatrix<T>& columnKernel, CMatrix<T>& rowKernel, CMatrix<T>& rows)
+{
+    parallelBands(mPool, in.mHeight, [&](uint rowBegin, uint rowEnd) {
+        in.filterRows(rows, rowKernel, rowBegin, rowEnd);
+    });
+    parallelBands(mPool, in.mHeight, [&](uint rowBegin, uint rowEnd) {
+        rows.filterColumns(out, columnKernel, rowBegin, rowEnd);
+    });
+}
 
-    delete theta;
-    delete grad;
-    delete temp;
-    delete gradX;
-    delete gradY;
-    delete filtered;
+void CImage::blur(CMatD& in, CMatD& out, CMatD& kernel)
+{
+    CMatD rows(mWorkspace->take<double>(in.mHeight, in.mWidth), in.mHeight, in.mWidth);
+    filterSeparable(in, out, kernel, kernel, rows);
 }
 
-CMatD * CImage::suppression(CMatD& grad, CMatrix<int>& theta)
+void CImage::blur(CMatrix<float>& in, CMatrix<float>& out, CMatD& kernel)
 {
-    CMatD * out = new CMatD(&grad);
-    for(uint i = 0; i < mHeight; i++)
-        for(uint j = 0; j < mWidth; j++) {
+    CMatrix<float> kernelF(mWorkspace->take<float>(1, kernel.mWidth), 1, kernel.mWidth);
+    for(uint t = 0; t < kernel.mWidth; t++)
+        kernelF.at(0,t) = kernel.at(0,t);
+    CMatrix<float> rows(mWorkspace->take<float>(in.mHeight, in.mWidth), in.mHeight, in.mWidth);
+    filterSeparable(in, out, kernelF, kernelF, rows);
+}
+
+/* Fixed-point blur of 8-bit levels. The taps are rounded to weights out of 256, so the row
+ * pass fits in 16 bits; the column pass sums in 32 bits and keeps 4 fractional bits, which
+ * leaves levels * 16 (at most 4080) in `out`. */
+void CImage::blur(CMatrix<uchar>& in, CMatrix<short>& out, CMatD& kernel)
+{
+    int n = kernel.mWidth, range = (n-1)/2;
+    int * weights = (int*)mWorkspace->take(n * sizeof(int));
+    int total = 0;
+    for(int t = 0; t < n; t++)
+        total += weights[t] = (int)floor(kernel.at(0,t) * 256 + 0.5);
+    weights[range] += 256 - total;          // Rounding residue goes to the centre tap
+    const int * k = weights + range;
+
+    int h = in.mHeight, w = in.mWidth;
+    CMatrix<ushort> rows(mWorkspace->take<ushort>(h, w), h, w);
+    parallelBands(mPool, h, [&](uint rowBegin, uint rowEnd) {
+        for(uint i = rowBegin; i < rowEnd; i++) {
+            const uchar * src = in.row(i);
+            ushort * o = rows.row(i);
+            for(int j = 0; j < w; j++)
+                o[j] = 0;
+            for(int y = -range; y <= range; y++) {
+                int jFrom = qMax(0, -y), jTo = qMin(w, w-y);
+                if(jFrom < jTo) simdMulAdd(o + jFrom, src + jFrom + y, (ushort)k[y], jTo - jFrom);
+            }
+        }
+    });
+    parallelBands(mPool, h, [&](uint rowBegin, uint rowEnd) {
+        int * sum = (int*)mWorkspace->take(w * sizeof(int));
+        for(int i = rowBegin; i < (int)rowEnd; i++) {
+            int xFrom = qMax(-range, -i), xTo = qMin(range, h-1-i);
+            for(int j = 0; j < w; j++)
+                sum[j] = 0;
+            for(int x = xFrom; x <= xTo; x++)
+                simdMulAdd(sum, rows.row(i+x), k[x], w);
+            short * o = out.row(i);
+            for(int j = 0; j < w; j++)
+                o[j] = (short)((sum[j] + (1 << 11)) >> 12);
+        }
+    });
+}
+
+/* Fused stencil gradient for rows [rowBegin, rowEnd): reads `blurred` once and writes the
+ * gradient magnitude and a direction code (1 vertical, 2 and 4 diagonal, 3 horizontal, as
+ * suppression() expects). Borders are implicitly 0-padded.
+ *
+ * Every CStencil is the outer product of a 3-tap smoothing and a 3-tap difference, so each
+ * input row contributes its horizontal difference to gx and its horizontal smoothing to gy,
+ * and both come out of one pass. The edge columns are peeled off so that the rest of each row
+ * runs without tests. For Prewitt the sums are formed in the same order as the separable
+ * filterBy path, which keeps the magnitudes bit-identical to filtering with the 3x3 kernels
+ * and squaring, adding and rooting. */
+template<typename S, typename T> void CImage::gradient(CMatrix<T>& blurred, CMatrix<T>& magnitude, CMatrix<uchar>& direction, uint rowBegin, uint rowEnd)
+{
+    typedef CWorkingType<T> W;
+    typedef typename W::Sum Sum;
+    typedef typename W::Wide Wide;
+
+    // Bin edges of atan2(gy, gx) at pi/8 and 3pi/8, as slopes
+    const Wide tan1 = W::tan1(), tan3 = W::tan3(), scale = W::slopeScale();
+
+    int h = blurred.mHeight, w = blurred.mWidth;
+
+    // Rolling per-row differences (slots 0-2) and smoothings (slots 3-5) for rows i-1, i and i+1
+    CMatrix<Sum> lines(mWorkspace->take<Sum>(6, w), 6, w);
+    for(int r = (int)rowBegin - 1; r <= (int)rowEnd; r++) {
+        if(r >= 0 && r < h) {
+            const T * in = blurred.row(r);
+            Sum * diff = lines.row((r+3) % 3), * sum = lines.row(3 + (r+3) % 3);
+            if(w == 1) {
+                diff[0] = 0;
+                sum[0] = stencilWeigh<S::sCentre>((Sum)in[0]);
+            } else {
+                diff[0] = in[1];
+                sum[0] = stencilWeigh<S::sCentre>((Sum)in[0]) + stencilWeigh<S::sSide>((Sum)in[1]);
+                for(int j = 1; j+1 < w; j++) {
+                    diff[j] = -in[j-1] + in[j+1];
+                    sum[j] = stencilWeigh<S::sSide>((Sum)in[j-1]) + stencilWeigh<S::sCentre>((Sum)in[j])
+                           + stencilWeigh<S::sSide>((Sum)in[j+1]);
+                }
+                diff[w-1] = -in[w-2];
+                sum[w-1] = stencilWeigh<S::sSide>((Sum)in[w-2]) + stencilWeigh<S::sCentre>((Sum)in[w-1]);
+            }
+        }
+
+        int i = r - 1;         // Row whose neighbours are now all available
+        if(i < (int)rowBegin) continue;
+
+        const Sum * diffUp = i > 0 ? lines.row((i+2) % 3) : 0, * diffDown = i+1 < h ? lines.row((i+4) % 3) : 0;
+        const Sum * sumUp = i > 0 ? lines.row(3 + (i+2) % 3) : 0, * sumDown = i+1 < h ? lines.row(3 + (i+4) % 3) : 0;
+        const Sum * diffMid = lines.row((i+3) % 3);
+        T * mag = magnitude.row(i);
+        uchar * dir = direction.row(i);
+
+        for(int j = 0; j < w; j++) {
+            Sum gx = 0, gy = 0;
+            if(diffUp) gx += stencilWeigh<S::sSide>(diffUp[j]);
+            gx += stencilWeigh<S::sCentre>(diffMid[j]);
+            if(diffDown) gx += stencilWeigh<S::sSide>(diffDown[j]);
+            if(sumUp) gy = -sumUp[j];
+            if(sumDown) gy += sumDown[j];
+
+            mag[j] = W::magnitude(gx, gy, S::scale());
+
+            // Fold into the upper half plane, then bin by slope instead of by angle
+            Sum ax = gx < 0 ? -gx : gx, ay = gy < 0 ? -gy : gy;
+            bool negative = (gy < 0) != (gx < 0);
+            if((Wide)ay * scale <= tan1 * ax) dir[j] = 3;
+            else if((Wide)ay * scale <= tan3 * ax) dir[j] = negative ? 4 : 2;
+            else dir[j] = 1;
+        }
+    }
+}
+
+CMatD * CImage::suppression(CMatD& grad, CMatrix<uchar>& theta)
+{
+    CMatD * out = new CMatD(grad.mHeight, grad.mWidth);
+    suppression(*out, grad, theta, 0, grad.mHeight);
+    return out;
+}
+
+/* Writes rows [rowBegin, rowEnd) of out, as intensities; reads one halo row of grad on either side.
+ * The frame is grad's size, so a tile with its halo works as well as a whole image. With a histogram, each finished row is counted while it is still in cache. */
+template<typename T> void CImage::suppression(CMatD& out, CMatrix<T>& grad, CMatrix<uchar>& theta, uint rowBegin, uint rowEnd,
+                                              CMagnitudeHistogram * histogram)
+{
+    const double unit = CWorkingType<T>::unit();
+    const int h = grad.mHeight, w = grad.mWidth;
+    uint * bins = 0;
+    if(histogram) {
+        bins = (uint*)mWorkspace->take(CHISTOGRAM_BINS * sizeof(uint));
+        memset(bins, 0, CHISTOGRAM_BINS * sizeof(uint));
+    }
+    for(uint i = rowBegin; i < rowEnd; i++) {
+        for(int j = 0; j < w; j++) {
+            out[i][j] = grad[i][j] / unit;
+
             int ax, ay, bx, by;
             int angle = theta[i][j];
             if(angle == 1) {
@@ -127,52 +816,47 @@ CMatD * CImage::suppression(CMatD& grad, CMatrix<int>& theta)
             } else if(angle == 4) {
                 ax = i-1; ay = j+1;
                 bx = i+1; by = j-1;
-            } else { qDebug() << angle; QMessageBox::critical(0, "Error", "Corrupt angle."); return out; }
+            } else { qCritical() << "Corrupt angle." << angle; return; }
 
-            if(ax < 0 || ax >= (int)mHeight || ay < 0 || ay >= (int)mWidth) continue;
-            else if(grad[ax][ay] > grad[i][j]) { out->at(i,j) = 0; continue; }
+            if(ax < 0 || ax >= h || ay < 0 || ay >= w) continue;
+            else if(grad[ax][ay] > grad[i][j]) { out[i][j] = 0; continue; }
 
-            if(bx < 0 || bx >= (int)mHeight || by < 0 || by >= (int)mWidth) continue;
-            else if(grad[bx][by] > grad[i][j]) { out->at(i,j) = 0; continue; }
+            if(bx < 0 || bx >= h || by < 0 || by >= w) continue;
+            else if(grad[bx][by] > grad[i][j]) { out[i][j] = 0; continue; }
         }
-    return out;
+        if(bins) CMagnitudeHistogram::count(out.row(i), w, bins);
+    }
+    if(histogram) histogram->add(bins);
 }
 
-CMatrix<int> * CImage::hysteresis(CMatD& grad, double thresholdLow, double thresholdHigh)
+CMatrix<uchar> * CImage::hysteresis(CMatD& grad, double thresholdLow, double thresholdHigh)
 {
-    queue< pair<int, int> > nodes;
-    CMatrix<int> * out = new CMatrix<int>(mHeight, mWidth, 0);
-    for(uint i = 0; i < mHeight; i++)
-        for(uint j = 0; j < mWidth; j++) {
-            if((grad[i][j] >= thresholdHigh) && out->at(i,j) != 1) {
-                nodes.push(pair<uint, uint>(i,j));
-                while(!nodes.empty()) {
-                    pair<int, int> node = nodes.front();
-                    nodes.pop();
-                    int x = node.first, y = node.second;
-                    if(x < 0 || x >= (int)mHeight || y < 0 || y >= (int)mWidth) continue;
-                    if(grad[x][y] < thresholdLow) continue;
-                    if(out->at(x,y) != 1) {
-                        out->at(x,y) = 1;
-                        nodes.push(pair<uint, uint>(x+1,y-1));
-                        nodes.push(pair<uint, uint>(x+1,y  ));
-                        nodes.push(pair<uint, uint>(x+1,y+1));
-                        nodes.push(pair<uint, uint>(x  ,y+1));
-                        nodes.push(pair<uint, uint>(x  ,y-1));
-                        nodes.push(pair<uint, uint>(x-1,y-1));
-                        nodes.push(pair<uint, uint>(x-1,y  ));
-                        nodes.push(pair<uint, uint>(x-1,y+1));
-                    }
-                }
-            }
+    /* The trackers keep their buffers between calls, so repeated thresholds allocate only the
+     * result. Both accept the same pixels; the flood fill is quicker on one thread. */
+    uint threads = threadCount();
+    CStageTimer stage(mProfiler, "hysteresis", (qint64)grad.mHeight * grad.mWidth, threads);
+    CMatrix<uchar> * out = new CMatrix<uchar>(grad.mHeight, grad.mWidth);
+    if(threads > 1) {
+        if(mComponents == 0) mComponents = new CComponentTracker();
+        size_t before = mComponents->bytes();
+        mComponents->track(grad, thresholdLow, thresholdHigh, *out, mPool);
+        stage.mBytes = mComponents->bytes() - before;
+    } else {
+        if(mTracker == 0) {
+            mTracker = new CEdgeTracker(grad.mHeight, grad.mWidth);
+            stage.mBytes = mTracker->bytes();
         }
+        mTracker->track(grad, thresholdLow, thresholdHigh, *out);
+    }
+    stage.mBytes += out->bytes();
     return out;
 }
 
 CMatD CImage::gaussianFilter(double sigma)
 {
-    /* The Gaussian filter is separable, but for simplicity we implement it as a square filter */
-    int n = (int)(2 * floor( (float)sqrt(-log(0.1) * 2 * (sigma*sigma)) ) + 1);
+    /* The Gaussian filter is separable; this square version is kept for callers that want the
+     * full kernel. canny() filters with gaussianFilter1D() along rows and then columns. */
+    int n = gaussianSize(sigma);
     CMatD r(n,n);
 
     for(int i = -(n-1)/2; i <= (n-1)/2; i++)
@@ -185,15 +869,39 @@ CMatD CImage::gaussianFilter(double sigma)
     return r;
 }
 
-void CImage::timing(QString info, bool restart)
+CMatD CImage::gaussianFilter1D(double sigma)
 {
-    static QTime timerInitial, timer;
-    if(restart) {
-        timer.start();
-        timerInitial.start();
-        qDebug() << endl << info << " @ " << timerInitial.toString("hh:mm:ss");
-        return;
-    }
-    qDebug() << info << " @ " << QTime::currentTime().toString("hh:mm:ss") << " (" << timer.elapsed()/1000. << " seconds)";
-    timer.start();
+    // Single-row kernel; its outer product with itself is gaussianFilter(sigma)
+    int n = gaussianSize(sigma);
+    CMatD r(1,n);
+
+    for(int i = -(n-1)/2; i <= (n-1)/2; i++)
+        r[0][(n-1)/2+i] = exp(-(i*i)/(2*(sigma*sigma)));
+
+    r /= r.sum();
+
+    return r;
 }
+
+int CImage::gaussianSize(double sigma)
+{
+    return (int)(2 * floor( (float)sqrt(-log(0.1) * 2 * (sigma*sigma)) ) + 1);
+}
+
+// Instances used outside this file
+template void CImage::gradient<CPrewitt>(CMatD&, CMatD&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CPrewitt>(CMatrix<float>&, CMatrix<float>&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CPrewitt>(CMatrix<short>&, CMatrix<short>&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CSobel>(CMatD&, CMatD&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CSobel>(CMatrix<float>&, CMatrix<float>&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CSobel>(CMatrix<short>&, CMatrix<short>&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CScharr>(CMatD&, CMatD&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CScharr>(CMatrix<float>&, CMatrix<float>&, CMatrix<uchar>&, uint, uint);
+template void CImage::gradient<CScharr>(CMatrix<short>&, CMatrix<short>&, CMatrix<uchar>&, uint, uint);
+template void CImage::suppression(CMatD&, CMatD&, CMatrix<uchar>&, uint, uint, CMagnitudeHistogram*);
+template void CImage::suppression(CMatD&, CMatrix<float>&, CMatrix<uchar>&, uint, uint, CMagnitudeHistogram*);
+template void CImage::suppression(CMatD&, CMatrix<short>&, CMatrix<uchar>&, uint, uint, CMagnitudeHistogram*);
+template void CImage::filterSeparable(CMatD&, CMatD&, CMatD&, CMatD&);
+template bool CImage::runStages<double, double>(CMatD&, double, Operator, CMatD*, CMagnitudeHistogram*);
+template bool CImage::runStages<float, float>(CMatrix<float>&, double, Operator, CMatD*, CMagnitudeHistogram*);
+template bool CImage::runStages<uchar, short>(CMatrix<uchar>&, double, Operator, CMatD*, CMagnitudeHistogram*);
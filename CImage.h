@@ -2,6 +2,23 @@
 #define CIMAGE_H
 
 #include "globals.h"
+#include "CCannyWorkspace.h"
+#include "CEdgeTracker.h"
+#include "CComponentTracker.h"
+#include "CProfiler.h"
+#include "CHysteresisIndex.h"
+#include "CMagnitudeHistogram.h"
+#include "CMappedFile.h"
+#include "CStencil.h"
+#include <QRect>
+
+class CSuppressedCache;
+class CSparseEdges;
+
+// Pyramid mode: full-resolution tile side, deepest level, default flag threshold (see cannyPyramid)
+#define CIMAGE_PYRAMID_TILE 128
+#define CIMAGE_PYRAMID_LEVELS 4
+#define CIMAGE_PYRAMID_FLAG 0.007
 
 class CImage
 {
@@ -9,22 +26,121 @@ public:
     uint mWidth, mHeight;
     QImage * mOriginalImage, * mImage;
     CMatD * mSuppressed;
+    CMappedFile * mSuppressedFile;          // Backs mSuppressed after loadSuppressed(), else 0
+    CHysteresisIndex * mHysteresisIndex;    // Built from mSuppressed on first use, for the sliders
+    CMagnitudeHistogram * mHistogram;       // Of mSuppressed's edge candidates, counted by canny()
+    bool mKeepDirection;                    // Have canny() and cannyRegions() keep their direction bins
+    CMatrix<uchar> * mDirection;            // Those bins (see gradient()) for mSuppressed, or 0; for CSparseEdges
+    CCannyWorkspace * mWorkspace;           // Scratch of canny() and its stages, kept between frames
+    CEdgeTracker * mTracker;                // Buffers for hysteresis(), created on first use
+    CComponentTracker * mComponents;        // The same on more than one thread
+    QThreadPool * mPool;                    // Runs the row bands of every pipeline stage
+    bool mOwnsPool;                         // False when it was given to the constructor
+    CProfiler * mProfiler;                  // Receives a sample per stage run; not owned, 0 for none
+    CSuppressedCache * mCache;              // Consulted by canny() and cannyPyramid(); not owned, 0 for none
+    const QAtomicInt * mCancel;             // Not owned, 0 for none; see cancelled()
+    QString mSourcePath;                    // File the image came from, if any
+    QByteArray mSourceHash;                 // Of its bytes, for mCache; see sourceHash()
 
     CImage(uint w, uint h);
     CImage(QString file);
+    // With a pool, bands run on it and setThreadCount() changes it for everyone who shares it
+    CImage(const QImage& image, QThreadPool * pool = 0);
     ~CImage();
 
-    void canny(double blurSigma, bool useR, bool useG, bool useB);
+    /* Once *mCancel is nonzero, canny() and cannyPyramid() return at the next stage boundary.
+     * mSuppressed, mHistogram and mImage are only written by the last stage, so a cancelled run
+     * leaves the previous result in place, stores nothing in mCache and reports that it stopped. */
+    bool cancelled() const { return mCancel != 0 && mCancel->loadAcquire() != 0; }
+
+    void setThreadCount(uint threads);
+    uint threadCount();
+
+    /* Working type of canny(). Double is the reference; float halves the memory traffic; fixed
+     * point blurs 8-bit levels into int16 and takes int16 gradients. mSuppressed stays double
+     * in every mode, on the same intensity scale. */
+    enum Precision { PrecisionDouble, PrecisionFloat, PrecisionFixed };
+
+    /* Gradient stencil of canny() (see CStencil). Sobel and Scharr weigh the centre row and
+     * column more and are less biased in direction; all three give magnitudes on one scale. */
+    enum Operator { OperatorPrewitt, OperatorSobel, OperatorScharr };
+
+    /* With mCache and a source, a cached mSuppressed for these parameters is mapped instead of
+     * recomputed, and mImage is left as it was; otherwise the result is stored for next time.
+     * False when cancelled. */
+    bool canny(double blurSigma, bool useR, bool useG, bool useB, Precision precision = PrecisionDouble,
+               Operator op = OperatorPrewitt);
+    template<typename In, typename T> bool cannyAs(double blurSigma, bool useR, bool useG, bool useB, Operator op = OperatorPrewitt);
+
+    /* What canny() does after ingestion, on a frame already in `in`: blur, gradient and
+     * suppression, with scratch from mWorkspace and bands on mPool. Into `suppressed`, counting
+     * `histogram` if there is one, or with no `suppressed`, into mSuppressed and mHistogram
+     * (and mDirection when kept), which are only touched once the gradient is done. Sets
+     * mHeight and mWidth to the frame's. False when cancelled. */
+    template<typename In, typename T> bool runStages(CMatrix<In>& in, double blurSigma, Operator op,
+                                                     CMatD * suppressed = 0, CMagnitudeHistogram * histogram = 0);
+
+    /* canny() in double for large sigmas, coarse to fine. The blur is mostly done by halving the
+     * image a few times; the coarse level gets the remaining blur and its gradient, and only the
+     * tiles near a coarse candidate of at least flagThreshold are redone at full resolution.
+     * Those come out exactly as in canny(); the others are left 0. Returns the share refined,
+     * 0 when mCache had the result, -1 when cancelled. */
+    double cannyPyramid(double blurSigma, bool useR, bool useG, bool useB, double flagThreshold = CIMAGE_PYRAMID_FLAG);
+    void halve(CMatD& in, CMatD& out);
+    static uint pyramidLevel(double sigma);
+
+    /* canny() over rectangles of the frame only. Each is computed from a patch of the input with
+     * a halo of the kernel radius plus the two pixels the gradient and suppression reach, so
+     * inside the rectangles mSuppressed is exactly what canny() gives at that precision, and
+     * outside them it is 0. mHistogram counts the union of the rectangles once, however they
+     * overlap. Rectangles are clipped to the frame. Apart from clearing mSuppressed, the cost
+     * is that of the patches; mImage and mCache are left alone. Hysteresis on the result
+     * connects edges through the rectangles only. */
+    void cannyRegions(const QVector<QRect>& rects, double blurSigma, bool useR, bool useG, bool useB,
+                      Precision precision = PrecisionDouble);
+    template<typename In, typename T> void cannyRegionsAs(const QVector<QRect>& rects, double blurSigma, bool useR, bool useG, bool useB);
+
+    QByteArray sourceHash();                // mSourceHash, hashing mSourcePath on first use
+    static QString cacheVariant(Precision precision, Operator op = OperatorPrewitt);   // For CSuppressedCache::key
+    static QString pyramidCacheVariant(double flagThreshold);
+    QString cacheKey(double blurSigma, bool useR, bool useG, bool useB, const QString& variant);
+    void storeInCache(const QString& key);
+
+    /* mSuppressed as a raw CMatrix dump (see CMappedFile). Loading maps the dump read-only and
+     * makes mSuppressed a view of it, recounting mHistogram; the next canny() replaces it. */
+    bool saveSuppressed(const QString& path, QString * error = 0);
+    bool loadSuppressed(const QString& path, QString * error = 0);
 
     void useSuppressed();
+
+    /* hysteresis() on mSuppressed, straight into sparse form (see CSparseEdges) without an edge
+     * image; the points carry directions when mDirection is kept */
+    void sparseHysteresis(double thresholdLow, double thresholdHigh, CSparseEdges& out);
+    bool prepareDirection();                // Sizes mDirection to the frame when it is kept, else deletes it
     void useHysteresis(double thresholdLow, double thresholdHigh);
+    bool autoThresholds(CMagnitudeHistogram::Rule rule, double& thresholdLow, double& thresholdHigh,
+                        double highPercentile = 0.8, double lowRatio = 0.4);
+    template<typename T> void exportImage(CMatrix<T>& m);
+
+    template<typename S = CPrewitt, typename T> void gradient(CMatrix<T>& blurred, CMatrix<T>& magnitude, CMatrix<uchar>& direction, uint rowBegin, uint rowEnd);
+    CMatD * suppression(CMatD& grad, CMatrix<uchar>& direction);
+    template<typename T> void suppression(CMatD& out, CMatrix<T>& grad, CMatrix<uchar>& direction, uint rowBegin, uint rowEnd,
+                                          CMagnitudeHistogram * histogram = 0);
+    CMatrix<uchar> * hysteresis(CMatD& grad, double thresholdLow, double thresholdHigh);
+
+    void filter(CMatD& in, CMatD& out, CMatD& kernel);
+    template<typename T> void filterSeparable(CMatrix<T>& in, CMatrix<T>& out, CMatrix<T>& columnKernel, CMatrix<T>& rowKernel);
+    template<typename T> void filterSeparable(CMatrix<T>& in, CMatrix<T>& out, CMatrix<T>& columnKernel, CMatrix<T>& rowKernel, CMatrix<T>& scratch);
 
-    CMatD * suppression(CMatD& grad, CMatrix<int>& thetaClamped);
-    CMatrix<int> * hysteresis(CMatD& grad, double thresholdLow, double thresholdHigh);
+    // Gaussian blur with a gaussianFilter1D() kernel, one overload per precision; scratch comes from mWorkspace
+    void blur(CMatD& in, CMatD& out, CMatD& kernel);
+    void blur(CMatrix<float>& in, CMatrix<float>& out, CMatD& kernel);
+    void blur(CMatrix<uchar>& in, CMatrix<short>& out, CMatD& kernel);
 
-    CMatD gaussianFilter(double sigma);
+    static CMatD gaussianFilter(double sigma);
+    static CMatD gaussianFilter1D(double sigma);
+    static int gaussianSize(double sigma);
 
-    void timing(QString info, bool restart = false);
 };
 
 #endif // CIMAGE_H
@@ -0,0 +1,126 @@
+#include "CImageBatch.h"
+#include <QElapsedTimer>
+#include <QThread>
+
+CImageBatchOptions::CImageBatchOptions()
+        : sigma(1), useR(true), useG(true), useB(true),
+          thresholdLow(0.007), thresholdHigh(0.099), autoThresholds(false), thresholdRule(CMagnitudeHistogram::RulePercentile),
+          highPercentile(0.8), lowRatio(0.4), precision(CImage::PrecisionDouble), gradientOperator(CImage::OperatorPrewitt),
+          threads(qMax(1, QThread::idealThreadCount())), profiler(0)
+{
+}
+
+CImageBatch::CImageBatch(const CImageBatchOptions& options)
+        : mOptions(options), mCount(0), mWidth(0), mHeight(0), mInput(0), mSuppressed(0), mEdges(0), mWallSeconds(0)
+{
+}
+
+CImageBatch::~CImageBatch()
+{
+    delete mSuppressed;
+    delete mEdges;
+    for(int e = 0; e < mEngines.size(); e++)
+        delete mEngines[e];
+}
+
+bool CImageBatch::run(const QVector<QImage>& images)
+{
+    QElapsedTimer wall;
+    wall.start();
+    if(images.isEmpty()) {
+        mError = "no images";
+        return false;
+    }
+    uint w = images[0].width(), h = images[0].height();
+    for(int i = 0; i < images.size(); i++)
+        if(images[i].isNull() || (uint)images[i].width() != w || (uint)images[i].height() != h) {
+            mError = QString("image %1 is null or not %2 x %3").arg(i).arg(w).arg(h);
+            return false;
+        }
+
+    uint count = images.size();
+    uint workers = qMin(qMax(1u, mOptions.threads), count);
+    CStageTimer stage(mOptions.profiler, "batch", (qint64)count * w * h, workers);
+    if(mSuppressed == 0 || count != mCount || w != mWidth || h != mHeight) {
+        delete mSuppressed;
+        delete mEdges;
+        mSuppressed = new CMatD(count * h, w);
+        mEdges = new CMatrix<uchar>(count * h, w);
+        stage.mBytes = mSuppressed->bytes() + mEdges->bytes();
+    }
+    mCount = count;
+    mWidth = w;
+    mHeight = h;
+    mThresholdLow.resize(count);
+    mThresholdHigh.resize(count);
+    while(mEngines.size() < (int)workers) {
+        CImage * engine = new CImage(0, 0);
+        engine->setThreadCount(1);
+        mEngines.append(engine);
+    }
+
+    switch(mOptions.precision) {
+    case CImage::PrecisionFloat: runAs<float, float>(images, workers); break;
+    case CImage::PrecisionFixed: runAs<uchar, short>(images, workers); break;
+    default: runAs<double, double>(images, workers);
+    }
+    mWallSeconds = wall.nsecsElapsed() / 1e9;
+    return true;
+}
+
+double CImageBatch::imagesPerSecond() const
+{
+    return mWallSeconds > 0 ? mCount / mWallSeconds : 0;
+}
+
+// Hands out runs of images with parallelBands(); a run borrows an idle engine for its duration
+template<typename In, typename T> void CImageBatch::runAs(const QVector<QImage>& images, uint workers)
+{
+    mBuffer.beginFrame();
+    mInput = mBuffer.take<In>(mCount * mHeight, mWidth);
+    CMatrix<In> input((In*)mInput, mCount * mHeight, mWidth);
+    double * lows = mThresholdLow.data(), * highs = mThresholdHigh.data();
+
+    mIdle.resize(0);
+    for(uint e = 0; e < workers; e++)
+        mIdle.append(mEngines[e]);
+    mPool.setMaxThreadCount(workers);
+    parallelBands(&mPool, mCount, [&](uint begin, uint end) {
+        CImage * engine;
+        {
+            QMutexLocker locker(&mIdleMutex);
+            engine = mIdle.takeLast();
+        }
+        for(uint i = begin; i < end; i++)
+            process<In, T>(images[i], i, *engine, input, lows[i], highs[i]);
+        QMutexLocker locker(&mIdleMutex);
+        mIdle.append(engine);
+    });
+}
+
+// Ingestion, CImage::runStages() and hysteresis on one image, on the worker's thread
+template<typename In, typename T> void CImageBatch::process(const QImage& image, uint index, CImage& engine, CMatrix<In>& input,
+                                                            double& thresholdLow, double& thresholdHigh)
+{
+    uint h = mHeight, w = mWidth;
+    engine.mWorkspace->beginFrame();
+    CMatrix<In> in(input, index * h, (index + 1) * h);
+    in.fromImage(&image, mOptions.useR, mOptions.useG, mOptions.useB);
+
+    CMatD suppressed(*mSuppressed, index * h, (index + 1) * h);
+    CMagnitudeHistogram * histogram = 0;
+    if(mOptions.autoThresholds) {
+        if(engine.mHistogram == 0) engine.mHistogram = new CMagnitudeHistogram();
+        histogram = engine.mHistogram;
+    }
+    engine.runStages<In, T>(in, mOptions.sigma, mOptions.gradientOperator, &suppressed, histogram);
+
+    thresholdLow = mOptions.thresholdLow;
+    thresholdHigh = mOptions.thresholdHigh;
+    if(histogram)
+        histogram->thresholds(mOptions.thresholdRule, thresholdLow, thresholdHigh, mOptions.highPercentile, mOptions.lowRatio);
+
+    if(engine.mTracker == 0) engine.mTracker = new CEdgeTracker(h, w);
+    CMatrix<uchar> edges(*mEdges, index * h, (index + 1) * h);
+    engine.mTracker->track(suppressed, thresholdLow, thresholdHigh, edges);
+}
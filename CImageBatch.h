@@ -0,0 +1,66 @@
+#ifndef CIMAGEBATCH_H
+#define CIMAGEBATCH_H
+
+#include "globals.h"
+#include "CImage.h"
+#include <QMutex>
+
+/* Canny over many images of one size with the same parameters, such as the tiles of a
+ * preprocessing job, where creating a CImage per image and splitting each one into row bands
+ * would cost more than the work. The images are ingested into one batch buffer, image after
+ * image, and runs of whole images are handed out to mOptions.threads workers with
+ * parallelBands(); each run goes through CImage::runStages() on a single-threaded engine of
+ * its own, so workers share nothing but the counter. Each engine's workspace keeps the blur
+ * kernel, and every buffer is kept from one run() to the next while the batch shape stays the
+ * same.
+ *
+ * Image i of a run occupies rows [i * mHeight, (i+1) * mHeight) of mSuppressed and mEdges;
+ * take views of them with the CMatrix row-range constructor. Each image's result is exactly
+ * what CImage::canny() and CImage::hysteresis() give for it on one thread. */
+
+struct CImageBatchOptions
+{
+    double sigma;
+    bool useR, useG, useB;
+    double thresholdLow, thresholdHigh;
+    bool autoThresholds;                    // Per image from its magnitude histogram, instead of the two above
+    CMagnitudeHistogram::Rule thresholdRule;
+    double highPercentile, lowRatio;
+    CImage::Precision precision;
+    CImage::Operator gradientOperator;
+    uint threads;                           // Workers, each taking whole images
+    CProfiler * profiler;                   // Optional; gets one "batch" sample per run()
+
+    CImageBatchOptions();
+};
+
+class CImageBatch
+{
+public:
+    CImageBatchOptions mOptions;
+    uint mCount, mWidth, mHeight;           // Of the last run()
+    CCannyWorkspace mBuffer;                // Holds mInput
+    void * mInput;                          // The ingested images, a CMatrix of the working input type
+    CMatD * mSuppressed;                    // mCount * mHeight rows
+    CMatrix<uchar> * mEdges;                // The same, 1 on edge pixels
+    QVector<double> mThresholdLow, mThresholdHigh;   // Those used for each image, automatic or not
+    QVector<CImage*> mEngines;              // Workspace, tracker and histogram of each worker
+    QVector<CImage*> mIdle;                 // Those not running images right now
+    QMutex mIdleMutex;
+    QThreadPool mPool;
+    QString mError;
+    double mWallSeconds;                    // Of the last run()
+
+    CImageBatch(const CImageBatchOptions& options);
+    ~CImageBatch();
+
+    // False, with mError, for no images, a null one or one of a different size
+    bool run(const QVector<QImage>& images);
+    double imagesPerSecond() const;
+
+    template<typename In, typename T> void runAs(const QVector<QImage>& images, uint workers);
+    template<typename In, typename T> void process(const QImage& image, uint index, CImage& engine, CMatrix<In>& input,
+                                                   double& thresholdLow, double& thresholdHigh);
+};
+
+#endif // CIMAGEBATCH_H
@@ -0,0 +1,82 @@
+#include "CMagnitudeHistogram.h"
+
+CMagnitudeHistogram::CMagnitudeHistogram()
+        : mBins(CHISTOGRAM_BINS, 0), mCandidates(0)
+{
+}
+
+void CMagnitudeHistogram::clear()
+{
+    mBins.fill(0);
+    mCandidates = 0;
+}
+
+void CMagnitudeHistogram::add(const uint * bins)
+{
+    QMutexLocker locker(&mMutex);
+    quint64 * b = mBins.data();
+    for(int i = 0; i < CHISTOGRAM_BINS; i++) {
+        b[i] += bins[i];
+        mCandidates += bins[i];
+    }
+}
+
+/* Adds the nonzero values among n to bins. Zeros are counted into bin 0 like the rest and taken
+ * out at the end, which keeps the loop free of a data-dependent branch. */
+void CMagnitudeHistogram::count(const double * values, uint n, uint * bins)
+{
+    uint zeros = 0;
+    for(uint j = 0; j < n; j++) {
+        bins[qMin(CHISTOGRAM_BINS - 1, (int)(values[j] * CHISTOGRAM_BINS_PER_UNIT))]++;
+        zeros += values[j] == 0;
+    }
+    bins[0] -= zeros;
+}
+
+double CMagnitudeHistogram::percentile(double p) const
+{
+    if(mCandidates == 0) return 0;
+    quint64 rank = qMax((quint64)1, (quint64)ceil(p * mCandidates)), seen = 0;
+    for(int b = 0; b < CHISTOGRAM_BINS; b++) {
+        seen += mBins[b];
+        if(seen >= rank) return binValue(b);
+    }
+    return binValue(CHISTOGRAM_BINS - 1);
+}
+
+double CMagnitudeHistogram::otsu() const
+{
+    if(mCandidates == 0) return 0;
+    double total = 0;
+    for(int b = 0; b < CHISTOGRAM_BINS; b++)
+        total += (b + 0.5) * mBins[b];
+
+    double below = 0, belowSum = 0, best = -1;
+    int bestBin = 0;
+    for(int b = 0; b < CHISTOGRAM_BINS - 1; b++) {
+        below += mBins[b];
+        belowSum += (b + 0.5) * mBins[b];
+        double above = mCandidates - below;
+        if(below == 0 || above == 0) continue;
+        double meanBelow = belowSum / below, meanAbove = (total - belowSum) / above;
+        double between = below * above * (meanBelow - meanAbove) * (meanBelow - meanAbove);
+        if(between > best) {
+            best = between;
+            bestBin = b;
+        }
+    }
+    return binValue(bestBin);
+}
+
+bool CMagnitudeHistogram::thresholds(Rule rule, double& low, double& high, double highPercentile, double lowRatio) const
+{
+    if(mCandidates == 0) return false;
+    high = rule == RuleOtsu ? otsu() : percentile(highPercentile);
+    low = high * lowRatio;
+    return true;
+}
+
+double CMagnitudeHistogram::binValue(int bin)
+{
+    return (bin + 1) / (double)CHISTOGRAM_BINS_PER_UNIT;
+}
@@ -0,0 +1,41 @@
+#ifndef CMAGNITUDEHISTOGRAM_H
+#define CMAGNITUDEHISTOGRAM_H
+
+#include "globals.h"
+#include <QMutex>
+
+/* Histogram of the nonzero magnitudes left by non-maximum suppression, i.e. of the edge
+ * candidates, from which hysteresis thresholds can be chosen without another pass over the
+ * frame. Bins are 1/4096 of an intensity wide and cover every Prewitt magnitude (at most
+ * 3 * sqrt(2)), so a threshold is off by at most 0.00025. Suppression bands count their rows
+ * into a private array and add() it here once. */
+
+#define CHISTOGRAM_BINS_PER_UNIT 4096
+#define CHISTOGRAM_BINS (CHISTOGRAM_BINS_PER_UNIT * 9 / 2)
+
+class CMagnitudeHistogram
+{
+public:
+    enum Rule { RulePercentile, RuleOtsu };
+
+    QVector<quint64> mBins;
+    quint64 mCandidates;                    // Pixels counted, all of them nonzero
+    QMutex mMutex;                          // Guards add()
+
+    CMagnitudeHistogram();
+
+    void clear();
+    void add(const uint * bins);            // CHISTOGRAM_BINS counts from one band
+    static void count(const double * values, uint n, uint * bins);
+
+    double percentile(double p) const;      // Upper edge of the bin holding that rank, p in [0, 1]
+    double otsu() const;                    // Threshold between the two classes of largest between-class variance
+
+    /* High threshold by the rule (the `highPercentile` candidate for RulePercentile), low at
+     * lowRatio of it. False when there are no candidates, leaving low and high untouched. */
+    bool thresholds(Rule rule, double& low, double& high, double highPercentile = 0.8, double lowRatio = 0.4) const;
+
+    static double binValue(int bin);        // Upper edge of a bin
+};
+
+#endif // CMAGNITUDEHISTOGRAM_H
@@ -0,0 +1,95 @@
+#include "CMappedFile.h"
+#include "CNetpbm.h"
+
+CMappedFile::CMappedFile()
+        : mMap(0), mSize(0), mWritable(false), mWidth(0), mHeight(0), mChannels(0), mDataOffset(0)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+    close();
+}
+
+bool CMappedFile::open(const QString& path, bool writable, qint64 size)
+{
+    close();
+    mError = QString();
+    mFile.setFileName(path);
+    QIODevice::OpenMode mode = size >= 0 ? QIODevice::ReadWrite | QIODevice::Truncate : writable ? QIODevice::ReadWrite : QIODevice::ReadOnly;
+    if(!mFile.open(mode) || (size >= 0 && !mFile.resize(size))) {
+        mError = "could not open " + path;
+        mFile.close();
+        return false;
+    }
+    mSize = mFile.size();
+    mWritable = writable || size >= 0;
+    mMap = mSize > 0 ? mFile.map(0, mSize) : 0;
+    if(mMap == 0) {
+        mError = "could not map " + path;
+        mFile.close();
+        return false;
+    }
+    return true;
+}
+
+void CMappedFile::close()
+{
+    if(mMap != 0) mFile.unmap(mMap);
+    mMap = 0;
+    mSize = 0;
+    if(mFile.isOpen()) mFile.close();
+}
+
+bool CMappedFile::mapNetpbm(const QString& path)
+{
+    // CNetpbmFile checks the header and that the raster is all there
+    CNetpbmFile header;
+    if(!header.openRead(path)) {
+        mError = header.mError;
+        return false;
+    }
+    header.close();
+    if(!open(path, false)) return false;
+    mWidth = header.mWidth;
+    mHeight = header.mHeight;
+    mChannels = header.mChannels;
+    mDataOffset = header.mDataOffset;
+    return true;
+}
+
+bool CMappedFile::createNetpbm(const QString& path, uint width, uint height, uint channels)
+{
+    QByteArray header = QString("P%1\n%2 %3\n255\n").arg(channels == 1 ? 5 : 6).arg(width).arg(height).toLatin1();
+    if(!open(path, true, header.size() + (qint64)width * channels * height)) return false;
+    memcpy(mMap, header.constData(), header.size());
+    mWidth = width;
+    mHeight = height;
+    mChannels = channels;
+    mDataOffset = header.size();
+    return true;
+}
+
+// The mapped raster as a QImage that does not own it; writing to the QImage detaches a copy
+QImage CMappedFile::image() const
+{
+    if(mMap == 0) return QImage();
+    return QImage((const uchar*)mMap + mDataOffset, mWidth, mHeight, mWidth * mChannels,
+                  mChannels == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+}
+
+bool CMappedFile::saveEdges(const CMatrix<uchar>& edges, const QString& path, QString * error)
+{
+    CMappedFile file;
+    if(!file.createNetpbm(path, edges.mWidth, edges.mHeight, 1)) {
+        if(error) *error = file.mError;
+        return false;
+    }
+    for(uint i = 0; i < edges.mHeight; i++) {
+        const uchar * e = edges.row(i);
+        uchar * o = file.row(i);
+        for(uint j = 0; j < edges.mWidth; j++)
+            o[j] = e[j] ? 255 : 0;
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+#ifndef CMAPPEDFILE_H
+#define CMAPPEDFILE_H
+
+#include "globals.h"
+#include <QFile>
+
+/* Files mapped into memory with QFile::map, so rasters and matrices are read and written in
+ * place: no codec, no copy into a buffer of our own. Two kinds of file:
+ *
+ * Binary PGM and PPM with 8-bit samples, whose raster image() wraps as a read-only QImage
+ * (Grayscale8 or RGB888, the formats CMatrix::fromImage reads directly), and which
+ * saveEdges() writes as the 0/255 map of a hysteresis result.
+ *
+ * Raw CMatrix dumps: a CMATRIX_ALIGNMENT-byte CMatrixDumpHeader followed by the rows exactly
+ * as CMatrix lays them out, padding included. Mappings start on a page, so the rows of a
+ * mapped dump are as aligned as an allocated matrix, and mapMatrix() hands them out as a
+ * view. Dumps are in the byte order of the machine that wrote them.
+ *
+ * Matrices and images handed out are valid until close() or the destructor. */
+
+#define CMATRIX_DUMP_MAGIC "CMATRIX1"
+
+struct CMatrixDumpHeader
+{
+    char mMagic[8];                         // CMATRIX_DUMP_MAGIC, without the terminator
+    quint32 mType, mElementSize;            // CMatrixDumpType<T>::Code and sizeof(T)
+    quint32 mHeight, mWidth, mStride;
+    quint32 mReserved[9];                   // Zero; pads the header to CMATRIX_ALIGNMENT bytes
+};
+
+template<typename T> struct CMatrixDumpType;
+template<> struct CMatrixDumpType<double> { enum { Code = 1 }; };
+template<> struct CMatrixDumpType<float> { enum { Code = 2 }; };
+template<> struct CMatrixDumpType<short> { enum { Code = 3 }; };
+template<> struct CMatrixDumpType<uchar> { enum { Code = 4 }; };
+
+class CMappedFile
+{
+public:
+    QFile mFile;
+    uchar * mMap;
+    qint64 mSize;
+    bool mWritable;
+    QString mError;
+
+    // Of a Netpbm file
+    uint mWidth, mHeight, mChannels;
+    qint64 mDataOffset;
+
+    CMappedFile();
+    ~CMappedFile();
+
+    bool mapNetpbm(const QString& path);                                            // Read-only
+    bool createNetpbm(const QString& path, uint width, uint height, uint channels = 1);
+    QImage image() const;
+    uchar * row(uint index) { return mMap + mDataOffset + (qint64)index * mWidth * mChannels; }
+
+    // Views into the mapping; be sure to delete them, before close()
+    template<typename T> CMatrix<T> * mapMatrix(const QString& path, bool writable = false);
+    template<typename T> CMatrix<T> * createMatrix(const QString& path, uint height, uint width);
+
+    bool open(const QString& path, bool writable, qint64 size = -1);               // size >= 0 creates the file
+    void close();
+
+    template<typename T> static bool saveMatrix(const CMatrix<T>& m, const QString& path, QString * error = 0);
+    static bool saveEdges(const CMatrix<uchar>& edges, const QString& path, QString * error = 0);     // 255 where nonzero
+};
+
+template<typename T> CMatrix<T> * CMappedFile::mapMatrix(const QString& path, bool writable)
+{
+    if(!open(path, writable)) return 0;
+    const CMatrixDumpHeader * header = (const CMatrixDumpHeader*)mMap;
+    if(mSize < (qint64)sizeof(CMatrixDumpHeader) || memcmp(header->mMagic, CMATRIX_DUMP_MAGIC, 8) != 0) {
+        mError = path + " is not a matrix dump";
+        close();
+        return 0;
+    }
+    if(header->mType != (quint32)CMatrixDumpType<T>::Code || header->mElementSize != sizeof(T) ||
+            header->mStride != CMatrix<T>::strideFor(header->mWidth)) {
+        mError = path + " holds another element type or layout";
+        close();
+        return 0;
+    }
+    if(mSize < (qint64)sizeof(CMatrixDumpHeader) + (qint64)sizeof(T) * header->mHeight * header->mStride) {
+        mError = path + " is truncated";
+        close();
+        return 0;
+    }
+    return new CMatrix<T>((T*)(mMap + sizeof(CMatrixDumpHeader)), header->mHeight, header->mWidth);
+}
+
+// A new dump of that size, mapped for writing; the rows start out zero
+template<typename T> CMatrix<T> * CMappedFile::createMatrix(const QString& path, uint height, uint width)
+{
+    uint stride = CMatrix<T>::strideFor(width);
+    if(!open(path, true, sizeof(CMatrixDumpHeader) + (qint64)sizeof(T) * height * stride)) return 0;
+    CMatrixDumpHeader * header = (CMatrixDumpHeader*)mMap;
+    memset(header, 0, sizeof(CMatrixDumpHeader));
+    memcpy(header->mMagic, CMATRIX_DUMP_MAGIC, 8);
+    header->mType = CMatrixDumpType<T>::Code;
+    header->mElementSize = sizeof(T);
+    header->mHeight = height;
+    header->mWidth = width;
+    header->mStride = stride;
+    return new CMatrix<T>((T*)(mMap + sizeof(CMatrixDumpHeader)), height, width);
+}
+
+template<typename T> bool CMappedFile::saveMatrix(const CMatrix<T>& m, const QString& path, QString * error)
+{
+    CMappedFile file;
+    CMatrix<T> * out = file.createMatrix<T>(path, m.mHeight, m.mWidth);
+    if(out == 0) {
+        if(error) *error = file.mError;
+        return false;
+    }
+    out->copyFrom(m);
+    delete out;
+    return true;
+}
+
+#endif // CMAPPEDFILE_H
@@ -3,14 +3,13 @@
 
 #include "globals.h"
 
-template<typename T> class CArray          // e.g. matrix row
+template<typename T> class CArray          // e.g. matrix row; a view into the matrix buffer
 {
 public:
     uint mSize;
     T * mItems;
 
-    CArray(uint size);
-    ~CArray();
+    CArray(T * items, uint size) : mSize(size), mItems(items) {}
 
     T& operator[](uint index) { return mItems[index]; }
 
@@ -19,21 +18,44 @@ public:
     T sum();
 };
 
+/* Storage is one contiguous buffer aligned to CMATRIX_ALIGNMENT bytes. Every row starts
+ * on an aligned boundary: mStride is mWidth rounded up to a whole number of cache lines,
+ * so row i lives at mData + i*mStride. The padding at the end of each row is never read. */
+#define CMATRIX_ALIGNMENT 64
+
+/* A kernel counts as separable (rank one) when the outer product of one of its columns and
+ * one of its rows reproduces every tap to within this fraction of its largest tap. The slack
+ * admits kernels that were computed in float, such as CImage::gaussianFilter. Separable
+ * filtering then agrees with the direct 2-D sum to within about this tolerance times the sum
+ * of the absolute taps times the input range, plus rounding from the changed summation order. */
+#define CMATRIX_SEPARABLE_TOLERANCE 1e-6
+
 template<typename T> class CMatrix
 {
 public:
     uint mHeight, mWidth;
-    CArray<T> ** mRows;
+    uint mStride;                           // Elements between the starts of consecutive rows
+    T * mData;
+    bool mOwner;                            // False for views, which never free mData
 
     CMatrix(CMatrix<T> * copyFrom);
+    CMatrix(const CMatrix<T>& copyFrom);
     CMatrix(uint height, uint width);
     CMatrix(uint height, uint width, T initialValue);
     CMatrix(QImage * image, bool useR = true, bool useG = true, bool useB = true);
+    CMatrix(CMatrix<T>& parent, uint rowBegin, uint rowEnd);    // View of rows [rowBegin, rowEnd)
+    CMatrix(T * rows, uint height, uint width);                 // View of external rows, strideFor(width) apart
     ~CMatrix();
 
-    CArray<T> & operator[](uint index) { return *mRows[index]; } 
-    T& at(uint x, uint y) { return (*mRows[x]).operator [](y); }     // Row, column
-    void set(uint x, uint y, T value) { return mRows[x][y]; }        // Row, column
+    CMatrix<T>& operator=(const CMatrix<T>& copyFrom);
+
+    T * row(uint index) { return mData + (size_t)index*mStride; }
+    const T * row(uint index) const { return mData + (size_t)index*mStride; }
+    size_t bytes() const { return sizeof(T) * (size_t)mHeight * mStride; }
+
+    CArray<T> operator[](uint index) { return CArray<T>(row(index), mWidth); }
+    T& at(uint x, uint y) { return mData[(size_t)x*mStride + y]; }     // Row, column
+    void set(uint x, uint y, T value) { at(x, y) = value; }              // Row, column
 
     void operator/=(T quotient);
     void operator+=(CMatrix<T>& summand);
@@ -41,30 +63,35 @@ public:
     void squareRootElementsInPlace();
 
     static CMatrix<T> * atan2(CMatrix<T>& y, CMatrix<T>& x);
+    static void atan2(CMatrix<T>& out, CMatrix<T>& y, CMatrix<T>& x);
 
     T sum();
 
     CMatrix<T> * filterBy(CMatrix<T>& kernel);
-
-    QImage * toNewImage(bool rescale = true);  // Be sure to delete
+    CMatrix<T> * filterByDirect(CMatrix<T>& kernel);
+    CMatrix<T> * filterBySeparable(CMatrix<T>& columnKernel, CMatrix<T>& rowKernel);
+
+    // Band versions: write output rows [rowBegin, rowEnd) only, reading whatever halo they need
+    void filterByDirect(CMatrix<T>& out, CMatrix<T>& kernel, uint rowBegin, uint rowEnd);
+    void filterRows(CMatrix<T>& out, CMatrix<T>& rowKernel, uint rowBegin, uint rowEnd);
+    void filterColumns(CMatrix<T>& out, CMatrix<T>& columnKernel, uint rowBegin, uint rowEnd);
+    bool separate(CMatrix<T> ** columnKernel, CMatrix<T> ** rowKernel, double tolerance = CMATRIX_SEPARABLE_TOLERANCE);
+
+    // The matrix's size of the image from (top, left), by default all of it
+    void fromImage(const QImage * image, bool useR = true, bool useG = true, bool useB = true, uint top = 0, uint left = 0);
+    QImage * toNewImage(bool rescale = true, QImage::Format format = QImage::Format_Grayscale8);  // Be sure to delete
+    void toImage(QImage& out, bool rescale = true);
+    void levelRange(bool rescale, double& baseline, double& scaleFactor);
     void debugPrint();
 
+    static uint strideFor(uint width);
+    void allocate(uint height, uint width);
+    void copyFrom(const CMatrix<T>& other);
 };
 
 // Useful typedef:
 typedef CMatrix<double> CMatD;
 
-template<typename T> CArray<T>::CArray(uint size)
-        : mSize(size)
-{
-    mItems = new T[mSize];
-}
-
-template<typename T> CArray<T>::~CArray()
-{
-    delete [] mItems;
-}
-
 template<typename T> void CArray<T>::operator/=(T quotient)
 {
     for(uint i = 0; i < mSize; i++)
@@ -79,172 +106,411 @@ template<typename T> T CArray<T>::sum()
     return r;
 }
 
-template<typename T> CMatrix<T>::CMatrix(CMatrix<T> * copyFrom)
+template<typename T> uint CMatrix<T>::strideFor(uint width)
 {
-    mHeight = copyFrom->mHeight;
-    mWidth = copyFrom->mWidth;
-    mRows = new CArray<T>*[mHeight];
-    for(uint i = 0; i < mHeight; i++) {
-        mRows[i] = new CArray<T>(mWidth);
-        for(uint j = 0; j < mWidth; j++) {
-            at(i,j) = copyFrom->at(i,j);
-        }
+    uint perLine = CMATRIX_ALIGNMENT / sizeof(T);
+    if(perLine == 0) return width;
+    return (width + perLine - 1) / perLine * perLine;
+}
+
+template<typename T> void CMatrix<T>::allocate(uint height, uint width)
+{
+    mHeight = height;
+    mWidth = width;
+    mStride = strideFor(width);
+    mData = (T*)qMallocAligned(sizeof(T) * (size_t)mHeight * mStride, CMATRIX_ALIGNMENT);
+    mOwner = true;
+}
+
+template<typename T> void CMatrix<T>::copyFrom(const CMatrix<T>& other)
+{
+    if(mStride == other.mStride) {
+        memcpy(mData, other.mData, sizeof(T) * (size_t)mHeight * mStride);
+        return;
     }
+    for(uint i = 0; i < mHeight; i++)
+        memcpy(row(i), other.row(i), sizeof(T) * mWidth);
+}
+
+template<typename T> CMatrix<T>::CMatrix(CMatrix<T> * copyFrom)
+{
+    allocate(copyFrom->mHeight, copyFrom->mWidth);
+    this->copyFrom(*copyFrom);
+}
+
+template<typename T> CMatrix<T>::CMatrix(const CMatrix<T>& copyFrom)
+{
+    allocate(copyFrom.mHeight, copyFrom.mWidth);
+    this->copyFrom(copyFrom);
 }
 
 template<typename T> CMatrix<T>::CMatrix(uint height, uint width)
-        : mHeight(height), mWidth(width)
 {
-    mRows = new CArray<T>*[mHeight];
-    for(uint i = 0; i < mHeight; i++)
-        mRows[i] = new CArray<T>(mWidth);
+    allocate(height, width);
 }
 
 template<typename T> CMatrix<T>::CMatrix(uint height, uint width, T initialValue)
-        : mHeight(height), mWidth(width)
 {
-    mRows = new CArray<T>*[mHeight];
+    allocate(height, width);
     for(uint i = 0; i < mHeight; i++) {
-        mRows[i] = new CArray<T>(mWidth);
-        for(uint j = 0; j < mWidth; j++) {
-            at(i,j) = initialValue;
-        }
+        T * r = row(i);
+        for(uint j = 0; j < mWidth; j++)
+            r[j] = initialValue;
     }
 }
 
+// Intensities are in [0, 1); 8-bit matrices store them as levels 0..255
+template<typename T> inline T cmatrixIntensity(double v) { return (T)v; }
+template<> inline uchar cmatrixIntensity<uchar>(double v) { return (uchar)floor(v*256 + 0.5); }
+
+/* Both read the scan lines directly, with one loop per pixel format; formats without a loop are
+ * converted to RGB32 once. A disabled channel gets weight 0, which adds an exact zero, so the
+ * sums are bit-identical to weighing pixel() values one by one. */
 template<typename T> CMatrix<T>::CMatrix(QImage * im, bool useR, bool useG, bool useB)
 {
-    mHeight = im->height();
-    mWidth = im->width();
+    allocate(im->height(), im->width());
+    fromImage(im, useR, useG, useB);
+}
 
+template<typename T> void CMatrix<T>::fromImage(const QImage * im, bool useR, bool useG, bool useB, uint top, uint left)
+{
     if(!(useR || useG || useB))
-        useR = useG = useB;
+        useR = useG = useB = true;
+
+    // Weights by QRgb byte: the low one (useR) 0.11, the middle one 0.59, the high one 0.3
+    double low = useR ? 0.11 : 0, mid = useG ? 0.59 : 0, high = useB ? 0.3 : 0, totalW = 0;
+    if(useR) totalW += 0.11;
+    if(useG) totalW += 0.59;
+    if(useB) totalW += 0.3;
+    double scale = totalW * 256.;
+
+    QImage converted;
+    const QImage * source = im;
+    QImage::Format format = im->format();
+    if(format != QImage::Format_RGB32 && format != QImage::Format_ARGB32 && format != QImage::Format_ARGB32_Premultiplied &&
+            format != QImage::Format_Grayscale8 && format != QImage::Format_RGB888) {
+        // Only the part that is read, so a small region of a large image costs a small conversion
+        bool part = mHeight != (uint)im->height() || mWidth != (uint)im->width();
+        converted = (part ? im->copy(left, top, mWidth, mHeight) : *im).convertToFormat(QImage::Format_RGB32);
+        source = &converted;
+        format = QImage::Format_RGB32;
+        top = left = 0;
+    }
 
-    mRows = new CArray<T>*[mHeight];
-    for(uint i = 0; i < mHeight; i++) {
-        mRows[i] = new CArray<T>(mWidth);
-        for(uint j = 0; j < mWidth; j++) {
-            uint p = im->pixel(j,i);
-            at(i,j) = 0;
-            double totalW = 0;
-            if(useR) { at(i,j) += (p&0xFF)*0.11; totalW += 0.11; }
-            if(useG) { at(i,j) += ((p&0xFF00)>>8)*0.59; totalW += 0.59; }
-            if(useB) { at(i,j) += ((p&0xFF0000)>>16)*0.3; totalW += 0.3; }
-            at(i,j) /= totalW * 256.;
+    if(format == QImage::Format_Grayscale8) {
+        T level[256];
+        for(uint c = 0; c < 256; c++)
+            level[c] = cmatrixIntensity<T>((c*low + c*mid + c*high) / scale);
+        for(uint i = 0; i < mHeight; i++) {
+            const uchar * s = source->constScanLine(top + i) + left;
+            T * r = row(i);
+            for(uint j = 0; j < mWidth; j++)
+                r[j] = level[s[j]];
+        }
+    } else if(format == QImage::Format_RGB888) {
+        for(uint i = 0; i < mHeight; i++) {
+            const uchar * s = source->constScanLine(top + i) + 3*left;
+            T * r = row(i);
+            for(uint j = 0; j < mWidth; j++)
+                r[j] = cmatrixIntensity<T>((s[3*j+2]*low + s[3*j+1]*mid + s[3*j]*high) / scale);
+        }
+    } else {
+        for(uint i = 0; i < mHeight; i++) {
+            const QRgb * s = (const QRgb*)source->constScanLine(top + i) + left;
+            T * r = row(i);
+            for(uint j = 0; j < mWidth; j++) {
+                QRgb p = s[j];
+                r[j] = cmatrixIntensity<T>(((p & 0xFF)*low + ((p >> 8) & 0xFF)*mid + ((p >> 16) & 0xFF)*high) / scale);
+            }
         }
     }
 }
 
+template<typename T> CMatrix<T>::CMatrix(CMatrix<T>& parent, uint rowBegin, uint rowEnd)
+        : mHeight(rowEnd - rowBegin), mWidth(parent.mWidth), mStride(parent.mStride),
+          mData(parent.row(rowBegin)), mOwner(false)
+{
+}
+
+template<typename T> CMatrix<T>::CMatrix(T * rows, uint height, uint width)
+        : mHeight(height), mWidth(width), mStride(strideFor(width)), mData(rows), mOwner(false)
+{
+}
+
 template<typename T> CMatrix<T>::~CMatrix()
 {
-    for(uint i = 0; i < mHeight; i++)
-        delete mRows[i];
-    delete [] mRows;
+    if(mOwner) qFreeAligned(mData);
+}
+
+template<typename T> CMatrix<T>& CMatrix<T>::operator=(const CMatrix<T>& copyFrom)
+{
+    if(this == &copyFrom) return *this;
+    if(mHeight != copyFrom.mHeight || mWidth != copyFrom.mWidth) {
+        if(mOwner) qFreeAligned(mData);
+        allocate(copyFrom.mHeight, copyFrom.mWidth);
+    }
+    this->copyFrom(copyFrom);
+    return *this;
 }
 
 template<typename T> void CMatrix<T>::operator/=(T quotient)
 {
-    for(uint i = 0; i < mHeight; i++)
-        (*mRows[i]) /= quotient;
+    for(uint i = 0; i < mHeight; i++) {
+        T * r = row(i);
+        for(uint j = 0; j < mWidth; j++)
+            r[j] /= quotient;
+    }
 }
 
 template<typename T> void CMatrix<T>::operator+=(CMatrix<T>& summand)
 {
     for(uint i = 0; i < mHeight; i++)
-        for(uint j = 0; j < mWidth; j++)
-            at(i, j) += summand.at(i, j);
+        simdAdd(row(i), summand.row(i), mWidth);
 }
 
 template<typename T> void CMatrix<T>::squareElementsInPlace()
 {
     for(uint i = 0; i < mHeight; i++)
-        for(uint j = 0; j < mWidth; j++)
-            at(i, j) *= at(i, j);
+        simdSquare(row(i), mWidth);
 }
 
 template<typename T> void CMatrix<T>::squareRootElementsInPlace()
 {
     for(uint i = 0; i < mHeight; i++)
-        for(uint j = 0; j < mWidth; j++)
-            at(i, j) = sqrt(at(i, j));
+        simdSquareRoot(row(i), mWidth);
 }
 
 template<typename T> CMatrix<T> * CMatrix<T>::atan2(CMatrix<T>& y, CMatrix<T>& x)
 {
     CMatrix<T> * out = new CMatrix<T>(y.mHeight, y.mWidth);
-    for(uint i = 0; i < y.mHeight; i++)
-        for(uint j = 0; j < y.mWidth; j++)
-            out->at(i, j) = ::atan2(y[i][j], x[i][j]);
+    atan2(*out, y, x);
     return out;
 }
 
+template<typename T> void CMatrix<T>::atan2(CMatrix<T>& out, CMatrix<T>& y, CMatrix<T>& x)
+{
+    for(uint i = 0; i < y.mHeight; i++) {
+        T * o = out.row(i);
+        const T * ry = y.row(i), * rx = x.row(i);
+        for(uint j = 0; j < y.mWidth; j++)
+            o[j] = ::atan2(ry[j], rx[j]);
+    }
+}
+
 template<typename T> T CMatrix<T>::sum()
 {
     T r = 0;    // T must have a zero
     for(uint i = 0; i < mHeight; i++)
-        r += mRows[i]->sum();
+        r += (*this)[i].sum();
     return r;
 }
 
-// Implicitly 0-padded
+// Implicitly 0-padded. Rank-one kernels are applied as a row pass followed by a column pass.
 template<typename T> CMatrix<T>* CMatrix<T>::filterBy(CMatrix<T>& kernel)
+{
+    CMatrix<T> * columnKernel, * rowKernel;
+    if(kernel.mHeight > 1 && kernel.mWidth > 1 && kernel.separate(&columnKernel, &rowKernel)) {
+        CMatrix<T> * out = filterBySeparable(*columnKernel, *rowKernel);
+        delete columnKernel;
+        delete rowKernel;
+        return out;
+    }
+    return filterByDirect(kernel);
+}
+
+// Implicitly 0-padded, O(n*m) per pixel
+template<typename T> CMatrix<T>* CMatrix<T>::filterByDirect(CMatrix<T>& kernel)
 {
     CMatrix<T> * out = new CMatrix<T>(mHeight, mWidth);
+    filterByDirect(*out, kernel, 0, mHeight);
+    return out;
+}
 
-    if((kernel.mWidth & 1 == 0) | (kernel.mHeight & 1 == 0)) {
-        QMessageBox::critical(0, "Error", "Kernels must have odd size");
-        return out;
+template<typename T> void CMatrix<T>::filterByDirect(CMatrix<T>& out, CMatrix<T>& kernel, uint rowBegin, uint rowEnd)
+{
+    if(((kernel.mWidth & 1) == 0) | ((kernel.mHeight & 1) == 0)) {
+        qCritical() << "Kernels must have odd size";
+        return;
     }
 
     int rangeX = (kernel.mHeight-1)/2, rangeY = (kernel.mWidth-1)/2;
 
-    for(uint i = 0; i < mHeight; i++) {
-        for(uint j = 0; j < mWidth; j++) {
-            out->at(i, j) = 0;
-            for(int x = -rangeX; x <= rangeX; x++) {
-                int posX = x + i;
-                if(posX < 0 || posX >= (int)mHeight) continue;
-                for(int y = -rangeY; y <= rangeY; y++) {
-                    int posY = y + j;
-                    if(posY < 0 || posY >= (int)mWidth) continue;
-                    out->at(i, j) += at(posX, posY)*kernel[rangeX+x][rangeY+y];
-                }
+    /* Tap by tap over whole rows: each tap only touches the columns it stays inside, so the
+     * border handling is peeled off the inner loop. Every pixel still sums its taps row-major. */
+    for(int i = rowBegin; i < (int)rowEnd; i++) {
+        T * o = out.row(i);
+        for(uint j = 0; j < mWidth; j++)
+            o[j] = 0;
+        int xFrom = qMax(-rangeX, -i), xTo = qMin(rangeX, (int)mHeight-1-i);
+        for(int x = xFrom; x <= xTo; x++) {
+            const T * in = row(i+x);
+            const T * k = kernel.row(rangeX+x) + rangeY;
+            for(int y = -rangeY; y <= rangeY; y++) {
+                int jFrom = qMax(0, -y), jTo = qMin((int)mWidth, (int)mWidth-y);
+                if(jFrom < jTo) simdMulAdd(o + jFrom, in + jFrom + y, k[y], jTo - jFrom);
             }
         }
     }
+}
 
+/* Implicitly 0-padded, O(n+m) per pixel. Both kernels are 1-D and stored as single-row
+ * matrices: the result equals filterBy() with the kernel columnKernel^T * rowKernel. Because
+ * the padded region is a product of row and column ranges, the zero padding is exact. */
+template<typename T> CMatrix<T>* CMatrix<T>::filterBySeparable(CMatrix<T>& columnKernel, CMatrix<T>& rowKernel)
+{
+    CMatrix<T> * out = new CMatrix<T>(mHeight, mWidth);
+    CMatrix<T> rows(mHeight, mWidth);
+    filterRows(rows, rowKernel, 0, mHeight);
+    rows.filterColumns(*out, columnKernel, 0, mHeight);
     return out;
 }
 
-template<typename T> QImage * CMatrix<T>::toNewImage(bool rescale)
+// Row pass of filterBySeparable: each tap runs over the columns it stays inside, as in filterByDirect
+template<typename T> void CMatrix<T>::filterRows(CMatrix<T>& out, CMatrix<T>& rowKernel, uint rowBegin, uint rowEnd)
 {
-    QImage * out = new QImage(mWidth, mHeight, QImage::Format_RGB32);
+    if((rowKernel.mWidth & 1) == 0) {
+        qCritical() << "Kernels must have odd size";
+        return;
+    }
 
-    double baseline = 0, scaleFactor = 255.;
+    int rangeY = (rowKernel.mWidth-1)/2;
+    const T * kr = rowKernel.row(0) + rangeY;
 
-    if(rescale) {
-        T min = at(0,0), max = at(0,0);
-        for(uint i = 0; i < mHeight; i++) {
-            for(uint j = 0; j < mWidth; j++) {
-                if(min > at(i,j)) min = at(i,j);
-                if(max < at(i,j)) max = at(i,j);
-            }
+    for(uint i = rowBegin; i < rowEnd; i++) {
+        const T * in = row(i);
+        T * o = out.row(i);
+        for(uint j = 0; j < mWidth; j++)
+            o[j] = 0;
+        for(int y = -rangeY; y <= rangeY; y++) {
+            int jFrom = qMax(0, -y), jTo = qMin((int)mWidth, (int)mWidth-y);
+            if(jFrom < jTo) simdMulAdd(o + jFrom, in + jFrom + y, kr[y], jTo - jFrom);
         }
-        baseline = min;
-        if(max != min)
-            scaleFactor = 255./(max - min);
-        else
-            scaleFactor = 255.;
     }
+}
+
+// Column pass of filterBySeparable, accumulated a whole row at a time
+template<typename T> void CMatrix<T>::filterColumns(CMatrix<T>& out, CMatrix<T>& columnKernel, uint rowBegin, uint rowEnd)
+{
+    if((columnKernel.mWidth & 1) == 0) {
+        qCritical() << "Kernels must have odd size";
+        return;
+    }
+
+    int rangeX = (columnKernel.mWidth-1)/2;
+    const T * kc = columnKernel.row(0) + rangeX;
+
+    for(int i = rowBegin; i < (int)rowEnd; i++) {
+        int xFrom = qMax(-rangeX, -i), xTo = qMin(rangeX, (int)mHeight-1-i);
+        T * o = out.row(i);
+        for(uint j = 0; j < mWidth; j++)
+            o[j] = 0;
+        for(int x = xFrom; x <= xTo; x++)
+            simdMulAdd(o, row(i+x), kc[x], mWidth);
+    }
+}
+
+/* Rank check: if this kernel is the outer product of a column and a row (within tolerance,
+ * relative to its largest tap), returns true and both factors as new single-row matrices,
+ * suitable for filterBySeparable(). Be sure to delete them. */
+template<typename T> bool CMatrix<T>::separate(CMatrix<T> ** columnKernel, CMatrix<T> ** rowKernel, double tolerance)
+{
+    uint p = 0, q = 0;
+    for(uint i = 0; i < mHeight; i++)
+        for(uint j = 0; j < mWidth; j++)
+            if(fabs((double)at(i,j)) > fabs((double)at(p,q))) { p = i; q = j; }
+
+    T pivot = at(p,q);
+    if(pivot == 0) return false;
+
+    CMatrix<T> * column = new CMatrix<T>(1, mHeight);
+    CMatrix<T> * rowK = new CMatrix<T>(1, mWidth);
+    for(uint i = 0; i < mHeight; i++)
+        column->at(0,i) = at(i,q) / pivot;
+    for(uint j = 0; j < mWidth; j++)
+        rowK->at(0,j) = at(p,j);
+
+    double limit = tolerance * fabs((double)pivot);
+    for(uint i = 0; i < mHeight; i++)
+        for(uint j = 0; j < mWidth; j++)
+            if(fabs((double)(column->at(0,i) * rowK->at(0,j)) - (double)at(i,j)) > limit) {
+                delete column;
+                delete rowK;
+                return false;
+            }
+
+    *columnKernel = column;
+    *rowKernel = rowK;
+    return true;
+}
+
+// Maps [min, max] to levels [0, 255] when rescaling, else [0, 1] to [0, 255]
+template<typename T> void CMatrix<T>::levelRange(bool rescale, double& baseline, double& scaleFactor)
+{
+    baseline = 0;
+    scaleFactor = 255.;
+    if(!rescale) return;
+
+    T min = at(0,0), max = at(0,0);
     for(uint i = 0; i < mHeight; i++) {
+        const T * r = row(i);
         for(uint j = 0; j < mWidth; j++) {
-            uint c = (uint)ceil((at(i,j)-baseline)*scaleFactor);
-            out->setPixel(j, i, qRgb(c,c,c));
+            if(min > r[j]) min = r[j];
+            if(max < r[j]) max = r[j];
         }
     }
+    baseline = min;
+    if(max != min)
+        scaleFactor = 255./(max - min);
+}
+
+/* Writes straight into the scan lines. The default Format_Grayscale8 takes one byte per
+ * pixel; RGB32 and RGB888 repeat the level in every channel, and any other format is
+ * converted from Grayscale8. */
+template<typename T> QImage * CMatrix<T>::toNewImage(bool rescale, QImage::Format format)
+{
+    QImage::Format direct = format == QImage::Format_RGB32 || format == QImage::Format_RGB888 ? format : QImage::Format_Grayscale8;
+    QImage * out = new QImage(mWidth, mHeight, direct);
+
+    double baseline, scaleFactor;
+    levelRange(rescale, baseline, scaleFactor);
+    for(uint i = 0; i < mHeight; i++) {
+        const T * r = row(i);
+        uchar * s = out->scanLine(i);
+        for(uint j = 0; j < mWidth; j++)
+            s[j] = (uchar)(uint)ceil((r[j]-baseline)*scaleFactor);
+        // Spread the levels from the back, so no byte is overwritten before it is read
+        if(direct == QImage::Format_RGB888)
+            for(int j = mWidth-1; j >= 0; j--)
+                s[3*j] = s[3*j+1] = s[3*j+2] = s[j];
+        else if(direct == QImage::Format_RGB32)
+            for(int j = mWidth-1; j >= 0; j--)
+                ((QRgb*)s)[j] = qRgb(s[j], s[j], s[j]);
+    }
+
+    if(direct != format) {
+        QImage * converted = new QImage(out->convertToFormat(format));
+        delete out;
+        out = converted;
+    }
     return out;
 }
 
+// toNewImage(rescale) into `out`, which is reused when it already is a Grayscale8 image of this size
+template<typename T> void CMatrix<T>::toImage(QImage& out, bool rescale)
+{
+    if(out.width() != (int)mWidth || out.height() != (int)mHeight || out.format() != QImage::Format_Grayscale8)
+        out = QImage(mWidth, mHeight, QImage::Format_Grayscale8);
+
+    double baseline, scaleFactor;
+    levelRange(rescale, baseline, scaleFactor);
+    for(uint i = 0; i < mHeight; i++) {
+        const T * r = row(i);
+        uchar * s = out.scanLine(i);
+        for(uint j = 0; j < mWidth; j++)
+            s[j] = (uchar)(uint)ceil((r[j]-baseline)*scaleFactor);
+    }
+}
+
 template<typename T> void CMatrix<T>::debugPrint()
 {
     for(uint i = 0; i < mHeight; i++) {
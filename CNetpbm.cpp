@@ -0,0 +1,123 @@
+#include "CNetpbm.h"
+
+CNetpbmFile::CNetpbmFile()
+        : mWidth(0), mHeight(0), mChannels(0), mDataOffset(0), mNextRow(0)
+{
+}
+
+// Next header number, skipping whitespace and # comments; -1 on a malformed header
+static qint64 readHeaderNumber(QFile& file)
+{
+    char c;
+    for(;;) {
+        if(file.read(&c, 1) != 1) return -1;
+        if(c == '#') {
+            while(c != '\n')
+                if(file.read(&c, 1) != 1) return -1;
+        } else if(c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            break;
+    }
+    if(c < '0' || c > '9') return -1;
+
+    qint64 n = 0;
+    while(c >= '0' && c <= '9') {
+        n = n*10 + (c - '0');
+        if(n > 0x7FFFFFFF) return -1;
+        if(file.read(&c, 1) != 1) return -1;
+    }
+    // c is the single whitespace that ends the number; after maxval it precedes the raster
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' ? n : -1;
+}
+
+bool CNetpbmFile::openRead(const QString& path)
+{
+    close();
+    mFile.setFileName(path);
+    if(!mFile.open(QIODevice::ReadOnly)) {
+        mError = "could not open " + path;
+        return false;
+    }
+
+    char magic[2];
+    if(mFile.read(magic, 2) != 2 || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6')) {
+        mError = path + " is not a binary PGM or PPM file";
+        return false;
+    }
+    mChannels = magic[1] == '5' ? 1 : 3;
+    qint64 width = readHeaderNumber(mFile), height = readHeaderNumber(mFile), maxval = readHeaderNumber(mFile);
+    if(width <= 0 || height <= 0 || maxval <= 0) {
+        mError = "malformed header in " + path;
+        return false;
+    }
+    if(maxval > 255) {
+        mError = path + " has 16-bit samples, which are not supported";
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mDataOffset = mFile.pos();
+    mNextRow = 0;
+    if(mFile.size() < mDataOffset + (qint64)rowBytes() * mHeight) {
+        mError = path + " is truncated";
+        return false;
+    }
+    return true;
+}
+
+bool CNetpbmFile::openWrite(const QString& path, uint width, uint height, uint channels)
+{
+    close();
+    mFile.setFileName(path);
+    if(!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        mError = "could not write " + path;
+        return false;
+    }
+    mWidth = width;
+    mHeight = height;
+    mChannels = channels;
+    QByteArray header = QString("P%1\n%2 %3\n255\n").arg(channels == 1 ? 5 : 6).arg(width).arg(height).toLatin1();
+    if(mFile.write(header) != header.size()) {
+        mError = "could not write " + path;
+        return false;
+    }
+    mDataOffset = header.size();
+    mNextRow = 0;
+    return true;
+}
+
+void CNetpbmFile::close()
+{
+    if(mFile.isOpen()) mFile.close();
+    mError = QString();
+}
+
+bool CNetpbmFile::readRows(uchar * rows, uint count)
+{
+    qint64 bytes = (qint64)rowBytes() * count;
+    if(mNextRow + count > mHeight || mFile.read((char*)rows, bytes) != bytes) {
+        mError = "could not read rows from " + mFile.fileName();
+        return false;
+    }
+    mNextRow += count;
+    return true;
+}
+
+bool CNetpbmFile::writeRows(const uchar * rows, uint count)
+{
+    qint64 bytes = (qint64)rowBytes() * count;
+    if(mNextRow + count > mHeight || mFile.write((const char*)rows, bytes) != bytes) {
+        mError = "could not write rows to " + mFile.fileName();
+        return false;
+    }
+    mNextRow += count;
+    return true;
+}
+
+bool CNetpbmFile::isNetpbm(const QString& path)
+{
+    QFile file(path);
+    char magic[2];
+    if(!file.open(QIODevice::ReadOnly) || file.read(magic, 2) != 2) return false;
+    return magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6');
+}
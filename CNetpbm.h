@@ -0,0 +1,36 @@
+#ifndef CNETPBM_H
+#define CNETPBM_H
+
+#include "globals.h"
+#include <QFile>
+
+/* Binary PGM (P5) and PPM (P6) files with 8-bit samples, read and written a few rows at a
+ * time, so an image of any size passes through in bounded memory. Rows are packed: width
+ * bytes per row for PGM, 3 * width (R, G, B) for PPM, which is what QImage's Grayscale8 and
+ * RGB888 formats hold. */
+
+class CNetpbmFile
+{
+public:
+    QFile mFile;
+    uint mWidth, mHeight, mChannels;        // 1 for PGM, 3 for PPM
+    qint64 mDataOffset;                     // Of row 0 in the file
+    uint mNextRow;                          // Read or written so far
+    QString mError;
+
+    CNetpbmFile();
+
+    bool openRead(const QString& path);
+    bool openWrite(const QString& path, uint width, uint height, uint channels = 1);
+    void close();
+
+    bool readRows(uchar * rows, uint count);            // The next count rows
+    bool writeRows(const uchar * rows, uint count);
+
+    uint rowBytes() const { return mWidth * mChannels; }
+    QImage::Format format() const { return mChannels == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888; }
+
+    static bool isNetpbm(const QString& path);          // By the magic number, P5 or P6
+};
+
+#endif // CNETPBM_H
@@ -0,0 +1,86 @@
+#ifndef CPARALLEL_H
+#define CPARALLEL_H
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QSharedPointer>
+
+/* Row-band scheduling for the pipeline stages. parallelBands(pool, count, f) splits the rows
+ * [0, count) into bands and calls f(rowBegin, rowEnd) once per band, from the pool's threads
+ * and the calling thread, returning when every band is done. Bands are handed out from a
+ * shared counter, so a slow band does not hold up a whole thread's share.
+ *
+ * Each call waits for its own bands only, counted on a semaphore, not for the pool to drain:
+ * other work on a shared pool is not waited for, and a band that calls parallelBands() again
+ * cannot deadlock, since the caller takes bands itself and only waits for those being run. A
+ * task the pool starts after the last band finds none left and returns.
+ *
+ * A stage that reads a neighbourhood (a filter, suppression) simply reads its halo rows from
+ * the previous stage's full-frame output; every output pixel is computed by exactly the same
+ * arithmetic whatever the band layout, so results do not depend on the thread count. */
+
+#define CPARALLEL_BANDS_PER_THREAD 4
+
+// Shared by one call's tasks; outlives the call if the pool starts a task late
+struct CBandState
+{
+    QAtomicInt mNext;
+    QSemaphore mDone;                       // One release per finished band
+};
+
+template<typename F> class CBandTask : public QRunnable
+{
+public:
+    F * mWork;
+    QSharedPointer<CBandState> mState;
+    uint mCount, mBand;
+
+    CBandTask(F * work, const QSharedPointer<CBandState>& state, uint count, uint band)
+            : mWork(work), mState(state), mCount(count), mBand(band) {}
+
+    void run()
+    {
+        for(;;) {
+            uint from = (uint)mState->mNext.fetchAndAddRelaxed(1) * mBand;
+            if(from >= mCount) return;
+            (*mWork)(from, qMin(mCount, from + mBand));
+            mState->mDone.release();
+        }
+    }
+};
+
+// A QRunnable that calls f() once; the pool deletes it afterwards
+template<typename F> class CFunctionTask : public QRunnable
+{
+public:
+    F mWork;
+
+    CFunctionTask(F work) : mWork(work) {}
+
+    void run() { mWork(); }
+};
+
+template<typename F> QRunnable * newTask(F f)
+{
+    return new CFunctionTask<F>(f);
+}
+
+template<typename F> void parallelBands(QThreadPool * pool, uint count, F f)
+{
+    int threads = pool ? pool->maxThreadCount() : 1;
+    if(threads <= 1 || count < 2) {
+        f(0, count);
+        return;
+    }
+
+    uint band = qMax(1u, count / (threads * CPARALLEL_BANDS_PER_THREAD));
+    QSharedPointer<CBandState> state(new CBandState());
+    for(int t = 1; t < threads; t++)
+        pool->start(new CBandTask<F>(&f, state, count, band));
+    CBandTask<F>(&f, state, count, band).run();
+    state->mDone.acquire((count + band - 1) / band);
+}
+
+#endif // CPARALLEL_H
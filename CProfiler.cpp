@@ -0,0 +1,154 @@
+#include "CProfiler.h"
+#include <QFile>
+#include <QTextStream>
+
+CStageStats::CStageStats(const QString& stage)
+        : mStage(stage), mCount(0), mTotalNs(0), mMinNs(0), mMaxNs(0), mBytes(0), mPixels(0), mMaxThreads(0),
+          mHistogram(CPROFILER_BUCKETS, 0)
+{
+}
+
+void CStageStats::add(qint64 nanoseconds, qint64 bytes, qint64 pixels, uint threads)
+{
+    if(mCount == 0 || nanoseconds < mMinNs) mMinNs = nanoseconds;
+    if(mCount == 0 || nanoseconds > mMaxNs) mMaxNs = nanoseconds;
+    mCount++;
+    mTotalNs += nanoseconds;
+    mBytes += bytes;
+    mPixels += pixels;
+    mMaxThreads = qMax(mMaxThreads, threads);
+    mHistogram[bucketOf(nanoseconds)]++;
+}
+
+qint64 CStageStats::percentile(double p) const
+{
+    if(mCount == 0) return 0;
+    quint64 rank = qMax((quint64)1, (quint64)ceil(p * mCount)), seen = 0;
+    for(int b = 0; b < mHistogram.size(); b++) {
+        seen += mHistogram[b];
+        if(seen >= rank) return qBound(mMinNs, bucketUpper(b), mMaxNs);
+    }
+    return mMaxNs;
+}
+
+double CStageStats::meanNs() const
+{
+    return mCount == 0 ? 0 : (double)mTotalNs / mCount;
+}
+
+// Bucket b holds durations in [2^(b/8), 2^((b+1)/8)) nanoseconds
+int CStageStats::bucketOf(qint64 nanoseconds)
+{
+    if(nanoseconds <= 1) return 0;
+    int b = (int)floor(CPROFILER_BUCKETS_PER_DOUBLING * log2((double)nanoseconds));
+    return qMin(b, CPROFILER_BUCKETS - 1);
+}
+
+qint64 CStageStats::bucketUpper(int bucket)
+{
+    return (qint64)ceil(pow(2., (bucket + 1) / (double)CPROFILER_BUCKETS_PER_DOUBLING));
+}
+
+CProfiler::CProfiler(bool log)
+        : mLog(log)
+{
+}
+
+void CProfiler::record(const QString& stage, qint64 nanoseconds, qint64 bytes, qint64 pixels, uint threads)
+{
+    if(mLog)
+        qDebug() << stage << nanoseconds / 1e6 << "ms," << pixels << "pixels," << bytes << "bytes," << threads << "threads";
+
+    {
+        QMutexLocker locker(&mMutex);
+        int i = 0;
+        while(i < mStages.size() && mStages[i].mStage != stage) i++;
+        if(i == mStages.size()) mStages.append(CStageStats(stage));
+        mStages[i].add(nanoseconds, bytes, pixels, threads);
+    }
+    if(mOnRecord) mOnRecord(stage, nanoseconds, pixels);
+}
+
+QVector<CStageStats> CProfiler::stages()
+{
+    QMutexLocker locker(&mMutex);
+    return mStages;
+}
+
+void CProfiler::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mStages.clear();
+}
+
+/* {"stages": [{"stage": ..., "count": ..., "totalNs": ..., ..., "p99Ns": ...,
+ *   "histogram": [[upperNs, count], ...]}]}, with empty buckets left out */
+QString CProfiler::toJson()
+{
+    QVector<CStageStats> stats = stages();
+    QString json;
+    QTextStream out(&json);
+    out << "{\n  \"stages\": [";
+    for(int i = 0; i < stats.size(); i++) {
+        const CStageStats& s = stats[i];
+        out << (i > 0 ? "," : "") << "\n    {\"stage\": \"" << s.mStage << "\", \"count\": " << s.mCount
+            << ", \"totalNs\": " << s.mTotalNs << ", \"meanNs\": " << QString::number(s.meanNs(), 'f', 0)
+            << ", \"minNs\": " << s.mMinNs << ", \"p50Ns\": " << s.percentile(0.5)
+            << ", \"p90Ns\": " << s.percentile(0.9) << ", \"p99Ns\": " << s.percentile(0.99)
+            << ", \"maxNs\": " << s.mMaxNs << ", \"bytes\": " << s.mBytes << ", \"pixels\": " << s.mPixels
+            << ", \"maxThreads\": " << s.mMaxThreads << ",\n     \"histogram\": [";
+        bool first = true;
+        for(int b = 0; b < s.mHistogram.size(); b++) {
+            if(s.mHistogram[b] == 0) continue;
+            out << (first ? "" : ", ") << "[" << CStageStats::bucketUpper(b) << ", " << s.mHistogram[b] << "]";
+            first = false;
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+    out.flush();
+    return json;
+}
+
+QString CProfiler::toCsv()
+{
+    QVector<CStageStats> stats = stages();
+    QString csv;
+    QTextStream out(&csv);
+    out << "stage,count,total_ns,mean_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns,bytes,pixels,max_threads\n";
+    for(int i = 0; i < stats.size(); i++) {
+        const CStageStats& s = stats[i];
+        out << s.mStage << "," << s.mCount << "," << s.mTotalNs << "," << QString::number(s.meanNs(), 'f', 0) << ","
+            << s.mMinNs << "," << s.percentile(0.5) << "," << s.percentile(0.9) << "," << s.percentile(0.99) << ","
+            << s.mMaxNs << "," << s.mBytes << "," << s.mPixels << "," << s.mMaxThreads << "\n";
+    }
+    out.flush();
+    return csv;
+}
+
+bool CProfiler::save(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+    QTextStream out(&file);
+    out << (path.endsWith(".csv", Qt::CaseInsensitive) ? toCsv() : toJson());
+    return true;
+}
+
+CStageTimer::CStageTimer(CProfiler * profiler, const char * stage, qint64 pixels, uint threads)
+        : mProfiler(profiler), mStage(stage), mBytes(0), mPixels(pixels), mThreads(threads)
+{
+    mTimer.start();
+}
+
+CStageTimer::~CStageTimer()
+{
+    stop();
+}
+
+void CStageTimer::stop()
+{
+    if(mProfiler == 0) return;
+    mProfiler->record(mStage, mTimer.nsecsElapsed(), mBytes, mPixels, mThreads);
+    mProfiler = 0;
+}
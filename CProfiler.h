@@ -0,0 +1,76 @@
+#ifndef CPROFILER_H
+#define CPROFILER_H
+
+#include "globals.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <functional>
+
+/* Per-stage metrics for the pipeline. Every stage run is one sample: wall time in
+ * nanoseconds, bytes of matrices it allocated, pixels it processed and the threads it
+ * could use. Samples are folded into per-stage totals and a log-scale latency histogram
+ * (8 buckets per doubling, so percentiles are within 9%), which stays the same size however
+ * many images are profiled. One profiler may be shared by many CImages on many threads. */
+
+#define CPROFILER_BUCKETS_PER_DOUBLING 8
+#define CPROFILER_BUCKETS (CPROFILER_BUCKETS_PER_DOUBLING * 48)
+
+class CStageStats
+{
+public:
+    QString mStage;
+    quint64 mCount;
+    qint64 mTotalNs, mMinNs, mMaxNs;
+    qint64 mBytes, mPixels;
+    uint mMaxThreads;
+    QVector<quint64> mHistogram;            // Samples per bucket, see bucketOf()
+
+    CStageStats(const QString& stage = QString());
+
+    void add(qint64 nanoseconds, qint64 bytes, qint64 pixels, uint threads);
+    qint64 percentile(double p) const;      // Upper bound of the bucket holding that rank, p in [0, 1]
+    double meanNs() const;
+
+    static int bucketOf(qint64 nanoseconds);
+    static qint64 bucketUpper(int bucket);
+};
+
+class CProfiler
+{
+public:
+    bool mLog;                              // Also qDebug() every sample as it arrives
+    QMutex mMutex;
+    QVector<CStageStats> mStages;           // In order of first appearance
+
+    // Called after every sample on the thread that recorded it, outside mMutex; may be empty
+    std::function<void(const QString& stage, qint64 nanoseconds, qint64 pixels)> mOnRecord;
+
+    CProfiler(bool log = false);
+
+    void record(const QString& stage, qint64 nanoseconds, qint64 bytes, qint64 pixels, uint threads);
+    QVector<CStageStats> stages();          // A consistent copy
+    void clear();
+
+    QString toJson();
+    QString toCsv();
+    bool save(const QString& path);         // CSV for a .csv suffix, JSON otherwise
+};
+
+/* Times one stage run and records it when stopped or destroyed. Set mBytes before that.
+ * Without a profiler it only starts a clock: no allocation, so it can sit in the frame loop. */
+class CStageTimer
+{
+public:
+    CProfiler * mProfiler;
+    const char * mStage;
+    qint64 mBytes, mPixels;
+    uint mThreads;
+    QElapsedTimer mTimer;
+
+    CStageTimer(CProfiler * profiler, const char * stage, qint64 pixels, uint threads = 1);
+    ~CStageTimer();
+
+    void stop();
+};
+
+#endif // CPROFILER_H
@@ -0,0 +1,327 @@
+#include "CSimd.h"
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CSIMD_X86 1
+#include <immintrin.h>
+#define CSIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Bin edges exactly as CImage::canny spells them, so the comparisons match bit for bit
+static const double kBin1 = M_PI/8, kBin2 = 3*M_PI/8, kBin3 = 5*M_PI/8, kBin4 = 7*M_PI/8;
+
+void CSimd::mulAddScalar(double * out, const double * in, double k, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j]*k;
+}
+
+void CSimd::addScalar(double * out, const double * in, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j];
+}
+
+void CSimd::mulAddScalar(float * out, const float * in, float k, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j]*k;
+}
+
+void CSimd::addScalar(float * out, const float * in, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j];
+}
+
+void CSimd::mulAddScalar(ushort * out, const uchar * in, ushort k, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j]*k;
+}
+
+void CSimd::mulAddScalar(int * out, const ushort * in, int k, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j]*k;
+}
+
+void CSimd::squareScalar(double * row, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        row[j] *= row[j];
+}
+
+void CSimd::squareRootScalar(double * row, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        row[j] = sqrt(row[j]);
+}
+
+void CSimd::binAnglesScalar(int * out, const double * theta, uint n)
+{
+    for(uint j = 0; j < n; j++) {
+        double t = theta[j];
+        if(t < 0) t += M_PI;
+
+        if(t <= kBin1) out[j] = 3;
+        else if(t <= kBin2) out[j] = 2;
+        else if(t <= kBin3) out[j] = 1;
+        else if(t <= kBin4) out[j] = 4;
+        else out[j] = 3;
+    }
+}
+
+#ifdef CSIMD_X86
+
+/* Each kernel runs whole vectors and leaves the tail (fewer than one vector) to the scalar
+ * loop. Loads and stores are unaligned: row views and tap offsets are not vector-aligned. */
+
+CSIMD_TARGET("sse4.1") static void mulAddSSE4(double * out, const double * in, double k, uint n)
+{
+    __m128d vk = _mm_set1_pd(k);
+    uint j = 0;
+    for(; j + 2 <= n; j += 2)
+        _mm_storeu_pd(out + j, _mm_add_pd(_mm_loadu_pd(out + j), _mm_mul_pd(_mm_loadu_pd(in + j), vk)));
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void addSSE4(double * out, const double * in, uint n)
+{
+    uint j = 0;
+    for(; j + 2 <= n; j += 2)
+        _mm_storeu_pd(out + j, _mm_add_pd(_mm_loadu_pd(out + j), _mm_loadu_pd(in + j)));
+    CSimd::addScalar(out + j, in + j, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void mulAddSSE4(float * out, const float * in, float k, uint n)
+{
+    __m128 vk = _mm_set1_ps(k);
+    uint j = 0;
+    for(; j + 4 <= n; j += 4)
+        _mm_storeu_ps(out + j, _mm_add_ps(_mm_loadu_ps(out + j), _mm_mul_ps(_mm_loadu_ps(in + j), vk)));
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void addSSE4(float * out, const float * in, uint n)
+{
+    uint j = 0;
+    for(; j + 4 <= n; j += 4)
+        _mm_storeu_ps(out + j, _mm_add_ps(_mm_loadu_ps(out + j), _mm_loadu_ps(in + j)));
+    CSimd::addScalar(out + j, in + j, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void mulAddSSE4(ushort * out, const uchar * in, ushort k, uint n)
+{
+    __m128i vk = _mm_set1_epi16(k);
+    uint j = 0;
+    for(; j + 8 <= n; j += 8) {
+        __m128i v = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(in + j)));
+        __m128i o = _mm_loadu_si128((const __m128i*)(out + j));
+        _mm_storeu_si128((__m128i*)(out + j), _mm_add_epi16(o, _mm_mullo_epi16(v, vk)));
+    }
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void mulAddSSE4(int * out, const ushort * in, int k, uint n)
+{
+    __m128i vk = _mm_set1_epi32(k);
+    uint j = 0;
+    for(; j + 4 <= n; j += 4) {
+        __m128i v = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(in + j)));
+        __m128i o = _mm_loadu_si128((const __m128i*)(out + j));
+        _mm_storeu_si128((__m128i*)(out + j), _mm_add_epi32(o, _mm_mullo_epi32(v, vk)));
+    }
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void squareSSE4(double * row, uint n)
+{
+    uint j = 0;
+    for(; j + 2 <= n; j += 2) {
+        __m128d v = _mm_loadu_pd(row + j);
+        _mm_storeu_pd(row + j, _mm_mul_pd(v, v));
+    }
+    CSimd::squareScalar(row + j, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void squareRootSSE4(double * row, uint n)
+{
+    uint j = 0;
+    for(; j + 2 <= n; j += 2)
+        _mm_storeu_pd(row + j, _mm_sqrt_pd(_mm_loadu_pd(row + j)));
+    CSimd::squareRootScalar(row + j, n - j);
+}
+
+CSIMD_TARGET("sse4.1") static void binAnglesSSE4(int * out, const double * theta, uint n)
+{
+    const __m128d zero = _mm_setzero_pd(), pi = _mm_set1_pd(M_PI);
+    const __m128d b1 = _mm_set1_pd(kBin1), b2 = _mm_set1_pd(kBin2), b3 = _mm_set1_pd(kBin3), b4 = _mm_set1_pd(kBin4);
+    const __m128d c1 = _mm_set1_pd(1), c2 = _mm_set1_pd(2), c3 = _mm_set1_pd(3), c4 = _mm_set1_pd(4);
+    uint j = 0;
+    for(; j + 2 <= n; j += 2) {
+        __m128d t = _mm_loadu_pd(theta + j);
+        t = _mm_blendv_pd(t, _mm_add_pd(t, pi), _mm_cmplt_pd(t, zero));
+        // Walk the bins from the top down so the lowest matching edge wins
+        __m128d code = c3;
+        code = _mm_blendv_pd(code, c4, _mm_cmple_pd(t, b4));
+        code = _mm_blendv_pd(code, c1, _mm_cmple_pd(t, b3));
+        code = _mm_blendv_pd(code, c2, _mm_cmple_pd(t, b2));
+        code = _mm_blendv_pd(code, c3, _mm_cmple_pd(t, b1));
+        _mm_storel_epi64((__m128i*)(out + j), _mm_cvtpd_epi32(code));
+    }
+    CSimd::binAnglesScalar(out + j, theta + j, n - j);
+}
+
+CSIMD_TARGET("avx2") static void mulAddAVX2(double * out, const double * in, double k, uint n)
+{
+    __m256d vk = _mm256_set1_pd(k);
+    uint j = 0;
+    for(; j + 4 <= n; j += 4)
+        _mm256_storeu_pd(out + j, _mm256_add_pd(_mm256_loadu_pd(out + j), _mm256_mul_pd(_mm256_loadu_pd(in + j), vk)));
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("avx2") static void addAVX2(double * out, const double * in, uint n)
+{
+    uint j = 0;
+    for(; j + 4 <= n; j += 4)
+        _mm256_storeu_pd(out + j, _mm256_add_pd(_mm256_loadu_pd(out + j), _mm256_loadu_pd(in + j)));
+    CSimd::addScalar(out + j, in + j, n - j);
+}
+
+CSIMD_TARGET("avx2") static void mulAddAVX2(float * out, const float * in, float k, uint n)
+{
+    __m256 vk = _mm256_set1_ps(k);
+    uint j = 0;
+    for(; j + 8 <= n; j += 8)
+        _mm256_storeu_ps(out + j, _mm256_add_ps(_mm256_loadu_ps(out + j), _mm256_mul_ps(_mm256_loadu_ps(in + j), vk)));
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("avx2") static void addAVX2(float * out, const float * in, uint n)
+{
+    uint j = 0;
+    for(; j + 8 <= n; j += 8)
+        _mm256_storeu_ps(out + j, _mm256_add_ps(_mm256_loadu_ps(out + j), _mm256_loadu_ps(in + j)));
+    CSimd::addScalar(out + j, in + j, n - j);
+}
+
+CSIMD_TARGET("avx2") static void mulAddAVX2(ushort * out, const uchar * in, ushort k, uint n)
+{
+    __m256i vk = _mm256_set1_epi16(k);
+    uint j = 0;
+    for(; j + 16 <= n; j += 16) {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(in + j)));
+        __m256i o = _mm256_loadu_si256((const __m256i*)(out + j));
+        _mm256_storeu_si256((__m256i*)(out + j), _mm256_add_epi16(o, _mm256_mullo_epi16(v, vk)));
+    }
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("avx2") static void mulAddAVX2(int * out, const ushort * in, int k, uint n)
+{
+    __m256i vk = _mm256_set1_epi32(k);
+    uint j = 0;
+    for(; j + 8 <= n; j += 8) {
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(in + j)));
+        __m256i o = _mm256_loadu_si256((const __m256i*)(out + j));
+        _mm256_storeu_si256((__m256i*)(out + j), _mm256_add_epi32(o, _mm256_mullo_epi32(v, vk)));
+    }
+    CSimd::mulAddScalar(out + j, in + j, k, n - j);
+}
+
+CSIMD_TARGET("avx2") static void squareAVX2(double * row, uint n)
+{
+    uint j = 0;
+    for(; j + 4 <= n; j += 4) {
+        __m256d v = _mm256_loadu_pd(row + j);
+        _mm256_storeu_pd(row + j, _mm256_mul_pd(v, v));
+    }
+    CSimd::squareScalar(row + j, n - j);
+}
+
+CSIMD_TARGET("avx2") static void squareRootAVX2(double * row, uint n)
+{
+    uint j = 0;
+    for(; j + 4 <= n; j += 4)
+        _mm256_storeu_pd(row + j, _mm256_sqrt_pd(_mm256_loadu_pd(row + j)));
+    CSimd::squareRootScalar(row + j, n - j);
+}
+
+CSIMD_TARGET("avx2") static void binAnglesAVX2(int * out, const double * theta, uint n)
+{
+    const __m256d zero = _mm256_setzero_pd(), pi = _mm256_set1_pd(M_PI);
+    const __m256d b1 = _mm256_set1_pd(kBin1), b2 = _mm256_set1_pd(kBin2), b3 = _mm256_set1_pd(kBin3), b4 = _mm256_set1_pd(kBin4);
+    const __m256d c1 = _mm256_set1_pd(1), c2 = _mm256_set1_pd(2), c3 = _mm256_set1_pd(3), c4 = _mm256_set1_pd(4);
+    uint j = 0;
+    for(; j + 4 <= n; j += 4) {
+        __m256d t = _mm256_loadu_pd(theta + j);
+        t = _mm256_blendv_pd(t, _mm256_add_pd(t, pi), _mm256_cmp_pd(t, zero, _CMP_LT_OQ));
+        __m256d code = c3;
+        code = _mm256_blendv_pd(code, c4, _mm256_cmp_pd(t, b4, _CMP_LE_OQ));
+        code = _mm256_blendv_pd(code, c1, _mm256_cmp_pd(t, b3, _CMP_LE_OQ));
+        code = _mm256_blendv_pd(code, c2, _mm256_cmp_pd(t, b2, _CMP_LE_OQ));
+        code = _mm256_blendv_pd(code, c3, _mm256_cmp_pd(t, b1, _CMP_LE_OQ));
+        _mm_storeu_si128((__m128i*)(out + j), _mm256_cvtpd_epi32(code));
+    }
+    CSimd::binAnglesScalar(out + j, theta + j, n - j);
+}
+
+#endif // CSIMD_X86
+
+static CSimd::Level gLevel = CSimd::supportedLevel();
+
+CSimd::Level CSimd::supportedLevel()
+{
+#ifdef CSIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return AVX2;
+    if(__builtin_cpu_supports("sse4.1")) return SSE4;
+#endif
+    return Scalar;
+}
+
+CSimd::Level CSimd::level()
+{
+    return gLevel;
+}
+
+void CSimd::setLevel(Level level)
+{
+    gLevel = level < supportedLevel() ? level : supportedLevel();
+}
+
+const char * CSimd::levelName(Level level)
+{
+    switch(level) {
+    case AVX2: return "AVX2";
+    case SSE4: return "SSE4.1";
+    default: return "scalar";
+    }
+}
+
+#ifdef CSIMD_X86
+#define CSIMD_DISPATCH(name, ...) \
+    switch(gLevel) { \
+    case AVX2: name##AVX2(__VA_ARGS__); return; \
+    case SSE4: name##SSE4(__VA_ARGS__); return; \
+    default: name##Scalar(__VA_ARGS__); return; \
+    }
+#else
+#define CSIMD_DISPATCH(name, ...) name##Scalar(__VA_ARGS__);
+#endif
+
+void CSimd::mulAdd(double * out, const double * in, double k, uint n) { CSIMD_DISPATCH(mulAdd, out, in, k, n) }
+void CSimd::add(double * out, const double * in, uint n) { CSIMD_DISPATCH(add, out, in, n) }
+void CSimd::mulAdd(float * out, const float * in, float k, uint n) { CSIMD_DISPATCH(mulAdd, out, in, k, n) }
+void CSimd::add(float * out, const float * in, uint n) { CSIMD_DISPATCH(add, out, in, n) }
+void CSimd::mulAdd(ushort * out, const uchar * in, ushort k, uint n) { CSIMD_DISPATCH(mulAdd, out, in, k, n) }
+void CSimd::mulAdd(int * out, const ushort * in, int k, uint n) { CSIMD_DISPATCH(mulAdd, out, in, k, n) }
+void CSimd::square(double * row, uint n) { CSIMD_DISPATCH(square, row, n) }
+void CSimd::squareRoot(double * row, uint n) { CSIMD_DISPATCH(squareRoot, row, n) }
+void CSimd::binAngles(int * out, const double * theta, uint n) { CSIMD_DISPATCH(binAngles, out, theta, n) }
@@ -0,0 +1,90 @@
+#ifndef CSIMD_H
+#define CSIMD_H
+
+#include <cmath>
+
+typedef unsigned int uint;
+typedef unsigned short ushort;
+typedef unsigned char uchar;
+
+/* Vectorized inner loops for the hot CMatrix<double> (and CMatrix<float>) paths, picked at run time from the best
+ * instruction set the CPU supports (AVX2, SSE4.1, or the plain scalar loops). Every kernel
+ * does the same IEEE operations in the same order as its scalar loop, without fused
+ * multiply-adds, so the results are bit-identical whichever level runs. */
+
+class CSimd
+{
+public:
+    enum Level { Scalar = 0, SSE4 = 1, AVX2 = 2 };
+
+    static Level level();                   // Level in use
+    static Level supportedLevel();          // Best level this CPU can run
+    static void setLevel(Level level);      // Clamped to supportedLevel(); for testing
+    static const char * levelName(Level level);
+
+    // out[j] += in[j] * k
+    static void mulAdd(double * out, const double * in, double k, uint n);
+    // out[j] += in[j]
+    static void add(double * out, const double * in, uint n);
+    // Single-precision versions, for the float pipeline: twice the lanes per vector
+    static void mulAdd(float * out, const float * in, float k, uint n);
+    static void add(float * out, const float * in, uint n);
+    // Integer versions, for the fixed-point blur; the caller keeps the sums in range
+    static void mulAdd(ushort * out, const uchar * in, ushort k, uint n);
+    static void mulAdd(int * out, const ushort * in, int k, uint n);
+    // row[j] *= row[j]
+    static void square(double * row, uint n);
+    // row[j] = sqrt(row[j])
+    static void squareRoot(double * row, uint n);
+    // Canny direction bins of atan2 angles: 1 vertical, 2 and 4 diagonal, 3 horizontal
+    static void binAngles(int * out, const double * theta, uint n);
+
+    // The scalar versions, used as the fallback and as the reference
+    static void mulAddScalar(double * out, const double * in, double k, uint n);
+    static void addScalar(double * out, const double * in, uint n);
+    static void mulAddScalar(float * out, const float * in, float k, uint n);
+    static void addScalar(float * out, const float * in, uint n);
+    static void mulAddScalar(ushort * out, const uchar * in, ushort k, uint n);
+    static void mulAddScalar(int * out, const ushort * in, int k, uint n);
+    static void squareScalar(double * row, uint n);
+    static void squareRootScalar(double * row, uint n);
+    static void binAnglesScalar(int * out, const double * theta, uint n);
+};
+
+/* Row helpers used by CMatrix. The templates are the generic loops; the double and float
+ * overloads are preferred by overload resolution and go through the dispatched kernels. */
+
+template<typename T> inline void simdMulAdd(T * out, const T * in, T k, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j]*k;
+}
+
+template<typename T> inline void simdAdd(T * out, const T * in, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        out[j] += in[j];
+}
+
+template<typename T> inline void simdSquare(T * row, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        row[j] *= row[j];
+}
+
+template<typename T> inline void simdSquareRoot(T * row, uint n)
+{
+    for(uint j = 0; j < n; j++)
+        row[j] = sqrt(row[j]);
+}
+
+inline void simdMulAdd(double * out, const double * in, double k, uint n) { CSimd::mulAdd(out, in, k, n); }
+inline void simdAdd(double * out, const double * in, uint n) { CSimd::add(out, in, n); }
+inline void simdMulAdd(float * out, const float * in, float k, uint n) { CSimd::mulAdd(out, in, k, n); }
+inline void simdAdd(float * out, const float * in, uint n) { CSimd::add(out, in, n); }
+inline void simdMulAdd(ushort * out, const uchar * in, ushort k, uint n) { CSimd::mulAdd(out, in, k, n); }
+inline void simdMulAdd(int * out, const ushort * in, int k, uint n) { CSimd::mulAdd(out, in, k, n); }
+inline void simdSquare(double * row, uint n) { CSimd::square(row, n); }
+inline void simdSquareRoot(double * row, uint n) { CSimd::squareRoot(row, n); }
+
+#endif // CSIMD_H
@@ -0,0 +1,340 @@
+#include "CSparseEdges.h"
+#include <QFile>
+
+const int CSparseEdges::sMoves[8][2] = { {1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1} };
+
+CSparseEdges::CSparseEdges()
+        : mWidth(0), mHeight(0), mDirections(false), mDeflate(true)
+{
+    mRowStart.append(0);
+    mChainStart.append(0);
+}
+
+void CSparseEdges::extractRuns(const CMatrix<uchar>& edges)
+{
+    mHeight = edges.mHeight;
+    mWidth = edges.mWidth;
+    mRuns.resize(0);
+    mRowStart.resize(mHeight + 1);
+    mRowStart[0] = 0;
+    for(uint i = 0; i < mHeight; i++) {
+        const uchar * e = edges.row(i);
+        for(uint j = 0; j < mWidth; ) {
+            if(!e[j]) { j++; continue; }
+            uint begin = j;
+            while(j < mWidth && e[j]) j++;
+            CEdgeRun run = { begin, j, i };
+            mRuns.append(run);
+        }
+        mRowStart[i + 1] = mRuns.size();
+    }
+}
+
+void CSparseEdges::extractPoints(const CMatrix<uchar> * direction)
+{
+    mDirections = direction != 0;
+    mPoints.resize(0);
+    for(int r = 0; r < mRuns.size(); r++) {
+        const CEdgeRun& run = mRuns[r];
+        const uchar * d = direction ? direction->row(run.mLabel) : 0;
+        for(quint32 x = run.mBegin; x < run.mEnd; x++) {
+            CEdgePoint p = { x, run.mLabel, d ? d[x] : (uchar)0 };
+            mPoints.append(p);
+        }
+    }
+}
+
+void CSparseEdges::resizeMask(uint height, uint width)
+{
+    mHeight = height;
+    mWidth = width;
+    int stride = width + 2;
+    mMask.resize((height + 2) * stride);
+    memset(mMask.data(), 0, mMask.size());
+    for(int k = 0; k < 8; k++)
+        mOffsets[k] = sMoves[k][0] + sMoves[k][1] * stride;
+}
+
+// Walks from an edge pixel through unvisited ones, taking each into out
+void CSparseEdges::follow(quint32 from, QVector<quint32>& out)
+{
+    uchar * mask = mMask.data();
+    for(quint32 at = from; ; ) {
+        int k = 0;
+        while(k < 8 && !mask[at + mOffsets[k]]) k++;
+        if(k == 8) return;
+        at += mOffsets[k];
+        mask[at] = 0;
+        out.append(at);
+    }
+}
+
+void CSparseEdges::appendPoint(quint32 at, const CMatrix<uchar> * direction)
+{
+    uint stride = mWidth + 2;
+    CEdgePoint p = { at % stride - 1, at / stride - 1, 0 };
+    if(direction) p.mDirection = direction->row(p.mY)[p.mX];
+    mChainPoints.append(p);
+}
+
+void CSparseEdges::extractChains(const CMatrix<uchar>& edges, const CMatrix<uchar> * direction)
+{
+    resizeMask(edges.mHeight, edges.mWidth);
+    mDirections = direction != 0;
+    uint stride = mWidth + 2;
+    uchar * mask = mMask.data();
+    for(uint i = 0; i < mHeight; i++) {
+        const uchar * e = edges.row(i);
+        uchar * m = mask + (i + 1) * stride + 1;
+        for(uint j = 0; j < mWidth; j++)
+            m[j] = e[j] != 0;
+    }
+
+    // Seeds: first the ends of open curves, then every edge pixel in raster order
+    mSeeds.resize(0);
+    for(uint i = 0; i < mHeight; i++)
+        for(uint j = 0; j < mWidth; j++) {
+            quint32 at = (i + 1) * stride + j + 1;
+            if(!mask[at]) continue;
+            int neighbours = 0;
+            for(int k = 0; k < 8; k++)
+                neighbours += mask[at + mOffsets[k]];
+            if(neighbours == 1) mSeeds.append(at);
+        }
+    int ends = mSeeds.size();
+    for(uint i = 0; i < mHeight; i++)
+        for(uint j = 0; j < mWidth; j++)
+            if(mask[(i + 1) * stride + j + 1]) mSeeds.append((i + 1) * stride + j + 1);
+
+    mChainPoints.resize(0);
+    mChainStart.resize(1);
+    for(int s = 0; s < mSeeds.size(); s++) {
+        quint32 seed = mSeeds[s];
+        if(!mask[seed]) continue;
+        mask[seed] = 0;
+        mForward.resize(0);
+        mBackward.resize(0);
+        follow(seed, mForward);
+        if(s >= ends) follow(seed, mBackward);
+
+        // The backward part reversed, the seed, the forward part
+        for(int k = mBackward.size() - 1; k >= 0; k--)
+            appendPoint(mBackward[k], direction);
+        appendPoint(seed, direction);
+        for(int k = 0; k < mForward.size(); k++)
+            appendPoint(mForward[k], direction);
+        mChainStart.append(mChainPoints.size());
+    }
+}
+
+void CSparseEdges::extract(const CMatrix<uchar>& edges, const CMatrix<uchar> * direction)
+{
+    extractRuns(edges);
+    extractPoints(direction);
+    extractChains(edges, direction);
+}
+
+void CSparseEdges::toMask(CMatrix<uchar>& out) const
+{
+    for(uint i = 0; i < out.mHeight; i++)
+        memset(out.row(i), 0, out.mWidth);
+    for(int k = 0; k < mChainPoints.size(); k++)
+        out.at(mChainPoints[k].mY, mChainPoints[k].mX) = 1;
+}
+
+static void putVarint(QByteArray& out, quint32 v)
+{
+    while(v >= 0x80) {
+        out.append((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.append((char)v);
+}
+
+static bool getVarint(const uchar *& p, const uchar * end, quint32& v)
+{
+    v = 0;
+    for(int shift = 0; shift < 35 && p < end; shift += 7) {
+        uchar b = *p++;
+        v |= (quint32)(b & 0x7F) << shift;
+        if(!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Bits least significant first, into whole bytes
+struct CBitWriter
+{
+    QByteArray& mOut;
+    quint32 mBits;
+    int mCount;
+
+    CBitWriter(QByteArray& out) : mOut(out), mBits(0), mCount(0) {}
+    void put(quint32 value, int bits)
+    {
+        mBits |= value << mCount;
+        mCount += bits;
+        while(mCount >= 8) {
+            mOut.append((char)(mBits & 0xFF));
+            mBits >>= 8;
+            mCount -= 8;
+        }
+    }
+    void flush() { if(mCount > 0) mOut.append((char)mBits); mBits = 0; mCount = 0; }
+};
+
+struct CBitReader
+{
+    const uchar * mData, * mEnd;
+    quint32 mBits;
+    int mCount;
+
+    CBitReader(const uchar * data, const uchar * end) : mData(data), mEnd(end), mBits(0), mCount(0) {}
+    bool get(int bits, quint32& value)
+    {
+        while(mCount < bits) {
+            if(mData == mEnd) return false;
+            mBits |= (quint32)*mData++ << mCount;
+            mCount += 8;
+        }
+        value = mBits & ((1u << bits) - 1);
+        mBits >>= bits;
+        mCount -= bits;
+        return true;
+    }
+};
+
+static quint32 zigzag(qint32 v) { return ((quint32)v << 1) ^ (quint32)(v >> 31); }
+static qint32 unzigzag(quint32 v) { return (qint32)(v >> 1) ^ -(qint32)(v & 1); }
+
+QByteArray CSparseEdges::serialize() const
+{
+    CSparseEdgesHeader header;
+    memcpy(header.mMagic, CSPARSEEDGES_MAGIC, 8);
+    header.mWidth = mWidth;
+    header.mHeight = mHeight;
+    header.mChains = chains();
+    header.mPoints = mChainPoints.size();
+    header.mFlags = (mDirections ? CSPARSEEDGES_DIRECTIONS : 0) | (mDeflate ? CSPARSEEDGES_DEFLATED : 0);
+
+    QByteArray table;
+    quint32 lastRow = 0;
+    for(uint c = 0; c < chains(); c++) {
+        const CEdgePoint& first = mChainPoints[mChainStart[c]];
+        putVarint(table, mChainStart[c + 1] - mChainStart[c]);
+        putVarint(table, first.mX);
+        putVarint(table, zigzag((qint32)first.mY - (qint32)lastRow));
+        lastRow = first.mY;
+    }
+    header.mTableBytes = table.size();
+
+    QByteArray body = table;
+    CBitWriter bits(body);
+    for(uint c = 0; c < chains(); c++) {
+        for(quint32 k = mChainStart[c]; k < mChainStart[c + 1]; k++) {
+            const CEdgePoint& p = mChainPoints[k];
+            if(k > mChainStart[c]) {
+                const CEdgePoint& q = mChainPoints[k - 1];
+                int move = 0;
+                while(sMoves[move][0] != (int)p.mX - (int)q.mX || sMoves[move][1] != (int)p.mY - (int)q.mY) move++;
+                bits.put(move, 3);
+            }
+            if(mDirections) bits.put((p.mDirection - 1) & 3, 2);
+        }
+    }
+    bits.flush();
+    QByteArray out((const char*)&header, sizeof(header));
+    out.append(mDeflate ? qCompress(body) : body);
+    return out;
+}
+
+bool CSparseEdges::deserialize(const QByteArray& data)
+{
+    mRuns.resize(0);
+    mRowStart.resize(1);
+    mPoints.resize(0);
+    mChainPoints.resize(0);
+    mChainStart.resize(1);
+    CSparseEdgesHeader header;
+    if(data.size() < (int)sizeof(header) || memcmp(data.constData(), CSPARSEEDGES_MAGIC, 8) != 0) {
+        mError = "not a sparse edge file";
+        return false;
+    }
+    memcpy(&header, data.constData(), sizeof(header));
+    QByteArray body = data.mid(sizeof(header));
+    if(header.mFlags & CSPARSEEDGES_DEFLATED) {
+        body = qUncompress(body);
+        if(body.isEmpty() && header.mChains > 0) {
+            mError = "corrupt deflated chains";
+            return false;
+        }
+    }
+    const uchar * p = (const uchar*)body.constData(), * end = p + body.size();
+    if(header.mTableBytes > (quint64)(end - p)) {
+        mError = "truncated chain table";
+        return false;
+    }
+    mWidth = header.mWidth;
+    mHeight = header.mHeight;
+    mDirections = header.mFlags & CSPARSEEDGES_DIRECTIONS;
+
+    // Starts and lengths first, then the moves of every chain in turn
+    const uchar * table = p, * tableEnd = p + header.mTableBytes;
+    CBitReader bits(tableEnd, end);
+    qint64 lastRow = 0;
+    for(quint32 c = 0; c < header.mChains; c++) {
+        quint32 length, x, dy;
+        if(!getVarint(table, tableEnd, length) || !getVarint(table, tableEnd, x) || !getVarint(table, tableEnd, dy) || length == 0) {
+            mError = "corrupt chain table";
+            return false;
+        }
+        qint64 cx = x, cy = lastRow + unzigzag(dy);
+        lastRow = cy;
+        for(quint32 k = 0; k < length; k++) {
+            quint32 move = 0, dir = 0;
+            if(k > 0) {
+                if(!bits.get(3, move)) break;
+                cx += sMoves[move][0];
+                cy += sMoves[move][1];
+            }
+            if(mDirections && !bits.get(2, dir)) break;
+            if(cx < 0 || cy < 0 || cx >= mWidth || cy >= mHeight) {
+                mError = "chain leaves the frame";
+                return false;
+            }
+            CEdgePoint point = { (quint32)cx, (quint32)cy, (uchar)(mDirections ? dir + 1 : 0) };
+            mChainPoints.append(point);
+        }
+        if((quint32)mChainPoints.size() != mChainStart.last() + length) {
+            mError = "truncated moves";
+            return false;
+        }
+        mChainStart.append(mChainPoints.size());
+    }
+    if((quint32)mChainPoints.size() != header.mPoints) {
+        mError = "point count does not match";
+        return false;
+    }
+    return true;
+}
+
+bool CSparseEdges::save(const QString& path, QString * error) const
+{
+    QFile file(path);
+    QByteArray data = serialize();
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        if(error) *error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool CSparseEdges::load(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) {
+        mError = "could not read " + path;
+        return false;
+    }
+    return deserialize(file.readAll());
+}
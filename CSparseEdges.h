@@ -0,0 +1,86 @@
+#ifndef CSPARSEEDGES_H
+#define CSPARSEEDGES_H
+
+#include "globals.h"
+#include "CComponentTracker.h"
+
+/* Sparse forms of a hysteresis edge map (nonzero on edges), for when edges are a few percent
+ * of the frame and whatever comes next wants contours rather than pixels:
+ *
+ * runs     per row, the spans [mBegin, mEnd) of edge pixels; mLabel is the row
+ * points   every edge pixel, row after row
+ * chains   8-connected polylines that cover every edge pixel once. Tracing starts from the
+ *          pixels with a single neighbour, then from whatever is left in raster order (loops,
+ *          branches cut off at a junction), and grows both ways, preferring 4-neighbours.
+ *
+ * Points carry the gradient direction bin of canny() (1-4, see CImage::gradient) when one is
+ * given, else 0. Memory is kept between calls.
+ *
+ * save() writes the chains as a CSparseEdgesHeader, a table of varints per chain (length,
+ * start column, start row as a zigzag delta from the previous chain's) and a bit stream of
+ * 3-bit moves, each followed by the 2-bit direction of the point it reaches when the file
+ * has directions. That is 3 or 5 bits per edge pixel plus a few bytes per chain. With
+ * mDeflate, the table and the bit stream after the header are qCompress()ed: moves along a
+ * smooth contour and the directions beside them repeat, and deflate takes about 60% off. */
+
+#define CSPARSEEDGES_MAGIC "CEDGES01"
+#define CSPARSEEDGES_DIRECTIONS 1           // CSparseEdgesHeader::mFlags: points carry their direction
+#define CSPARSEEDGES_DEFLATED 2             // CSparseEdgesHeader::mFlags: what follows the header is qCompress()ed
+
+struct CSparseEdgesHeader
+{
+    char mMagic[8];                         // CSPARSEEDGES_MAGIC, without the terminator
+    quint32 mWidth, mHeight;
+    quint32 mChains, mPoints;
+    quint32 mFlags;
+    quint32 mTableBytes;                    // Of the chain table, before deflating; the bit stream follows it
+};
+
+struct CEdgePoint
+{
+    quint32 mX, mY;
+    uchar mDirection;
+};
+
+class CSparseEdges
+{
+public:
+    uint mWidth, mHeight;
+    QVector<CEdgeRun> mRuns;
+    QVector<quint32> mRowStart;             // Of each row in mRuns, and the end
+    QVector<CEdgePoint> mPoints;
+    QVector<CEdgePoint> mChainPoints;       // Chain after chain
+    QVector<quint32> mChainStart;           // Of each chain in mChainPoints, and the end
+    bool mDirections;                       // The points carry directions
+    bool mDeflate;                          // serialize() deflates the chains; true by default
+    QString mError;
+
+    // Tracing state: the frame with a one-pixel border, 1 on edge pixels not yet in a chain
+    QVector<uchar> mMask;
+    int mOffsets[8];
+    QVector<quint32> mSeeds, mForward, mBackward;
+
+    CSparseEdges();
+
+    void extractRuns(const CMatrix<uchar>& edges);
+    void extractPoints(const CMatrix<uchar> * direction = 0);                   // From mRuns
+    void extractChains(const CMatrix<uchar>& edges, const CMatrix<uchar> * direction = 0);
+    void extract(const CMatrix<uchar>& edges, const CMatrix<uchar> * direction = 0);    // All three
+
+    uint chains() const { return mChainStart.size() - 1; }
+    void toMask(CMatrix<uchar>& out) const;                                     // 1 on the chains' pixels
+
+    QByteArray serialize() const;
+    bool deserialize(const QByteArray& data);                                   // The chains; runs and points are cleared
+    bool save(const QString& path, QString * error = 0) const;
+    bool load(const QString& path);
+
+    static const int sMoves[8][2];          // (dx, dy) of each move code, 4-neighbours first
+
+protected:
+    void resizeMask(uint height, uint width);
+    void follow(quint32 from, QVector<quint32>& out);
+    void appendPoint(quint32 at, const CMatrix<uchar> * direction);
+};
+
+#endif // CSPARSEEDGES_H
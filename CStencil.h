@@ -0,0 +1,35 @@
+#ifndef CSTENCIL_H
+#define CSTENCIL_H
+
+/* 3x3 derivative stencils for CImage::gradient, each the outer product of a smoothing column
+ * [Side Centre Side] and the central difference [-1 0 1]:
+ *
+ *     gx = Side * diff(row above) + Centre * diff(row) + Side * diff(row below)
+ *     gy = smooth(row below) - smooth(row above)
+ *
+ * where diff is right minus left and smooth weighs left, centre and right by [Side Centre Side].
+ * The weights are template arguments, so the gradient is compiled once per stencil with its
+ * taps as constants: the difference's zero tap never appears, its -1 and +1 taps are a
+ * subtraction and an addition, and a weight of 1 is no multiplication at all.
+ *
+ * A step of height 1 gives 2 * Side + Centre (the gain), so magnitudes are multiplied by
+ * scale() to come out on Prewitt's scale, and thresholds mean the same whatever the stencil. */
+
+template<int Side, int Centre> struct CStencil
+{
+    static const int sSide = Side, sCentre = Centre;
+    static const int sGain = 2 * Side + Centre;
+    static constexpr double scale() { return 3. / sGain; }     // 1, 3/4, 3/16: exact in binary
+};
+
+typedef CStencil<1, 1> CPrewitt;
+typedef CStencil<1, 2> CSobel;
+typedef CStencil<3, 10> CScharr;
+
+// v times a tap known at compile time
+template<int Weight, typename Sum> inline Sum stencilWeigh(Sum v)
+{
+    return Weight == 1 ? v : v * (Sum)Weight;
+}
+
+#endif // CSTENCIL_H
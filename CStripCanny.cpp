@@ -0,0 +1,219 @@
+#include "CStripCanny.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTemporaryFile>
+
+CStripOptions::CStripOptions()
+        : sigma(1), useR(true), useG(true), useB(true), thresholdLow(0.007), thresholdHigh(0.099),
+          stripRows(256), threads(1), profiler(0)
+{
+}
+
+CStripCanny::CStripCanny(const CStripOptions& options)
+        : mOptions(options), mWidth(0), mHeight(0), mStrips(0), mRuns(0), mComponents(0), mEdgePixels(0),
+          mWindowBytes(0), mTableBytes(0), mTempBytes(0), mSeconds(0)
+{
+    mEngine = new CImage(0, 0);
+    mEngine->setThreadCount(mOptions.threads);
+    mEngine->mProfiler = mOptions.profiler;
+}
+
+CStripCanny::~CStripCanny()
+{
+    delete mEngine;
+}
+
+// Four double matrices and the direction codes for the strip and its halos, plus raw input rows
+qint64 CStripCanny::windowBytes(uint width, uint stripRows, double sigma)
+{
+    uint rows = qMax(1u, stripRows) + 2 * ((CImage::gaussianSize(sigma) - 1) / 2 + 2);
+    qint64 stride = CMatD::strideFor(width), strideU = CMatrix<uchar>::strideFor(width);
+    return (qint64)rows * (4 * stride * sizeof(double) + strideU + 3 * width);
+}
+
+bool CStripCanny::run(const QString& input, const QString& output)
+{
+    QElapsedTimer timer;
+    timer.start();
+    mError = QString();
+    mStrips = 0;
+    mRuns = mComponents = mEdgePixels = 0;
+
+    CNetpbmFile source;
+    QImage whole;
+    bool streamed = CNetpbmFile::isNetpbm(input);
+    QImage::Format format;
+    if(streamed) {
+        if(!source.openRead(input)) {
+            mError = source.mError;
+            return false;
+        }
+        mWidth = source.mWidth;
+        mHeight = source.mHeight;
+        format = source.format();
+    } else {
+        whole = QImage(input);
+        if(whole.isNull()) {
+            mError = "could not decode " + input;
+            return false;
+        }
+        // Rows are wrapped as they are, so a palette or an unusual layout is converted once
+        format = whole.format();
+        if(format != QImage::Format_RGB32 && format != QImage::Format_ARGB32 && format != QImage::Format_ARGB32_Premultiplied &&
+                format != QImage::Format_Grayscale8 && format != QImage::Format_RGB888) {
+            whole = whole.convertToFormat(QImage::Format_RGB32);
+            format = QImage::Format_RGB32;
+        }
+        mWidth = whole.width();
+        mHeight = whole.height();
+    }
+
+    CNetpbmFile edges;
+    if(!edges.openWrite(output, mWidth, mHeight, 1)) {
+        mError = edges.mError;
+        return false;
+    }
+    QTemporaryFile runFile(QDir(mOptions.tempDir.isEmpty() ? QDir::tempPath() : mOptions.tempDir).filePath("canny_runs_XXXXXX"));
+    if(!runFile.open()) {
+        mError = "could not create a temporary file for the runs";
+        return false;
+    }
+
+    // The window holds a strip and up to `halo` rows on either side
+    uint w = mWidth, h = mHeight, strip = qMax(1u, mOptions.stripRows);
+    CMatD& kernel = mEngine->mWorkspace->gaussian(mOptions.sigma);
+    uint halo = (kernel.mWidth - 1) / 2 + 2, capacity = strip + 2*halo;
+    CMatD in(capacity, w), rowPass(capacity, w), blurred(capacity, w), magnitude(capacity, w);
+    CMatrix<uchar> direction(capacity, w);
+    QVector<uchar> raw(streamed ? capacity * source.rowBytes() : 0);
+    mWindowBytes = in.bytes() + rowPass.bytes() + blurred.bytes() + magnitude.bytes() + direction.bytes() + raw.size();
+
+    QVector<quint32> parent;
+    QVector<uchar> strong;
+    QVector<CEdgeRun> runs;
+    mEngine->mHeight = h;
+    mEngine->mWidth = w;
+
+    uint loadedTop = 0, loadedEnd = 0;      // Image rows held by the window
+    for(uint r0 = 0; r0 < h; r0 += strip) {
+        mEngine->mWorkspace->beginFrame();
+        uint r1 = qMin(h, r0 + strip);
+        uint top = r0 > halo ? r0 - halo : 0, bottom = qMin(h, r1 + halo), rows = bottom - top;
+        qint64 pixels = (qint64)(r1 - r0) * w;
+        uint threads = mEngine->threadCount();
+        mStrips++;
+
+        // Rows shared with the last window move up; the rest are read in order
+        CStageTimer ingest(mOptions.profiler, "ingest", pixels);
+        uint keep = loadedEnd - top, count = bottom - loadedEnd;
+        if(top > loadedTop)
+            memmove(in.row(0), in.row(top - loadedTop), (size_t)keep * in.mStride * sizeof(double));
+        CMatD fresh(in.row(keep), count, w);
+        if(streamed) {
+            if(!source.readRows(raw.data(), count)) {
+                mError = source.mError;
+                return false;
+            }
+            QImage view(raw.data(), w, count, source.rowBytes(), format);
+            fresh.fromImage(&view, mOptions.useR, mOptions.useG, mOptions.useB);
+        } else {
+            QImage view(whole.constScanLine(loadedEnd), w, count, whole.bytesPerLine(), format);
+            fresh.fromImage(&view, mOptions.useR, mOptions.useG, mOptions.useB);
+        }
+        loadedTop = top;
+        loadedEnd = bottom;
+        ingest.stop();
+
+        // Only the strip and two rows either side need the column pass
+        CMatD window(in.row(0), rows, w), pass(rowPass.row(0), rows, w), blur(blurred.row(0), rows, w), mag(magnitude.row(0), rows, w);
+        CMatrix<uchar> dir(direction.row(0), rows, w);
+        uint s0 = r0 - top, s1 = r1 - top;
+        uint b0 = s0 > 2 ? s0 - 2 : 0, b1 = qMin(rows, s1 + 2);
+        CStageTimer blurStage(mOptions.profiler, "blur", pixels, threads);
+        parallelBands(mEngine->mPool, rows, [&](uint rowBegin, uint rowEnd) {
+            window.filterRows(pass, kernel, rowBegin, rowEnd);
+        });
+        parallelBands(mEngine->mPool, b1 - b0, [&](uint rowBegin, uint rowEnd) {
+            pass.filterColumns(blur, kernel, b0 + rowBegin, b0 + rowEnd);
+        });
+        blurStage.stop();
+
+        CStageTimer gradientStage(mOptions.profiler, "gradient", pixels, threads);
+        uint g0 = s0 > 0 ? s0 - 1 : 0, g1 = qMin(rows, s1 + 1);
+        parallelBands(mEngine->mPool, g1 - g0, [&](uint rowBegin, uint rowEnd) {
+            mEngine->gradient(blur, mag, dir, g0 + rowBegin, g0 + rowEnd);
+        });
+        gradientStage.stop();
+
+        // The row pass is spent, so the suppressed rows go there
+        CStageTimer suppressionStage(mOptions.profiler, "suppression", pixels, threads);
+        parallelBands(mEngine->mPool, s1 - s0, [&](uint rowBegin, uint rowEnd) {
+            mEngine->suppression(pass, mag, dir, s0 + rowBegin, s0 + rowEnd);
+        });
+        suppressionStage.stop();
+
+        /* First hysteresis pass: runs >= low, each joined to the runs above it that it touches.
+         * The row above keeps its runs at the front of runs until the row below is labelled. */
+        CStageTimer labelStage(mOptions.profiler, "label", pixels);
+        for(uint i = s0; i < s1; i++) {
+            uint above = runs.size();
+            quint32 n = CComponentTracker::labelRow(pass.row(i), w, mOptions.thresholdLow, mOptions.thresholdHigh,
+                                                    runs, 0, above, parent, strong);
+            qint64 bytes = (qint64)n * sizeof(CEdgeRun);
+            if(runFile.write((const char*)&n, sizeof(n)) != sizeof(n) || runFile.write((const char*)(runs.constData() + above), bytes) != bytes) {
+                mError = "could not write the run file";
+                return false;
+            }
+            mRuns += n;
+            runs.remove(0, above);
+        }
+        labelStage.stop();
+    }
+
+    // Every label now points straight at its root, and carries the root's verdict
+    mComponents = parent.size();
+    mTableBytes = parent.capacity() * sizeof(quint32) + strong.capacity();
+    for(int l = 0; l < parent.size(); l++) {
+        parent[l] = parent[parent[l]];
+        strong[l] = strong[parent[l]];
+    }
+    mTempBytes = runFile.size();
+
+    // Second pass: the edge map, a strip of rows at a time
+    CStageTimer traceStage(mOptions.profiler, "trace", (qint64)w * h);
+    runFile.flush();
+    runFile.seek(0);
+    QVector<uchar> rowsOut(strip * w);
+    for(uint r0 = 0; r0 < h; r0 += strip) {
+        uint r1 = qMin(h, r0 + strip);
+        memset(rowsOut.data(), 0, rowsOut.size());
+        for(uint i = r0; i < r1; i++) {
+            quint32 n;
+            if(runFile.read((char*)&n, sizeof(n)) != sizeof(n)) {
+                mError = "could not read the run file";
+                return false;
+            }
+            runs.resize(n);
+            qint64 bytes = (qint64)n * sizeof(CEdgeRun);
+            if(runFile.read((char*)runs.data(), bytes) != bytes) {
+                mError = "could not read the run file";
+                return false;
+            }
+            uchar * o = rowsOut.data() + (i - r0) * w;
+            for(uint k = 0; k < n; k++)
+                if(strong[runs[k].mLabel]) {
+                    memset(o + runs[k].mBegin, 255, runs[k].mEnd - runs[k].mBegin);
+                    mEdgePixels += runs[k].mEnd - runs[k].mBegin;
+                }
+        }
+        if(!edges.writeRows(rowsOut.constData(), r1 - r0)) {
+            mError = edges.mError;
+            return false;
+        }
+    }
+    traceStage.stop();
+
+    mSeconds = timer.nsecsElapsed() / 1e9;
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef CSTRIPCANNY_H
+#define CSTRIPCANNY_H
+
+#include "globals.h"
+#include "CImage.h"
+#include "CNetpbm.h"
+#include "CComponentTracker.h"
+
+/* Out-of-core Canny for images too large to hold as matrices. The input goes through the
+ * pipeline in strips of mOptions.stripRows rows; each strip is blurred with a halo of the
+ * Gaussian radius plus the two rows the gradient and suppression stencils reach, so its
+ * suppressed rows are exactly those of CImage::canny(). Memory is a window of the strip and
+ * its halos, whatever the image height.
+ *
+ * Hysteresis connects edges across the whole image, so it runs in two passes. The first labels
+ * each row's runs of pixels >= the low threshold, joining them to touching runs of the row
+ * above with union-find, and appends the labelled runs to a temporary file. The second reads
+ * the runs back and writes the rows of the edge map (255 on edges) to a PGM file, in order.
+ * Only the union-find tables, one entry per run that started a new component, scale with the
+ * image.
+ *
+ * Binary PGM and PPM inputs are streamed from disk; other formats are decoded whole by Qt,
+ * which still costs a fraction of the in-memory pipeline. Works in double precision. */
+
+struct CStripOptions
+{
+    double sigma;
+    bool useR, useG, useB;
+    double thresholdLow, thresholdHigh;
+    uint stripRows;
+    uint threads;                           // Row-band threads inside each strip
+    QString tempDir;                        // For the run file; empty for QDir::tempPath()
+    CProfiler * profiler;
+
+    CStripOptions();
+};
+
+class CStripCanny
+{
+public:
+    CStripOptions mOptions;
+    CImage * mEngine;                       // Pool, workspace and stages
+    QString mError;
+
+    // Statistics of the last run()
+    uint mWidth, mHeight, mStrips;
+    quint64 mRuns, mComponents, mEdgePixels;
+    qint64 mWindowBytes;                    // Strip window and its intermediates
+    qint64 mTableBytes;                     // Union-find tables at their largest
+    qint64 mTempBytes;                      // Run file
+    double mSeconds;
+
+    CStripCanny(const CStripOptions& options);
+    ~CStripCanny();
+
+    bool run(const QString& input, const QString& output);     // Output is a PGM edge map
+
+    static qint64 windowBytes(uint width, uint stripRows, double sigma);
+};
+
+#endif // CSTRIPCANNY_H
@@ -0,0 +1,159 @@
+#include "CSuppressedCache.h"
+#include "CImage.h"
+#include "CMappedFile.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QPair>
+#include <QTemporaryFile>
+#include <algorithm>
+
+// Indexes whatever an earlier session left in dir, oldest use first out
+CSuppressedCache::CSuppressedCache(const QString& dir, qint64 maxBytes)
+        : mDir(dir), mMaxBytes(maxBytes), mBytes(0), mHits(0), mMisses(0), mStores(0), mEvictions(0)
+{
+    QDir().mkpath(mDir);
+    QFileInfoList files = QDir(mDir).entryInfoList(QStringList() << "*" CSUPPRESSEDCACHE_SUFFIX, QDir::Files);
+    for(int i = 0; i < files.size(); i++) {
+        Entry entry = { files[i].size(), files[i].lastModified().toMSecsSinceEpoch() };
+        mEntries.insert(files[i].completeBaseName(), entry);
+        mBytes += entry.mBytes;
+    }
+    QMutexLocker locker(&mMutex);
+    evict();
+}
+
+bool CSuppressedCache::fetch(const QString& key, CImage& image)
+{
+    {
+        QMutexLocker locker(&mMutex);
+        if(!mEntries.contains(key)) {
+            mMisses++;
+            return false;
+        }
+    }
+
+    // Mapping can take a while for a large dump, so it runs unlocked
+    bool loaded = image.loadSuppressed(path(key));
+
+    QMutexLocker locker(&mMutex);
+    QHash<QString, Entry>::iterator entry = mEntries.find(key);
+    if(!loaded) {
+        // Truncated or foreign; it would fail every time, so it goes
+        mMisses++;
+        if(entry != mEntries.end() && QFile::remove(path(key))) {
+            mBytes -= entry->mBytes;
+            mEntries.erase(entry);
+        }
+        return false;
+    }
+    mHits++;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if(entry != mEntries.end()) entry->mUsed = now;
+    QFile file(path(key));
+    if(file.open(QIODevice::ReadWrite))
+        file.setFileTime(QDateTime::fromMSecsSinceEpoch(now), QFileDevice::FileModificationTime);
+    return true;
+}
+
+bool CSuppressedCache::contains(const QString& key)
+{
+    QMutexLocker locker(&mMutex);
+    return mEntries.contains(key);
+}
+
+bool CSuppressedCache::store(const QString& key, const CMatD& suppressed)
+{
+    QTemporaryFile part(mDir + "/" + key + ".partXXXXXX");
+    if(!part.open()) return false;
+    part.setAutoRemove(false);
+    part.close();
+    QString partName = part.fileName();
+    if(!CMappedFile::saveMatrix(suppressed, partName)) {
+        QFile::remove(partName);
+        return false;
+    }
+
+    // Another thread may have stored the same key meanwhile; either copy will do
+    QString target = path(key);
+    if(!QFile::rename(partName, target)) {
+        QFile::remove(partName);
+        if(!QFile::exists(target)) return false;
+    }
+
+    QMutexLocker locker(&mMutex);
+    mStores++;
+    Entry entry = { QFileInfo(target).size(), QDateTime::currentMSecsSinceEpoch() };
+    QHash<QString, Entry>::iterator old = mEntries.find(key);
+    if(old != mEntries.end()) mBytes -= old->mBytes;
+    mEntries.insert(key, entry);
+    mBytes += entry.mBytes;
+    evict();
+    return true;
+}
+
+void CSuppressedCache::evict()
+{
+    if(mBytes <= mMaxBytes) return;
+    QVector<QPair<qint64, QString> > byUse;
+    for(QHash<QString, Entry>::iterator e = mEntries.begin(); e != mEntries.end(); ++e)
+        byUse.append(qMakePair(e->mUsed, e.key()));
+    std::sort(byUse.begin(), byUse.end());
+
+    // A dump still mapped cannot be removed on some systems; it is tried again on the next store
+    for(int i = 0; i < byUse.size() && mBytes > mMaxBytes; i++) {
+        if(!QFile::remove(path(byUse[i].second))) continue;
+        mBytes -= mEntries[byUse[i].second].mBytes;
+        mEntries.remove(byUse[i].second);
+        mEvictions++;
+    }
+}
+
+void CSuppressedCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+    QList<QString> keys = mEntries.keys();
+    for(int i = 0; i < keys.size(); i++)
+        if(QFile::remove(path(keys[i]))) {
+            mBytes -= mEntries[keys[i]].mBytes;
+            mEntries.remove(keys[i]);
+        }
+}
+
+QString CSuppressedCache::summary()
+{
+    QMutexLocker locker(&mMutex);
+    quint64 lookups = mHits + mMisses;
+    return QString("%1 hits, %2 misses (%3% hit rate), %4 stored, %5 evicted; %6 entries, %7 of %8 MB")
+            .arg(mHits).arg(mMisses).arg(lookups ? 100. * mHits / lookups : 0., 0, 'f', 1)
+            .arg(mStores).arg(mEvictions).arg(mEntries.size())
+            .arg(mBytes / 1048576., 0, 'f', 1).arg(mMaxBytes / 1048576., 0, 'f', 0);
+}
+
+QByteArray CSuppressedCache::hashFile(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)) return QByteArray();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if(!hash.addData(&file)) return QByteArray();
+    return hash.result();
+}
+
+QByteArray CSuppressedCache::hashBytes(const uchar * data, qint64 size)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for(qint64 done = 0; done < size; done += 1 << 30)
+        hash.addData((const char*)data + done, (int)qMin(size - done, (qint64)1 << 30));
+    return hash.result();
+}
+
+// No channel selected means all three, as in CMatrix::fromImage
+QString CSuppressedCache::key(const QByteArray& sourceHash, double sigma, bool useR, bool useG, bool useB, const QString& variant)
+{
+    if(!(useR || useG || useB))
+        useR = useG = useB = true;
+    return QString("%1-s%2-%3%4%5-%6").arg(QString::fromLatin1(sourceHash.toHex())).arg(sigma, 0, 'g', 17)
+            .arg(useR ? "r" : "").arg(useG ? "g" : "").arg(useB ? "b" : "").arg(variant);
+}
@@ -0,0 +1,57 @@
+#ifndef CSUPPRESSEDCACHE_H
+#define CSUPPRESSEDCACHE_H
+
+#include "globals.h"
+#include <QHash>
+#include <QMutex>
+
+class CImage;
+
+/* Content-addressed disk cache of CImage::mSuppressed, for re-running hysteresis with new
+ * thresholds without redoing blur, gradient and suppression. An entry is a raw CMatrix dump
+ * (see CMappedFile) named after a hash of the source file's bytes and the parameters that
+ * shape mSuppressed: sigma, the channel mask and the pipeline variant (precision, or pyramid
+ * mode and its flag threshold). A hit maps the dump back, so it costs a page-in, not a decode.
+ *
+ * The directory is kept under mMaxBytes by evicting the least recently used entries. Use is
+ * the file's modification time, which a hit refreshes, so the order survives restarts. One
+ * cache may serve many CImages on many threads; entries are written under a temporary name
+ * and renamed into place, so a reader never maps a half-written dump. */
+
+#define CSUPPRESSEDCACHE_BYTES ((qint64)1 << 30)
+#define CSUPPRESSEDCACHE_SUFFIX ".cmat"
+
+class CSuppressedCache
+{
+public:
+    struct Entry
+    {
+        qint64 mBytes;
+        qint64 mUsed;                       // Milliseconds since the epoch
+    };
+
+    QString mDir;
+    qint64 mMaxBytes;
+    QMutex mMutex;                          // Guards everything below
+    QHash<QString, Entry> mEntries;         // By key
+    qint64 mBytes;
+    quint64 mHits, mMisses, mStores, mEvictions;
+
+    CSuppressedCache(const QString& dir, qint64 maxBytes = CSUPPRESSEDCACHE_BYTES);
+
+    bool fetch(const QString& key, CImage& image);              // Maps the entry into image.mSuppressed on a hit
+    bool store(const QString& key, const CMatD& suppressed);
+    bool contains(const QString& key);                          // Counts as neither hit nor miss
+    void clear();                                               // Removes every entry, keeps the counters
+    QString summary();
+
+    QString path(const QString& key) const { return mDir + "/" + key + CSUPPRESSEDCACHE_SUFFIX; }
+
+    static QByteArray hashFile(const QString& path);            // Empty when it cannot be read
+    static QByteArray hashBytes(const uchar * data, qint64 size);
+    static QString key(const QByteArray& sourceHash, double sigma, bool useR, bool useG, bool useB, const QString& variant);
+
+    void evict();                                               // Down to mMaxBytes; the caller holds mMutex
+};
+
+#endif // CSUPPRESSEDCACHE_H
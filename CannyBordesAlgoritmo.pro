@@ -14,13 +14,13 @@ TARGET = CannyBordesAlgoritmo
 TEMPLATE = app
 
 
+include(engine.pri)
+
 SOURCES += main.cpp\
-        mainwindow.cpp \
-    CImage.cpp
+        mainwindow.cpp\
+        CCannyWorker.cpp
 
-HEADERS  += mainwindow.h \
-    CImage.h \
-    CMatrix.h \
-    globals.h
+HEADERS  += mainwindow.h\
+        CCannyWorker.h
 
 FORMS    += mainwindow.ui
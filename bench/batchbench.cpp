@@ -0,0 +1,84 @@
+#include "bench.h"
+#include "CImageBatch.h"
+#include <QThread>
+
+/* CImageBatch against one canny() and hysteresis() call per image, on small tiles: images per
+ * second with a new CImage per tile (what a preprocessing loop does without the batch), with one
+ * CImage reused for every tile, and with the batch. Checks that each tile's suppressed
+ * magnitudes and edges in the batch equal the reused CImage's. */
+
+static void fillTiles(QVector<QImage>& tiles, uint count, uint side)
+{
+    uint across = 16;
+    QImage scene = benchScene(BenchBlocks, across * side, (count + across - 1) / across * side);
+    tiles.resize(0);
+    for(uint t = 0; t < count; t++)
+        tiles.append(scene.copy((t % across) * side, (t / across) * side, side, side));
+}
+
+int benchBatch(int argc, char ** argv)
+{
+    uint count = argc > 0 ? atoi(argv[0]) : 256;
+    double sigma = argc > 1 ? atof(argv[1]) : 1;
+    const uint sides[] = { 64, 128, 256 };
+    const double low = 0.007, high = 0.099;
+    bool ok = true;
+
+    printf("%u tiles per batch, sigma %.1f, %d threads; images per second\n", count, sigma, QThread::idealThreadCount());
+    printf("%-6s %-7s %14s %14s %14s %9s %7s\n", "tile", "type", "CImage each", "CImage reused", "CImageBatch", "speedup", "same");
+    for(uint s = 0; s < sizeof(sides) / sizeof(sides[0]); s++) {
+        QVector<QImage> tiles;
+        fillTiles(tiles, count, sides[s]);
+        for(int p = 0; p < 3; p += 2) {
+            CImage::Precision precision = (CImage::Precision)p;
+
+            double each = benchBest([&]() {
+                for(uint t = 0; t < count; t++) {
+                    CImage image(tiles[t]);
+                    image.canny(sigma, true, true, true, precision);
+                    delete image.hysteresis(*image.mSuppressed, low, high);
+                }
+            }, 3);
+
+            CImage reused(tiles[0]);
+            double again = benchBest([&]() {
+                for(uint t = 0; t < count; t++) {
+                    *reused.mImage = tiles[t];
+                    reused.canny(sigma, true, true, true, precision);
+                    delete reused.hysteresis(*reused.mSuppressed, low, high);
+                }
+            }, 3);
+
+            CImageBatchOptions options;
+            options.sigma = sigma;
+            options.thresholdLow = low;
+            options.thresholdHigh = high;
+            options.precision = precision;
+            CImageBatch batch(options);
+            double batched = benchBest([&]() { batch.run(tiles); }, 3);
+
+            // Tile by tile against the reused CImage
+            bool same = true;
+            uint side = sides[s];
+            for(uint t = 0; t < count && same; t++) {
+                *reused.mImage = tiles[t];
+                reused.canny(sigma, true, true, true, precision);
+                CMatrix<uchar> * edges = reused.hysteresis(*reused.mSuppressed, low, high);
+                CMatD suppressed(*batch.mSuppressed, t * side, (t + 1) * side);
+                CMatrix<uchar> batchEdges(*batch.mEdges, t * side, (t + 1) * side);
+                for(uint i = 0; i < side && same; i++)
+                    for(uint j = 0; j < side && same; j++)
+                        same = suppressed.at(i,j) == reused.mSuppressed->at(i,j) && batchEdges.at(i,j) == edges->at(i,j);
+                delete edges;
+            }
+            ok = ok && same;
+
+            char label[16];
+            snprintf(label, sizeof(label), "%u", side);
+            printf("%-6s %-7s %14.0f %14.0f %14.0f %8.2fx %7s\n", p == 0 ? label : "", p == 0 ? "double" : "fixed",
+                   count / each, count / again, count / batched, each / batched, same ? "yes" : "NO");
+        }
+    }
+    printf("speedup = CImageBatch over a new CImage per tile\n");
+    return ok ? 0 : 1;
+}
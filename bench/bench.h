@@ -0,0 +1,70 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "globals.h"
+#include <QElapsedTimer>
+#include <cstdio>
+#include <cstdlib>
+
+// Runs f() `repeats` times and returns the fastest run in seconds
+template<typename F> double benchBest(F f, int repeats = 5)
+{
+    double best = -1;
+    QElapsedTimer timer;
+    for(int r = 0; r < repeats; r++) {
+        timer.start();
+        f();
+        double s = timer.nsecsElapsed() / 1e9;
+        if(best < 0 || s < best) best = s;
+    }
+    return best;
+}
+
+// Fills a matrix with reproducible pseudo-random values in [0, 1)
+template<typename M> void benchFillRandom(M& m, uint seed = 1)
+{
+    srand(seed);
+    for(uint i = 0; i < m.mHeight; i++)
+        for(uint j = 0; j < m.mWidth; j++)
+            m.at(i,j) = rand() / (RAND_MAX + 1.);
+}
+
+/* Synthetic scenes shared by the suites, so their numbers describe the same images. Every
+ * level is a function of the pixel, noise included, so a scene comes out the same filled into
+ * a QImage, cut into tiles or written to a file row by row. Grey, on all three channels. */
+enum BenchScene
+{
+    BenchSparse,                            // Few edges: a slow ramp with five large discs on it
+    BenchShapes,                            // Discs every 160 x 120 over a ramp: edges everywhere, at every orientation
+    BenchDense,                             // Edges everywhere: 5 x 5 cells of unrelated levels
+    BenchBlocks,                            // 41 x 29 checkerboard, contrast levels apart, moving 3 right and 2 down per frame
+    BenchLines                              // Blocks of three levels crossed by thin diagonal lines
+};
+
+uchar benchSceneLevel(BenchScene scene, uint x, uint y, uint w, uint h, int contrast = 130, uint frame = 0);
+QImage benchScene(BenchScene scene, uint w, uint h, int contrast = 130, uint frame = 0);      // RGB32
+bool benchWriteScene(const QString& path, uint w, uint h, BenchScene scene = BenchLines);     // Binary PPM, a row at a time
+
+int benchMatrix(int argc, char ** argv);
+int benchBlur(int argc, char ** argv);
+int benchThreads(int argc, char ** argv);
+int benchSimd(int argc, char ** argv);
+int benchGradient(int argc, char ** argv);
+int benchHysteresis(int argc, char ** argv);
+int benchComponents(int argc, char ** argv);
+int benchPrecision(int argc, char ** argv);
+int benchImage(int argc, char ** argv);
+int benchWorkspace(int argc, char ** argv);
+int benchStream(int argc, char ** argv);
+int benchThresholds(int argc, char ** argv);
+int benchPyramid(int argc, char ** argv);
+int benchOutOfCore(int argc, char ** argv);
+int benchMapped(int argc, char ** argv);
+int benchCache(int argc, char ** argv);
+int benchRegions(int argc, char ** argv);
+int benchSparse(int argc, char ** argv);
+int benchStencil(int argc, char ** argv);
+int benchStages(int argc, char ** argv);
+int benchBatch(int argc, char ** argv);
+
+#endif // BENCH_H
@@ -0,0 +1,42 @@
+#-------------------------------------------------
+#
+# Micro-benchmarks for the edge detection engine.
+# Usage: CannyBench <suite> [options]
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = CannyBench
+TEMPLATE = app
+
+include(../engine.pri)
+
+SOURCES += main.cpp \
+    scenes.cpp \
+    matrixbench.cpp \
+    blurbench.cpp \
+    threadbench.cpp \
+    simdbench.cpp \
+    gradientbench.cpp \
+    hysteresisbench.cpp \
+    precisionbench.cpp \
+    imagebench.cpp \
+    workspacebench.cpp \
+    streambench.cpp \
+    thresholdbench.cpp \
+    pyramidbench.cpp \
+    outofcorebench.cpp \
+    mappedbench.cpp \
+    cachebench.cpp \
+    regionbench.cpp \
+    sparsebench.cpp \
+    stencilbench.cpp \
+    stagebench.cpp \
+    batchbench.cpp
+
+HEADERS += bench.h \
+    legacymatrix.h
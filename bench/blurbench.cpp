@@ -0,0 +1,38 @@
+#include "bench.h"
+#include "CImage.h"
+
+/* Gaussian blur: the direct n x n sum against the separable row + column passes, for a
+ * range of sigmas. Also reports the largest difference between the two results. */
+
+int benchBlur(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+
+    CMatD image(h, w);
+    benchFillRandom(image);
+    CImage dummy(1, 1);
+
+    printf("Gaussian blur, %u x %u\n", w, h);
+    printf("%6s %6s %12s %12s %9s %12s\n", "sigma", "taps", "direct", "separable", "speedup", "max diff");
+
+    const double sigmas[] = { 0.5, 1, 2, 3, 5, 8 };
+    for(uint s = 0; s < sizeof(sigmas)/sizeof(sigmas[0]); s++) {
+        CMatD square = dummy.gaussianFilter(sigmas[s]);
+        CMatD line = dummy.gaussianFilter1D(sigmas[s]);
+
+        CMatD * direct = 0, * separable = 0;
+        double td = benchBest([&]() { delete direct; direct = image.filterByDirect(square); }, 1);
+        double ts = benchBest([&]() { delete separable; separable = image.filterBySeparable(line, line); }, 3);
+
+        double maxDiff = 0;
+        for(uint i = 0; i < h; i++)
+            for(uint j = 0; j < w; j++)
+                maxDiff = qMax(maxDiff, fabs(direct->at(i,j) - separable->at(i,j)));
+
+        printf("%6.1f %6u %9.1f ms %9.1f ms %8.1fx %12.3g\n", sigmas[s], line.mWidth, td*1e3, ts*1e3, td/ts, maxDiff);
+        delete direct;
+        delete separable;
+    }
+    return 0;
+}
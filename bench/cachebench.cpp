@@ -0,0 +1,93 @@
+#include "bench.h"
+#include "CImage.h"
+#include "CSuppressedCache.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+
+/* The threshold-tuning loop of the GUI: reload the file, canny() with the same settings,
+ * hysteresis with new thresholds. Times it without a cache, on a miss (which also stores) and
+ * on a hit, and checks that a hit gives the same mSuppressed and edges. Then fills a small cache
+ * past its limit and checks that eviction goes by last use, not by insertion. */
+
+int benchCache(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    double sigma = 2;
+    QDir temp(QDir::tempPath());
+    QString input = temp.filePath("canny_cache_in.ppm"), dir = temp.filePath("canny_cache");
+    if(!benchWriteScene(input, w, h)) {
+        fprintf(stderr, "Could not write %s\n", qPrintable(input));
+        return 1;
+    }
+    QDir(dir).removeRecursively();
+
+    CSuppressedCache cache(dir);
+    CMatD * reference = 0;
+    CMatrix<uchar> * referenceEdges = 0;
+    bool ok = true;
+
+    printf("%u x %u, sigma %.1f: reload, canny(), hysteresis()\n", w, h, sigma);
+    printf("%-16s %10s %10s\n", "mode", "time", "identical");
+    const char * modes[] = { "no cache", "miss and store", "hit" };
+    for(int m = 0; m < 3; m++) {
+        CImage * image = 0;
+        CMatrix<uchar> * edges = 0;
+        double t = benchBest([&]() {
+            if(m == 1) cache.clear();
+            delete edges;
+            delete image;
+            image = new CImage(input);
+            if(m > 0) image->mCache = &cache;
+            image->canny(sigma, true, true, true);
+            edges = image->hysteresis(*image->mSuppressed, 0.02, 0.08);
+        }, 3);
+
+        bool identical = true;
+        if(m == 0) {
+            reference = new CMatD(*image->mSuppressed);
+            referenceEdges = new CMatrix<uchar>(*edges);
+        } else {
+            for(uint i = 0; i < h && identical; i++)
+                identical = memcmp(reference->row(i), image->mSuppressed->row(i), w * sizeof(double)) == 0 &&
+                            memcmp(referenceEdges->row(i), edges->row(i), w) == 0;
+            ok = ok && identical;
+        }
+        printf("%-16s %7.2f ms %10s\n", modes[m], t * 1e3, m == 0 ? "" : identical ? "yes" : "NO");
+        delete edges;
+        delete image;
+    }
+    printf("%s\n", qPrintable(cache.summary()));
+
+    // Room for three entries: after a, b, c and a use of a, storing d must evict b
+    QByteArray hash = CSuppressedCache::hashFile(input);
+    qint64 entry = QFileInfo(cache.path(CSuppressedCache::key(hash, sigma, true, true, true, "double"))).size();
+    CSuppressedCache small(dir + "_lru", 3 * entry + entry / 2);
+    small.clear();
+    const char * names[] = { "a", "b", "c", "d" };
+    CImage loader(0, 0);
+    for(int k = 0; k < 4; k++) {
+        if(k == 3) {
+            // Use times are in milliseconds; keep them apart
+            QThread::msleep(5);
+            small.fetch(CSuppressedCache::key(hash, sigma, true, true, true, names[0]), loader);
+        }
+        QThread::msleep(5);
+        small.store(CSuppressedCache::key(hash, sigma, true, true, true, names[k]), *reference);
+    }
+    bool lru = small.contains(CSuppressedCache::key(hash, sigma, true, true, true, "a")) &&
+               !small.contains(CSuppressedCache::key(hash, sigma, true, true, true, "b")) &&
+               small.mEvictions == 1 && small.mBytes <= small.mMaxBytes;
+    ok = ok && lru;
+    printf("LRU eviction: %s (%s)\n", lru ? "yes" : "NO", qPrintable(small.summary()));
+
+    delete reference;
+    delete referenceEdges;
+    small.clear();
+    cache.clear();
+    QDir(dir).removeRecursively();
+    QDir(dir + "_lru").removeRecursively();
+    QFile::remove(input);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "CImage.h"
+
+/* Gradient stage: the unfused path (two Prewitt filters, copies, square/add/sqrt, atan2 and
+ * angle binning, seven full-frame matrices) against CImage::gradient, which writes only a
+ * magnitude and a uint8 direction. Reports time and peak intermediate memory, and checks
+ * that both produce the same magnitudes and directions. */
+
+template<typename T> static double megabytes(CMatrix<T>& m)
+{
+    return (double)sizeof(T) * m.mStride * m.mHeight / (1024. * 1024.);
+}
+
+int benchGradient(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 3840;
+    uint h = argc > 1 ? atoi(argv[1]) : 2160;
+
+    CImage image(w, h);
+    image.setThreadCount(1);
+    image.mWidth = w;
+    image.mHeight = h;
+
+    CMatD blurred(h, w);
+    benchFillRandom(blurred);
+
+    CMatD prewittX(3, 3, 0), prewittY(3, 3, 0);
+    for(uint i = 0; i < 3; i++) {
+        prewittX[i][0] = -1;
+        prewittX[i][2] = +1;
+        prewittY[0][i] = -1;
+        prewittY[2][i] = +1;
+    }
+
+    double unfusedMB = 0, fusedMB = 0;
+    CMatD * grad = 0;
+    CMatrix<int> * bins = 0;
+    double tu = benchBest([&]() {
+        delete grad;
+        delete bins;
+        CMatD gradX(h, w), gradY(h, w);
+        image.filter(blurred, gradX, prewittX);
+        image.filter(blurred, gradY, prewittY);
+        grad = new CMatD(&gradX);
+        CMatD temp(&gradY);
+        grad->squareElementsInPlace();
+        temp.squareElementsInPlace();
+        *grad += temp;
+        grad->squareRootElementsInPlace();
+        CMatD * theta = CMatD::atan2(gradY, gradX);
+        bins = new CMatrix<int>(h, w);
+        for(uint i = 0; i < h; i++)
+            CSimd::binAngles(bins->row(i), theta->row(i), w);
+        // gradX, gradY, grad, temp, theta, bins, plus the separable pass scratch
+        unfusedMB = 6 * megabytes(gradX) + megabytes(*bins);
+        delete theta;
+    }, 3);
+
+    CMatD magnitude(h, w);
+    CMatrix<uchar> direction(h, w);
+    double tf = benchBest([&]() {
+        image.gradient(blurred, magnitude, direction, 0, h);
+    }, 3);
+    fusedMB = megabytes(magnitude) + megabytes(direction);
+
+    uint magnitudeDiffs = 0, directionDiffs = 0;
+    for(uint i = 0; i < h; i++)
+        for(uint j = 0; j < w; j++) {
+            if(magnitude.at(i,j) != grad->at(i,j)) magnitudeDiffs++;
+            if(direction.at(i,j) != bins->at(i,j)) directionDiffs++;
+        }
+
+    printf("Gradient stage, %u x %u, 1 thread\n", w, h);
+    printf("%-10s %12s %14s\n", "path", "time", "intermediates");
+    printf("%-10s %9.1f ms %11.1f MB\n", "unfused", tu*1e3, unfusedMB);
+    printf("%-10s %9.1f ms %11.1f MB\n", "fused", tf*1e3, fusedMB);
+    printf("speedup %.2fx, memory %.1fx smaller\n", tu/tf, unfusedMB/fusedMB);
+    printf("differences: %u magnitudes, %u directions (bin-edge ties)\n", magnitudeDiffs, directionDiffs);
+
+    delete grad;
+    delete bins;
+    return magnitudeDiffs == 0 ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include "bench.h"
+#include "CImage.h"
+#include <QDir>
+#include <QThread>
+
+/* Hysteresis: the original breadth-first search over a queue of coordinate pairs against
+ * CEdgeTracker. Dense textures are the worst case for the queue, which pushes all 8
+ * neighbours of every accepted pixel. Checks that both mark the same pixels. */
+
+static CMatrix<int> * legacyHysteresis(CMatD& grad, double thresholdLow, double thresholdHigh)
+{
+    int h = grad.mHeight, w = grad.mWidth;
+    queue< pair<int, int> > nodes;
+    CMatrix<int> * out = new CMatrix<int>(h, w, 0);
+    for(int i = 0; i < h; i++)
+        for(int j = 0; j < w; j++) {
+            if((grad[i][j] >= thresholdHigh) && out->at(i,j) != 1) {
+                nodes.push(pair<int, int>(i,j));
+                while(!nodes.empty()) {
+                    pair<int, int> node = nodes.front();
+                    nodes.pop();
+                    int x = node.first, y = node.second;
+                    if(x < 0 || x >= h || y < 0 || y >= w) continue;
+                    if(grad[x][y] < thresholdLow) continue;
+                    if(out->at(x,y) != 1) {
+                        out->at(x,y) = 1;
+                        for(int dx = -1; dx <= 1; dx++)
+                            for(int dy = -1; dy <= 1; dy++)
+                                if(dx != 0 || dy != 0) nodes.push(pair<int, int>(x+dx, y+dy));
+                    }
+                }
+            }
+        }
+    return out;
+}
+
+// Keeps each pixel with probability `density`, at a random strength in [0, 1)
+static void fillTexture(CMatD& grad, double density, uint seed)
+{
+    benchFillRandom(grad, seed);
+    for(uint i = 0; i < grad.mHeight; i++)
+        for(uint j = 0; j < grad.mWidth; j++)
+            if(rand() / (RAND_MAX + 1.) >= density) grad.at(i,j) = 0;
+}
+
+int benchHysteresis(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 3840;
+    uint h = argc > 1 ? atoi(argv[1]) : 2160;
+    const double low = 0.2, high = 0.8;
+    const double densities[] = { 0.1, 0.5, 1.0 };
+
+    printf("Hysteresis, %u x %u, thresholds %.2f / %.2f\n", w, h, low, high);
+    printf("%-8s %8s %12s %12s %9s %8s\n", "density", "edges", "queue", "tracker", "speedup", "diffs");
+
+    CMatD grad(h, w);
+    CEdgeTracker tracker(h, w);
+    CMatrix<uchar> edges(h, w);
+    int failures = 0;
+    for(uint d = 0; d < sizeof(densities)/sizeof(densities[0]); d++) {
+        fillTexture(grad, densities[d], 7 + d);
+
+        CMatrix<int> * reference = 0;
+        double tq = benchBest([&]() {
+            delete reference;
+            reference = legacyHysteresis(grad, low, high);
+        }, 3);
+        double tt = benchBest([&]() {
+            tracker.track(grad, low, high, edges);
+        }, 3);
+
+        uint count = 0, diffs = 0;
+        for(uint i = 0; i < h; i++)
+            for(uint j = 0; j < w; j++) {
+                count += edges.at(i,j);
+                if(edges.at(i,j) != reference->at(i,j)) diffs++;
+            }
+        if(diffs > 0) failures++;
+
+        printf("%-8.2f %8u %9.1f ms %9.1f ms %8.2fx %8u\n",
+               densities[d], count, tq*1e3, tt*1e3, tq/tt, diffs);
+        delete reference;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
+
+/* Thread scaling of CComponentTracker against the serial CEdgeTracker, on the textures above
+ * and on the suppressed magnitudes of a synthetic photo. Every run, at any thread count, must
+ * mark exactly the pixels of the queue BFS; one thread still cuts the frame into bands, so the
+ * border joins are checked even on a single core. */
+int benchComponents(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 3840;
+    uint h = argc > 1 ? atoi(argv[1]) : 2160;
+    uint maxThreads = argc > 2 ? atoi(argv[2]) : qMax(2, QThread::idealThreadCount());
+    const double densities[] = { 0.1, 0.5, 1.0 };
+
+    printf("Union-find hysteresis, %u x %u\n", w, h);
+    printf("%-12s %8s %12s %8s %12s %9s %8s\n", "input", "threads", "flood fill", "", "components", "speedup", "diffs");
+
+    CMatD grad(h, w);
+    CEdgeTracker tracker(h, w);
+    CComponentTracker components;
+    CMatrix<uchar> serial(h, w), edges(h, w);
+    int failures = 0;
+    for(uint d = 0; d <= sizeof(densities)/sizeof(densities[0]); d++) {
+        double low = 0.2, high = 0.8;
+        QString name;
+        if(d < sizeof(densities)/sizeof(densities[0])) {
+            fillTexture(grad, densities[d], 7 + d);
+            name = QString("density %1").arg(densities[d], 0, 'f', 1);
+        } else {
+            QString path = QDir(QDir::tempPath()).filePath("canny_components.ppm");
+            benchWriteScene(path, w, h);
+            CImage image(path);
+            image.canny(2, true, true, true);
+            grad = *image.mSuppressed;
+            QFile::remove(path);
+            low = 0.007;
+            high = 0.099;
+            name = "photo";
+        }
+
+        CMatrix<int> * reference = legacyHysteresis(grad, low, high);
+        double ts = benchBest([&]() { tracker.track(grad, low, high, serial); }, 3);
+        for(uint threads = 1; threads <= maxThreads; threads *= 2) {
+            QThreadPool pool;
+            pool.setMaxThreadCount(threads);
+            double tc = benchBest([&]() { components.track(grad, low, high, edges, &pool); }, 3);
+
+            uint diffs = 0;
+            for(uint i = 0; i < h; i++)
+                for(uint j = 0; j < w; j++)
+                    if(edges.at(i,j) != reference->at(i,j) || serial.at(i,j) != reference->at(i,j)) diffs++;
+            if(diffs > 0) failures++;
+            printf("%-12s %8u %9.1f ms %8s %9.1f ms %8.2fx %8u\n", qPrintable(name), threads, ts*1e3, "", tc*1e3, ts/tc, diffs);
+        }
+        delete reference;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
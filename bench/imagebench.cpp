@@ -0,0 +1,82 @@
+#include "bench.h"
+
+/* QImage ingestion and export: the original pixel()/setPixel() loops against the scan-line
+ * converters in CMatrix, for each format they handle. Checks that ingestion is bit-identical
+ * and that the exported levels are the same. */
+
+static CMatD * legacyRead(QImage * im)
+{
+    CMatD * m = new CMatD(im->height(), im->width());
+    for(uint i = 0; i < m->mHeight; i++)
+        for(uint j = 0; j < m->mWidth; j++) {
+            uint p = im->pixel(j,i);
+            double v = 0;
+            v += (p&0xFF)*0.11;
+            v += ((p&0xFF00)>>8)*0.59;
+            v += ((p&0xFF0000)>>16)*0.3;
+            v /= (0.11 + 0.59 + 0.3) * 256.;
+            m->at(i,j) = v;
+        }
+    return m;
+}
+
+static QImage * legacyWrite(CMatD& m)
+{
+    QImage * out = new QImage(m.mWidth, m.mHeight, QImage::Format_RGB32);
+    for(uint i = 0; i < m.mHeight; i++)
+        for(uint j = 0; j < m.mWidth; j++) {
+            uint c = (uint)ceil(m.at(i,j)*255.);
+            out->setPixel(j, i, qRgb(c,c,c));
+        }
+    return out;
+}
+
+int benchImage(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 3840;
+    uint h = argc > 1 ? atoi(argv[1]) : 2160;
+    const QImage::Format formats[] = { QImage::Format_RGB32, QImage::Format_Grayscale8, QImage::Format_RGB888 };
+    const char * names[] = { "RGB32", "Grayscale8", "RGB888" };
+
+    QImage rgb(w, h, QImage::Format_RGB32);
+    srand(5);
+    for(uint y = 0; y < h; y++)
+        for(uint x = 0; x < w; x++)
+            rgb.setPixel(x, y, qRgb(rand() % 256, rand() % 256, rand() % 256));
+
+    printf("QImage conversion, %u x %u\n", w, h);
+    printf("%-20s %13s %13s %9s %10s\n", "operation", "per-pixel", "scan lines", "speedup", "identical");
+    bool ok = true;
+    for(uint f = 0; f < 3; f++) {
+        QImage image = rgb.convertToFormat(formats[f]);
+        CMatD * reference = 0, * fast = 0;
+        double tl = benchBest([&]() { delete reference; reference = legacyRead(&image); }, 3);
+        double tc = benchBest([&]() { delete fast; fast = new CMatD(&image); }, 3);
+        bool identical = true;
+        for(uint i = 0; i < h && identical; i++)
+            identical = memcmp(reference->row(i), fast->row(i), w * sizeof(double)) == 0;
+        ok = ok && identical;
+        printf("read %-15s %10.2f ms %10.2f ms %8.2fx %10s\n", names[f], tl*1e3, tc*1e3, tl/tc, identical ? "yes" : "NO");
+        delete reference;
+        delete fast;
+    }
+
+    CMatD levels(h, w);
+    benchFillRandom(levels);
+    QImage * reference = 0;
+    double tl = benchBest([&]() { delete reference; reference = legacyWrite(levels); }, 3);
+    for(uint f = 0; f < 3; f++) {
+        QImage * fast = 0;
+        double tc = benchBest([&]() { delete fast; fast = levels.toNewImage(false, formats[f]); }, 3);
+        bool identical = true;
+        for(uint y = 0; y < h && identical; y++)
+            for(uint x = 0; x < w && identical; x++)
+                identical = qGray(fast->pixel(x, y)) == qGray(reference->pixel(x, y));
+        ok = ok && identical;
+        printf("write %-14s %10.2f ms %10.2f ms %8.2fx %10s\n", names[f], tl*1e3, tc*1e3, tl/tc, identical ? "yes" : "NO");
+        delete fast;
+    }
+    delete reference;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#ifndef LEGACYMATRIX_H
+#define LEGACYMATRIX_H
+
+#include "globals.h"
+
+/* The original CMatrix layout, kept only as a benchmark reference: an array of
+ * separately allocated rows, every element reached through two pointers. */
+
+template<typename T> class CLegacyArray
+{
+public:
+    uint mSize;
+    T * mItems;
+
+    CLegacyArray(uint size) : mSize(size) { mItems = new T[mSize]; }
+    ~CLegacyArray() { delete [] mItems; }
+
+    T& operator[](uint index) { return mItems[index]; }
+
+    T sum()
+    {
+        T r = 0;
+        for(uint i = 0; i < mSize; i++)
+            r += mItems[i];
+        return r;
+    }
+};
+
+template<typename T> class CLegacyMatrix
+{
+public:
+    uint mHeight, mWidth;
+    CLegacyArray<T> ** mRows;
+
+    CLegacyMatrix(uint height, uint width)
+            : mHeight(height), mWidth(width)
+    {
+        mRows = new CLegacyArray<T>*[mHeight];
+        for(uint i = 0; i < mHeight; i++)
+            mRows[i] = new CLegacyArray<T>(mWidth);
+    }
+
+    CLegacyMatrix(CLegacyMatrix<T> * copyFrom)
+            : mHeight(copyFrom->mHeight), mWidth(copyFrom->mWidth)
+    {
+        mRows = new CLegacyArray<T>*[mHeight];
+        for(uint i = 0; i < mHeight; i++) {
+            mRows[i] = new CLegacyArray<T>(mWidth);
+            for(uint j = 0; j < mWidth; j++)
+                at(i,j) = copyFrom->at(i,j);
+        }
+    }
+
+    ~CLegacyMatrix()
+    {
+        for(uint i = 0; i < mHeight; i++)
+            delete mRows[i];
+        delete [] mRows;
+    }
+
+    CLegacyArray<T> & operator[](uint index) { return *mRows[index]; }
+    T& at(uint x, uint y) { return (*mRows[x]).operator [](y); }
+
+    void operator+=(CLegacyMatrix<T>& summand)
+    {
+        for(uint i = 0; i < mHeight; i++)
+            for(uint j = 0; j < mWidth; j++)
+                at(i, j) += summand.at(i, j);
+    }
+
+    void squareElementsInPlace()
+    {
+        for(uint i = 0; i < mHeight; i++)
+            for(uint j = 0; j < mWidth; j++)
+                at(i, j) *= at(i, j);
+    }
+
+    void squareRootElementsInPlace()
+    {
+        for(uint i = 0; i < mHeight; i++)
+            for(uint j = 0; j < mWidth; j++)
+                at(i, j) = sqrt(at(i, j));
+    }
+
+    static CLegacyMatrix<T> * atan2(CLegacyMatrix<T>& y, CLegacyMatrix<T>& x)
+    {
+        CLegacyMatrix<T> * out = new CLegacyMatrix<T>(y.mHeight, y.mWidth);
+        for(uint i = 0; i < y.mHeight; i++)
+            for(uint j = 0; j < y.mWidth; j++)
+                out->at(i, j) = ::atan2(y[i][j], x[i][j]);
+        return out;
+    }
+
+    T sum()
+    {
+        T r = 0;
+        for(uint i = 0; i < mHeight; i++)
+            r += mRows[i]->sum();
+        return r;
+    }
+
+    CLegacyMatrix<T> * filterBy(CLegacyMatrix<T>& kernel)
+    {
+        CLegacyMatrix<T> * out = new CLegacyMatrix<T>(mHeight, mWidth);
+        int rangeX = (kernel.mHeight-1)/2, rangeY = (kernel.mWidth-1)/2;
+        for(uint i = 0; i < mHeight; i++) {
+            for(uint j = 0; j < mWidth; j++) {
+                out->at(i, j) = 0;
+                for(int x = -rangeX; x <= rangeX; x++) {
+                    int posX = x + i;
+                    if(posX < 0 || posX >= (int)mHeight) continue;
+                    for(int y = -rangeY; y <= rangeY; y++) {
+                        int posY = y + j;
+                        if(posY < 0 || posY >= (int)mWidth) continue;
+                        out->at(i, j) += at(posX, posY)*kernel[rangeX+x][rangeY+y];
+                    }
+                }
+            }
+        }
+        return out;
+    }
+
+    QImage * toNewImage()
+    {
+        QImage * out = new QImage(mWidth, mHeight, QImage::Format_RGB32);
+        T min = at(0,0), max = at(0,0);
+        for(uint i = 0; i < mHeight; i++)
+            for(uint j = 0; j < mWidth; j++) {
+                if(min > at(i,j)) min = at(i,j);
+                if(max < at(i,j)) max = at(i,j);
+            }
+        double baseline = min, scaleFactor = (max != min) ? 255./(max - min) : 255.;
+        for(uint i = 0; i < mHeight; i++)
+            for(uint j = 0; j < mWidth; j++) {
+                uint c = (uint)ceil((at(i,j)-baseline)*scaleFactor);
+                out->setPixel(j, i, qRgb(c,c,c));
+            }
+        return out;
+    }
+};
+
+#endif // LEGACYMATRIX_H
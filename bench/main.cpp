@@ -0,0 +1,68 @@
+#include "bench.h"
+
+static int usage()
+{
+    fprintf(stderr, "Usage: CannyBench <suite> [options]\n"
+                    "Suites:\n"
+                    "  matrix [width height]   CMatrix storage: per-row arrays vs contiguous buffer\n"
+                    "  blur [width height]     Gaussian blur: direct 2-D kernel vs separable passes\n"
+                    "  threads [width height maxThreads sigma]\n"
+                    "                          canny() speedup at 1, 2, 4, ... threads\n"
+                    "  simd [length]           CSimd kernels: correctness against scalar, then speed\n"
+                    "  gradient [width height] Unfused gradient/atan2/binning vs the fused stage\n"
+                    "  hysteresis [width height]\n"
+                    "                          Queue-of-pairs BFS vs CEdgeTracker on sparse to dense textures\n"
+                    "  components [width height maxThreads]\n"
+                    "                          Union-find hysteresis at 1, 2, 4, ... threads vs the serial flood fill\n"
+                    "  precision [width height sigma]\n"
+                    "                          canny() in double, float and fixed point: edge map accuracy and time\n"
+                    "  image [width height]    QImage ingestion and export: pixel()/setPixel() vs scan lines\n"
+                    "  workspace [width height]\n"
+                    "                          Heap allocations per steady-state canny() frame (must be 0)\n"
+                    "  stream [frames sigma]   Frames per second at 1080p and 4K: reused CImage vs CFrameStream\n"
+                    "  thresholds [width height]\n"
+                    "                          Automatic hysteresis thresholds at several contrasts, and their cost\n"
+                    "  pyramid [width height]  cannyPyramid() vs canny() across sigmas: time, refined share, edges kept\n"
+                    "  outofcore [width height sigma]\n"
+                    "                          CStripCanny on a PPM file vs the in-memory pipeline: time, memory, identity\n"
+                    "  mapped [width height]   Codec decode vs mapped PPM, and mSuppressed saved and mapped back vs recomputed\n"
+                    "  cache [width height]    Reload, canny() and hysteresis with no cache, a miss and a hit; LRU eviction\n"
+                    "  regions [width height]  cannyRegions() vs canny() on the whole frame: time by area, identity inside\n"
+                    "  sparse [width height]   Edge runs, points and chains vs the dense edge image: time, size on disk\n"
+                    "  stencil [width height]  Prewitt, Sobel and Scharr gradients: fused stencils vs generic 3x3 filters\n"
+                    "  stages [--largest res] [--precision type] [--repeats n] [--save csv] [--baseline csv] [--tolerance pct] [images]\n"
+                    "                          Every stage, VGA to 8K, sigma 1-4, sparse and dense scenes: ns/pixel,\n"
+                    "                          GB/s; flags stages slower than a saved baseline\n"
+                    "  batch [tiles sigma]     CImageBatch vs a canny() call per tile, 64 to 256 pixels: images per second\n");
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2) return usage();
+
+    QString suite = argv[1];
+    if(suite == "matrix") return benchMatrix(argc - 2, argv + 2);
+    if(suite == "blur") return benchBlur(argc - 2, argv + 2);
+    if(suite == "threads") return benchThreads(argc - 2, argv + 2);
+    if(suite == "simd") return benchSimd(argc - 2, argv + 2);
+    if(suite == "gradient") return benchGradient(argc - 2, argv + 2);
+    if(suite == "hysteresis") return benchHysteresis(argc - 2, argv + 2);
+    if(suite == "components") return benchComponents(argc - 2, argv + 2);
+    if(suite == "precision") return benchPrecision(argc - 2, argv + 2);
+    if(suite == "image") return benchImage(argc - 2, argv + 2);
+    if(suite == "workspace") return benchWorkspace(argc - 2, argv + 2);
+    if(suite == "stream") return benchStream(argc - 2, argv + 2);
+    if(suite == "thresholds") return benchThresholds(argc - 2, argv + 2);
+    if(suite == "pyramid") return benchPyramid(argc - 2, argv + 2);
+    if(suite == "outofcore") return benchOutOfCore(argc - 2, argv + 2);
+    if(suite == "mapped") return benchMapped(argc - 2, argv + 2);
+    if(suite == "cache") return benchCache(argc - 2, argv + 2);
+    if(suite == "regions") return benchRegions(argc - 2, argv + 2);
+    if(suite == "sparse") return benchSparse(argc - 2, argv + 2);
+    if(suite == "stencil") return benchStencil(argc - 2, argv + 2);
+    if(suite == "stages") return benchStages(argc - 2, argv + 2);
+    if(suite == "batch") return benchBatch(argc - 2, argv + 2);
+
+    return usage();
+}
@@ -0,0 +1,107 @@
+#include "bench.h"
+#include "CImage.h"
+#include "CMappedFile.h"
+#include <QDir>
+
+/* Raw, mapped I/O against Qt's codecs. Ingestion: an image decoded from PNG and from PPM by
+ * QImage, against the same PPM mapped by CMappedFile, each up to the double matrix canny()
+ * starts from. Intermediates: mSuppressed written as a raw dump and mapped back, against
+ * computing it again, with the edges and the automatic thresholds of the mapped copy checked
+ * against the original. Output: the edge map encoded as PNG against the mapped PGM. Files are
+ * in the page cache, as they are when a batch reloads what it just wrote. */
+
+static bool sameMatrix(CMatD& a, CMatD& b)
+{
+    if(a.mHeight != b.mHeight || a.mWidth != b.mWidth) return false;
+    for(uint i = 0; i < a.mHeight; i++)
+        if(memcmp(a.row(i), b.row(i), a.mWidth * sizeof(double)) != 0) return false;
+    return true;
+}
+
+int benchMapped(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 3840;
+    uint h = argc > 1 ? atoi(argv[1]) : 2160;
+    double sigma = 2;
+    QDir temp(QDir::tempPath());
+    QString ppm = temp.filePath("canny_mapped.ppm"), png = temp.filePath("canny_mapped.png");
+    QString dump = temp.filePath("canny_mapped.cmat"), edgesPng = temp.filePath("canny_mapped_edges.png");
+    QString edgesPgm = temp.filePath("canny_mapped_edges.pgm");
+    if(!benchWriteScene(ppm, w, h)) {
+        fprintf(stderr, "Could not write %s\n", qPrintable(ppm));
+        return 1;
+    }
+    bool havePng = QImage(ppm).save(png);
+
+    printf("%u x %u, sigma %.1f\n", w, h, sigma);
+    printf("%-32s %10s %10s\n", "operation", "time", "identical");
+
+    // Ingestion, to the matrix
+    CMatD reference(h, w), m(h, w);
+    bool ok = true;
+    double tPpm = benchBest([&]() { QImage im(ppm); reference.fromImage(&im); }, 3);
+    printf("%-32s %7.2f ms %10s\n", "decode PPM (QImage) to matrix", tPpm * 1e3, "");
+    if(havePng) {
+        double tPng = benchBest([&]() { QImage im(png); m.fromImage(&im); }, 3);
+        bool identical = sameMatrix(reference, m);
+        ok = ok && identical;
+        printf("%-32s %7.2f ms %10s\n", "decode PNG (QImage) to matrix", tPng * 1e3, identical ? "yes" : "NO");
+    }
+    double tMap = benchBest([&]() {
+        CMappedFile file;
+        if(!file.mapNetpbm(ppm)) return;
+        QImage im = file.image();
+        m.fromImage(&im);
+    }, 3);
+    bool identical = sameMatrix(reference, m);
+    ok = ok && identical;
+    printf("%-32s %7.2f ms %10s\n", "map PPM to matrix", tMap * 1e3, identical ? "yes" : "NO");
+
+    // Intermediates
+    CImage image(ppm);
+    image.canny(sigma, true, true, true);
+    double tCanny = benchBest([&]() { image.canny(sigma, true, true, true); }, 3);
+    printf("%-32s %7.2f ms %10s\n", "canny() from the decoded image", tCanny * 1e3, "");
+    double tSave = benchBest([&]() { image.saveSuppressed(dump); }, 3);
+    printf("%-32s %7.2f ms %10s\n", "save mSuppressed (mapped dump)", tSave * 1e3, "");
+
+    CImage loaded(0, 0);
+    double tLoad = benchBest([&]() { loaded.loadSuppressed(dump); }, 3);
+    identical = loaded.mSuppressed != 0 && sameMatrix(*image.mSuppressed, *loaded.mSuppressed);
+    double low = 0, high = 0, loadedLow = 1, loadedHigh = 1;
+    image.autoThresholds(CMagnitudeHistogram::RulePercentile, low, high);
+    loaded.autoThresholds(CMagnitudeHistogram::RulePercentile, loadedLow, loadedHigh);
+    CMatrix<uchar> * edges = image.hysteresis(*image.mSuppressed, low, high);
+    if(identical) {
+        CMatrix<uchar> * loadedEdges = loaded.hysteresis(*loaded.mSuppressed, loadedLow, loadedHigh);
+        for(uint i = 0; i < h && identical; i++)
+            identical = memcmp(edges->row(i), loadedEdges->row(i), w) == 0;
+        delete loadedEdges;
+    }
+    identical = identical && low == loadedLow && high == loadedHigh;
+    ok = ok && identical;
+    printf("%-32s %7.2f ms %10s\n", "map mSuppressed back", tLoad * 1e3, identical ? "yes" : "NO");
+
+    // Output
+    if(havePng) {
+        double tEncode = benchBest([&]() { QImage * im = edges->toNewImage(); im->save(edgesPng); delete im; }, 3);
+        printf("%-32s %7.2f ms %10s\n", "edges to PNG (QImage)", tEncode * 1e3, "");
+    }
+    double tEdges = benchBest([&]() { CMappedFile::saveEdges(*edges, edgesPgm); }, 3);
+    CMappedFile written;
+    identical = written.mapNetpbm(edgesPgm) && written.mWidth == w && written.mHeight == h;
+    for(uint i = 0; i < h && identical; i++)
+        for(uint j = 0; j < w && identical; j++)
+            identical = (written.row(i)[j] != 0) == (edges->at(i,j) != 0);
+    written.close();
+    ok = ok && identical;
+    printf("%-32s %7.2f ms %10s\n", "edges to PGM (mapped)", tEdges * 1e3, identical ? "yes" : "NO");
+
+    delete edges;
+    QFile::remove(ppm);
+    QFile::remove(png);
+    QFile::remove(dump);
+    QFile::remove(edgesPng);
+    QFile::remove(edgesPgm);
+    return ok ? 0 : 1;
+}
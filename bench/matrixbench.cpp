@@ -0,0 +1,94 @@
+#include "bench.h"
+#include "legacymatrix.h"
+
+/* Times every CMatrix operation on the contiguous layout against the original
+ * per-row layout (CLegacyMatrix), on the same data. */
+
+static void report(const char * op, double legacy, double contiguous)
+{
+    printf("%-22s %10.3f ms %10.3f ms %8.2fx\n", op, legacy*1e3, contiguous*1e3, legacy/contiguous);
+}
+
+template<typename A, typename B> static bool sameContents(A& a, B& b)
+{
+    for(uint i = 0; i < a.mHeight; i++)
+        for(uint j = 0; j < a.mWidth; j++)
+            if(a.at(i,j) != b.at(i,j)) return false;
+    return true;
+}
+
+int benchMatrix(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 4000;
+    uint h = argc > 1 ? atoi(argv[1]) : 6000;
+
+    printf("CMatrix<double> %u x %u\n", w, h);
+    printf("%-22s %13s %13s %9s\n", "operation", "per-row", "contiguous", "speedup");
+
+    CMatD a(h, w), b(h, w);
+    benchFillRandom(a, 1);
+    benchFillRandom(b, 2);
+    CLegacyMatrix<double> la(h, w), lb(h, w);
+    benchFillRandom(la, 1);
+    benchFillRandom(lb, 2);
+
+    CMatD kernel3(3, 3), kernel7(7, 7);
+    CLegacyMatrix<double> lkernel3(3, 3), lkernel7(7, 7);
+    benchFillRandom(kernel3, 3);
+    benchFillRandom(lkernel3, 3);
+    benchFillRandom(kernel7, 4);
+    benchFillRandom(lkernel7, 4);
+
+    double tl, tc;
+    volatile double sink = 0;
+
+    tl = benchBest([&]() { CLegacyMatrix<double> m(h, w); m.at(h-1, w-1) = 0; sink = m.at(h-1, w-1); });
+    tc = benchBest([&]() { CMatD m(h, w); m.at(h-1, w-1) = 0; sink = m.at(h-1, w-1); });
+    report("allocate", tl, tc);
+
+    tl = benchBest([&]() { CLegacyMatrix<double> m(&la); sink = m.at(h/2, w/2); });
+    tc = benchBest([&]() { CMatD m(&a); sink = m.at(h/2, w/2); });
+    report("copy", tl, tc);
+
+    tl = benchBest([&]() { delete la.filterBy(lkernel3); }, 3);
+    tc = benchBest([&]() { delete a.filterBy(kernel3); }, 3);
+    report("filterBy 3x3", tl, tc);
+
+    tl = benchBest([&]() { delete la.filterBy(lkernel7); }, 1);
+    tc = benchBest([&]() { delete a.filterBy(kernel7); }, 1);
+    report("filterBy 7x7", tl, tc);
+
+    tl = benchBest([&]() { la.squareElementsInPlace(); });
+    tc = benchBest([&]() { a.squareElementsInPlace(); });
+    report("squareElementsInPlace", tl, tc);
+
+    tl = benchBest([&]() { la.squareRootElementsInPlace(); });
+    tc = benchBest([&]() { a.squareRootElementsInPlace(); });
+    report("squareRootElements", tl, tc);
+
+    tl = benchBest([&]() { la += lb; });
+    tc = benchBest([&]() { a += b; });
+    report("operator+=", tl, tc);
+
+    tl = benchBest([&]() { delete CLegacyMatrix<double>::atan2(la, lb); }, 3);
+    tc = benchBest([&]() { delete CMatD::atan2(a, b); }, 3);
+    report("atan2", tl, tc);
+
+    tl = benchBest([&]() { sink = la.sum(); });
+    tc = benchBest([&]() { sink = a.sum(); });
+    report("sum", tl, tc);
+
+    // RGB32 on both sides, then the default Grayscale8 export against the same legacy RGB32 writer
+    tl = benchBest([&]() { delete la.toNewImage(); }, 3);
+    tc = benchBest([&]() { delete a.toNewImage(true, QImage::Format_RGB32); }, 3);
+    report("toNewImage RGB32", tl, tc);
+
+    tc = benchBest([&]() { delete a.toNewImage(); }, 3);
+    report("toNewImage Grayscale8", tl, tc);
+
+    if(!sameContents(a, la)) {
+        printf("ERROR: layouts produced different results\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "bench.h"
+#include "CStripCanny.h"
+#include <QDir>
+
+/* Out-of-core strips against the in-memory pipeline. Writes a synthetic PPM, runs CStripCanny
+ * on it at a few strip heights (an odd one included, so halos straddle every kind of row), and
+ * compares each PGM edge map with CImage::canny() and hysteresis() on the same file. Reports
+ * time and memory: the strip window, the union-find tables and the run file, against the
+ * matrices the in-memory pipeline holds. */
+
+int benchOutOfCore(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 4000;
+    uint h = argc > 1 ? atoi(argv[1]) : 3000;
+    double sigma = argc > 2 ? atof(argv[2]) : 2;
+    const uint strips[] = { 17, 64, 256 };
+    QString input = QDir(QDir::tempPath()).filePath("canny_outofcore_in.ppm");
+    QString output = QDir(QDir::tempPath()).filePath("canny_outofcore_edges.pgm");
+    if(!benchWriteScene(input, w, h)) {
+        fprintf(stderr, "Could not write %s\n", qPrintable(input));
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    CImage image(input);
+    image.setThreadCount(1);
+    image.canny(sigma, true, true, true);
+    CMatrix<uchar> * reference = image.hysteresis(*image.mSuppressed, 0.007, 0.099);
+    double inMemory = timer.nsecsElapsed() / 1e9;
+    double inMemoryMB = (image.mWorkspace->mCapacity + image.mSuppressed->bytes() + image.mTracker->bytes() + reference->bytes()
+                         + (qint64)image.mOriginalImage->bytesPerLine() * h + (qint64)image.mImage->bytesPerLine() * h) / (1024. * 1024.);
+
+    printf("%u x %u PPM, sigma %.1f, 1 thread\n", w, h, sigma);
+    printf("%-12s %10s %10s %10s %10s %10s %10s\n", "mode", "time", "window", "tables", "run file", "edges", "identical");
+    quint64 referenceEdges = 0;
+    for(uint i = 0; i < h; i++)
+        for(uint j = 0; j < w; j++)
+            referenceEdges += reference->at(i,j);
+    printf("%-12s %7.0f ms %7.1f MB %10s %10s %10llu %10s\n", "in memory", inMemory * 1e3, inMemoryMB, "", "",
+           (unsigned long long)referenceEdges, "");
+
+    bool allIdentical = true;
+    for(uint s = 0; s < sizeof(strips) / sizeof(strips[0]); s++) {
+        CStripOptions options;
+        options.sigma = sigma;
+        options.stripRows = strips[s];
+        CStripCanny strip(options);
+        if(!strip.run(input, output)) {
+            fprintf(stderr, "%s\n", qPrintable(strip.mError));
+            return 1;
+        }
+
+        CNetpbmFile edges;
+        bool identical = edges.openRead(output) && edges.mWidth == w && edges.mHeight == h;
+        QVector<uchar> row(w);
+        for(uint i = 0; i < h && identical; i++) {
+            identical = edges.readRows(row.data(), 1);
+            for(uint j = 0; j < w && identical; j++)
+                identical = (row[j] != 0) == (reference->at(i,j) != 0);
+        }
+        allIdentical = allIdentical && identical;
+
+        printf("strips of %-3u %7.0f ms %7.1f MB %7.1f MB %7.1f MB %10llu %10s\n", strips[s], strip.mSeconds * 1e3,
+               strip.mWindowBytes / (1024. * 1024.), strip.mTableBytes / (1024. * 1024.), strip.mTempBytes / (1024. * 1024.),
+               (unsigned long long)strip.mEdgePixels, identical ? "yes" : "NO");
+    }
+    delete reference;
+    QFile::remove(input);
+    QFile::remove(output);
+    return allIdentical ? 0 : 1;
+}
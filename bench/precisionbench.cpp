@@ -0,0 +1,59 @@
+#include "bench.h"
+#include "CImage.h"
+
+/* Accuracy and speed of each CImage::Precision against the double reference: the largest
+ * difference in the suppressed gradient where both keep a pixel, and how many pixels of the
+ * thresholded edge map differ (edges lost and edges gained). */
+
+int benchPrecision(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    double sigma = argc > 2 ? atof(argv[2]) : 2;
+    const double low = 0.007, high = 0.099;
+    const CImage::Precision precisions[] = { CImage::PrecisionDouble, CImage::PrecisionFloat, CImage::PrecisionFixed };
+    const char * names[] = { "double", "float", "fixed" };
+
+    printf("CImage::canny precision, %u x %u, sigma %.1f, thresholds %.3f / %.3f, 1 thread\n", w, h, sigma, low, high);
+    printf("%-7s %12s %14s %9s %9s %9s\n", "type", "time", "max |diff|", "edges", "lost", "gained");
+
+    QImage source = benchScene(BenchShapes, w, h);
+
+    CMatD reference(h, w);
+    CMatrix<uchar> referenceEdges(h, w), edges(h, w);
+    CEdgeTracker tracker(h, w);
+    bool ok = true;
+    for(uint p = 0; p < 3; p++) {
+        CImage image(w, h);
+        image.setThreadCount(1);
+        double t = benchBest([&]() {
+            delete image.mImage;
+            image.mImage = new QImage(source);
+            image.canny(sigma, true, true, true, precisions[p]);
+        }, 3);
+
+        CMatD& suppressed = *image.mSuppressed;
+        tracker.track(suppressed, low, high, edges);
+        if(p == 0) {
+            reference = suppressed;
+            referenceEdges = edges;
+        }
+
+        double maxDiff = 0;
+        uint count = 0, lost = 0, gained = 0;
+        for(uint i = 0; i < h; i++)
+            for(uint j = 0; j < w; j++) {
+                if(suppressed.at(i,j) != 0 && reference.at(i,j) != 0)
+                    maxDiff = qMax(maxDiff, fabs(suppressed.at(i,j) - reference.at(i,j)));
+                count += edges.at(i,j);
+                if(referenceEdges.at(i,j) && !edges.at(i,j)) lost++;
+                if(!referenceEdges.at(i,j) && edges.at(i,j)) gained++;
+            }
+        // Reduced precision may move a few edge pixels, but not a sizeable share of them
+        if(lost + gained > count / 20) ok = false;
+
+        printf("%-7s %9.1f ms %14.3g %9u %8.2f%% %8.2f%%\n", names[p], t*1e3, maxDiff, count,
+               100. * lost / qMax(1u, count), 100. * gained / qMax(1u, count));
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include "bench.h"
+#include "CImage.h"
+
+/* Pyramid mode against canny() across sigmas, on a scene of a few shapes over a smooth,
+ * slightly noisy background. Reports the coarse level used, the share of the frame refined at
+ * full resolution, the speedup, and how many of the direct mode's hysteresis edges the pyramid
+ * keeps. Every refined pixel must equal the direct one; the others must be 0. The tiles along
+ * the frame border are always refined, since the zero padding makes an edge there, so the
+ * refined share drops with the resolution. */
+
+static quint64 countEdges(CMatrix<uchar>& edges, CMatrix<uchar> * within = 0)
+{
+    quint64 n = 0;
+    for(uint i = 0; i < edges.mHeight; i++)
+        for(uint j = 0; j < edges.mWidth; j++)
+            if(edges.at(i,j) && (within == 0 || within->at(i,j))) n++;
+    return n;
+}
+
+int benchPyramid(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    const double sigmas[] = { 2, 4, 8, 12, 16 };
+    bool allExact = true;
+
+    QImage scene = benchScene(BenchSparse, w, h);
+
+    printf("Pyramid mode vs canny(), %u x %u, 1 thread\n", w, h);
+    printf("%6s %6s %9s %11s %11s %9s %12s %6s\n", "sigma", "level", "refined", "direct", "pyramid", "speedup", "edges kept", "exact");
+    for(uint s = 0; s < sizeof(sigmas) / sizeof(sigmas[0]); s++) {
+        double sigma = sigmas[s];
+        CImage direct(scene), pyramid(scene);
+        direct.setThreadCount(1);
+        pyramid.setThreadCount(1);
+
+        double directTime = benchBest([&]() {
+            *direct.mImage = scene;
+            direct.canny(sigma, true, true, true);
+        }, 3);
+        double refined = 0;
+        double pyramidTime = benchBest([&]() {
+            *pyramid.mImage = scene;
+            refined = pyramid.cannyPyramid(sigma, true, true, true);
+        }, 3);
+
+        quint64 wrong = 0;
+        for(uint i = 0; i < h; i++)
+            for(uint j = 0; j < w; j++) {
+                double p = pyramid.mSuppressed->at(i,j);
+                if(p != 0 && p != direct.mSuppressed->at(i,j)) wrong++;
+            }
+        allExact = allExact && wrong == 0;
+
+        CMatrix<uchar> * directEdges = direct.hysteresis(*direct.mSuppressed, 0.007, 0.099);
+        CMatrix<uchar> * pyramidEdges = pyramid.hysteresis(*pyramid.mSuppressed, 0.007, 0.099);
+        quint64 total = countEdges(*directEdges), kept = countEdges(*directEdges, pyramidEdges);
+        printf("%6.1f %6u %8.1f%% %8.1f ms %8.1f ms %8.2fx %11.2f%% %6s\n", sigma, CImage::pyramidLevel(sigma), refined * 100,
+               directTime * 1e3, pyramidTime * 1e3, directTime / pyramidTime, total ? 100. * kept / total : 100.,
+               wrong == 0 ? "yes" : "NO");
+        delete directEdges;
+        delete pyramidEdges;
+    }
+    return allExact ? 0 : 1;
+}
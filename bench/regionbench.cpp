@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "CImage.h"
+
+/* cannyRegions() against canny() on the whole frame, for sets of rectangles from a few small
+ * ones to the frame itself, in each precision. Inside the rectangles mSuppressed must equal the
+ * full frame's bit for bit, outside it must be 0, and the histogram must be that of the full
+ * frame's candidates under the union of the rectangles. Includes rectangles that overlap and
+ * ones that run off the frame. */
+
+int benchRegions(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    double sigma = 2;
+    bool ok = true;
+
+    QImage scene = benchScene(BenchShapes, w, h);
+
+    struct Case { const char * mName; QVector<QRect> mRects; };
+    QVector<Case> cases(4);
+    cases[0].mName = "4 small";
+    cases[0].mRects << QRect(0, 0, w/10, h/10) << QRect(w/3, h/4, w/12, h/8) << QRect(w/2, h/2, w/10, h/10)
+                    << QRect(w - w/12, h - h/9, w/6, h/6);
+    cases[1].mName = "1 medium";
+    cases[1].mRects << QRect(w/4, h/4, w/3, h/3);
+    cases[2].mName = "2 overlapping";
+    cases[2].mRects << QRect(w/8, h/8, w/2, h/2) << QRect(w/4, h/3, w/2, h/2);
+    cases[3].mName = "whole frame";
+    cases[3].mRects << QRect(0, 0, w, h);
+
+    const char * precisions[] = { "double", "float", "fixed" };
+    printf("cannyRegions() vs canny(), %u x %u, sigma %.1f\n", w, h, sigma);
+    printf("%-14s %-7s %7s %11s %11s %9s %7s %10s\n", "rectangles", "type", "area", "full", "regions", "speedup", "exact", "histogram");
+    for(int c = 0; c < cases.size(); c++) {
+        // The union, as a mask
+        CMatrix<uchar> mask(h, w);
+        for(uint i = 0; i < h; i++)
+            memset(mask.row(i), 0, w);
+        quint64 area = 0;
+        for(int k = 0; k < cases[c].mRects.size(); k++) {
+            QRect r = cases[c].mRects[k].intersected(QRect(0, 0, w, h));
+            for(int i = r.top(); i <= r.bottom(); i++)
+                memset(mask.row(i) + r.left(), 1, r.width());
+        }
+        for(uint i = 0; i < h; i++)
+            for(uint j = 0; j < w; j++)
+                area += mask.at(i,j);
+
+        for(int p = 0; p < 3; p++) {
+            CImage::Precision precision = (CImage::Precision)p;
+            CImage full(scene), regions(scene);
+            double fullTime = benchBest([&]() {
+                *full.mImage = scene;
+                full.canny(sigma, true, true, true, precision);
+            }, 3);
+            double regionTime = benchBest([&]() {
+                regions.cannyRegions(cases[c].mRects, sigma, true, true, true, precision);
+            }, 3);
+
+            quint64 wrong = 0;
+            QVector<uint> bins(CHISTOGRAM_BINS, 0);
+            for(uint i = 0; i < h; i++)
+                for(uint j = 0; j < w; j++) {
+                    double expected = mask.at(i,j) ? full.mSuppressed->at(i,j) : 0;
+                    if(regions.mSuppressed->at(i,j) != expected) wrong++;
+                    if(mask.at(i,j)) CMagnitudeHistogram::count(&expected, 1, bins.data());
+                }
+            bool histogram = true;
+            for(uint b = 0; b < CHISTOGRAM_BINS; b++)
+                histogram = histogram && regions.mHistogram->mBins[b] == bins[b];
+            ok = ok && wrong == 0 && histogram;
+
+            printf("%-14s %-7s %6.1f%% %8.1f ms %8.1f ms %8.2fx %7s %10s\n", p == 0 ? cases[c].mName : "", precisions[p],
+                   100. * area / ((double)w * h), fullTime * 1e3, regionTime * 1e3, fullTime / regionTime,
+                   wrong == 0 ? "yes" : "NO", histogram ? "same" : "DIFFERS");
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "CNetpbm.h"
+
+// Reproducible noise in [-amplitude, amplitude] at (x, y), hashed rather than drawn in sequence
+static int noise(uint x, uint y, uint seed, int amplitude)
+{
+    quint32 k = x * 73856093u ^ y * 19349663u ^ seed * 83492791u;
+    k = (k ^ (k >> 16)) * 2246822507u;
+    k = (k ^ (k >> 13)) * 3266489909u;
+    k ^= k >> 16;
+    return (int)(k % (2 * amplitude + 1)) - amplitude;
+}
+
+uchar benchSceneLevel(BenchScene scene, uint x, uint y, uint w, uint h, int contrast, uint frame)
+{
+    int v = 0;
+    switch(scene) {
+    case BenchSparse: {
+        int r = h / 8;
+        v = 60 + 100 * x / w + noise(x, y, 7, 2);
+        for(int d = 0; d < 5; d++) {
+            int cx = w * (2*d + 1) / 10, cy = h * (d % 2 ? 1 : 3) / 4;
+            if(((int)x - cx) * ((int)x - cx) + ((int)y - cy) * ((int)y - cy) < r * r) v += 70;
+        }
+        break;
+    }
+    case BenchShapes: {
+        v = 40 + 120 * x / qMax(1u, w - 1);
+        int cx = x % 160 - 80, cy = y % 120 - 60;
+        if(cx*cx + cy*cy < 45*45) v = 255 - v;
+        v += noise(x, y, 11, 4);
+        break;
+    }
+    case BenchDense: {
+        uint cell = (x / 5) * 2654435761u ^ (y / 5) * 40503u;
+        v = 40 + (cell >> 7) % 176 + noise(x, y, 5, 2);
+        break;
+    }
+    case BenchBlocks:
+        v = 128 + ((((x + 3*frame) / 41 + (y + 2*frame) / 29) % 2) ? contrast : -contrast) / 2 + noise(x, y, 17 + frame, 12);
+        break;
+    case BenchLines:
+        v = 90 + ((x/211 + y/157) % 3) * 50 + ((x - y/3) % 389 < 7 ? 60 : 0) + noise(x, y, 13, 5);
+        break;
+    }
+    return (uchar)qBound(0, v, 255);
+}
+
+QImage benchScene(BenchScene scene, uint w, uint h, int contrast, uint frame)
+{
+    QImage im(w, h, QImage::Format_RGB32);
+    for(uint y = 0; y < h; y++) {
+        QRgb * line = (QRgb*)im.scanLine(y);
+        for(uint x = 0; x < w; x++) {
+            int v = benchSceneLevel(scene, x, y, w, h, contrast, frame);
+            line[x] = qRgb(v, v, v);
+        }
+    }
+    return im;
+}
+
+bool benchWriteScene(const QString& path, uint w, uint h, BenchScene scene)
+{
+    CNetpbmFile file;
+    if(!file.openWrite(path, w, h, 3)) return false;
+    QVector<uchar> row(3 * w);
+    for(uint y = 0; y < h; y++) {
+        for(uint x = 0; x < w; x++)
+            row[3*x] = row[3*x+1] = row[3*x+2] = benchSceneLevel(scene, x, y, w, h);
+        if(!file.writeRows(row.constData(), 1)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,142 @@
+#include "bench.h"
+
+/* Every CSimd kernel at every level the CPU supports, checked bit for bit against the scalar
+ * reference on odd lengths and unaligned offsets, then timed. Exits non-zero on a mismatch. */
+
+static const uint kLengths[] = { 0, 1, 2, 3, 5, 7, 8, 9, 31, 64, 1001 };
+
+static void fillRandom(double * p, uint n, bool signedValues)
+{
+    for(uint i = 0; i < n; i++) {
+        double v = rand() / (RAND_MAX + 1.);
+        p[i] = signedValues ? (v - 0.5) * 8 : v;
+    }
+}
+
+// Runs kernel(level) and reference() on identical copies of the inputs and compares the outputs
+template<typename K, typename R> static bool checkKernel(const char * name, K kernel, R reference)
+{
+    bool ok = true;
+    for(uint l = 0; l < sizeof(kLengths)/sizeof(kLengths[0]); l++)
+        for(uint offset = 0; offset < 3; offset++) {
+            uint n = kLengths[l];
+            QVector<double> in(n + 8), outA(n + 8), outB(n + 8);
+            fillRandom(in.data(), n + 8, true);
+            fillRandom(outA.data(), n + 8, true);
+            outB = outA;
+            QVector<int> binsA(n + 8, -1), binsB(n + 8, -1);
+            kernel(outA.data() + offset, in.data() + offset, binsA.data() + offset, n);
+            reference(outB.data() + offset, in.data() + offset, binsB.data() + offset, n);
+            if(memcmp(outA.data(), outB.data(), outA.size() * sizeof(double)) != 0 ||
+                    memcmp(binsA.data(), binsB.data(), binsA.size() * sizeof(int)) != 0)
+                ok = false;
+        }
+    printf("  %-12s %s\n", name, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+// Integer mulAdd kernels: exact arithmetic, so the level must match the scalar loop bit for bit
+template<typename O, typename I> static bool checkIntegerMulAdd(const char * name, O k, int maxIn)
+{
+    bool ok = true;
+    for(uint l = 0; l < sizeof(kLengths)/sizeof(kLengths[0]); l++)
+        for(uint offset = 0; offset < 3; offset++) {
+            uint n = kLengths[l];
+            QVector<I> in(n + 8);
+            QVector<O> outA(n + 8), outB(n + 8);
+            for(uint j = 0; j < n + 8; j++) {
+                in[j] = rand() % (maxIn + 1);
+                outA[j] = outB[j] = rand() % 1000;
+            }
+            CSimd::mulAdd(outA.data() + offset, in.data() + offset, k, n);
+            CSimd::mulAddScalar(outB.data() + offset, in.data() + offset, k, n);
+            if(memcmp(outA.data(), outB.data(), outA.size() * sizeof(O)) != 0)
+                ok = false;
+        }
+    printf("  %-12s %s\n", name, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+int benchSimd(int argc, char ** argv)
+{
+    uint n = argc > 0 ? atoi(argv[0]) : 1 << 20;
+    bool ok = true;
+
+    QVector<double> a(n), b(n);
+    QVector<int> bins(n);
+    fillRandom(a.data(), n, true);
+    fillRandom(b.data(), n, true);
+
+    CSimd::Level best = CSimd::supportedLevel();
+    for(int l = CSimd::Scalar; l <= best; l++) {
+        CSimd::setLevel((CSimd::Level)l);
+        printf("%s\n", CSimd::levelName((CSimd::Level)l));
+
+        ok &= checkKernel("mulAdd",
+                [](double * o, const double * i, int *, uint n) { CSimd::mulAdd(o, i, 0.3712, n); },
+                [](double * o, const double * i, int *, uint n) { CSimd::mulAddScalar(o, i, 0.3712, n); });
+        ok &= checkKernel("add",
+                [](double * o, const double * i, int *, uint n) { CSimd::add(o, i, n); },
+                [](double * o, const double * i, int *, uint n) { CSimd::addScalar(o, i, n); });
+        ok &= checkKernel("square",
+                [](double * o, const double *, int *, uint n) { CSimd::square(o, n); },
+                [](double * o, const double *, int *, uint n) { CSimd::squareScalar(o, n); });
+        ok &= checkKernel("squareRoot",
+                [](double * o, const double *, int *, uint n) { for(uint j = 0; j < n; j++) o[j] = fabs(o[j]); CSimd::squareRoot(o, n); },
+                [](double * o, const double *, int *, uint n) { for(uint j = 0; j < n; j++) o[j] = fabs(o[j]); CSimd::squareRootScalar(o, n); });
+        ok &= checkKernel("binAngles",
+                [](double *, const double * i, int * b, uint n) { CSimd::binAngles(b, i, n); },
+                [](double *, const double * i, int * b, uint n) { CSimd::binAnglesScalar(b, i, n); });
+        ok &= checkIntegerMulAdd<ushort, uchar>("mulAdd u8", 37, 255);
+        ok &= checkIntegerMulAdd<int, ushort>("mulAdd u16", 37, 65535);
+
+        double t;
+        t = benchBest([&]() { CSimd::mulAdd(a.data(), b.data(), 1e-9, n); }, 10);
+        printf("  %-12s %8.3f ns/element\n", "mulAdd", t * 1e9 / n);
+        t = benchBest([&]() { CSimd::add(a.data(), b.data(), n); }, 10);
+        printf("  %-12s %8.3f ns/element\n", "add", t * 1e9 / n);
+        t = benchBest([&]() { CSimd::square(a.data(), n); }, 10);
+        printf("  %-12s %8.3f ns/element\n", "square", t * 1e9 / n);
+        for(uint j = 0; j < n; j++) a[j] = fabs(a[j]);
+        t = benchBest([&]() { CSimd::squareRoot(a.data(), n); }, 10);
+        printf("  %-12s %8.3f ns/element\n", "squareRoot", t * 1e9 / n);
+        fillRandom(a.data(), n, true);
+        t = benchBest([&]() { CSimd::binAngles(bins.data(), a.data(), n); }, 10);
+        printf("  %-12s %8.3f ns/element\n", "binAngles", t * 1e9 / n);
+    }
+
+    // Whole filters: the dispatched level against the scalar one
+    CMatD image(257, 333), kernel(5, 7), line(1, 9);
+    benchFillRandom(image);
+    benchFillRandom(kernel, 2);
+    benchFillRandom(line, 3);
+    CSimd::setLevel(CSimd::Scalar);
+    CMatD * directRef = image.filterByDirect(kernel), * separableRef = image.filterBySeparable(line, line);
+    CSimd::setLevel(best);
+    CMatD * direct = image.filterByDirect(kernel), * separable = image.filterBySeparable(line, line);
+    bool filtersOk = true;
+    for(uint i = 0; i < image.mHeight; i++)
+        filtersOk &= memcmp(direct->row(i), directRef->row(i), image.mWidth * sizeof(double)) == 0 &&
+                     memcmp(separable->row(i), separableRef->row(i), image.mWidth * sizeof(double)) == 0;
+    printf("filters at %s vs scalar: %s\n", CSimd::levelName(best), filtersOk ? "ok" : "MISMATCH");
+    delete directRef;
+    delete separableRef;
+    delete direct;
+    delete separable;
+
+    // The float kernels only run inside filters, so they are checked the same way
+    CMatrix<float> imageF(257, 333), lineF(1, 9);
+    benchFillRandom(imageF);
+    benchFillRandom(lineF, 3);
+    CSimd::setLevel(CSimd::Scalar);
+    CMatrix<float> * separableRefF = imageF.filterBySeparable(lineF, lineF);
+    CSimd::setLevel(best);
+    CMatrix<float> * separableF = imageF.filterBySeparable(lineF, lineF);
+    for(uint i = 0; i < imageF.mHeight; i++)
+        filtersOk &= memcmp(separableF->row(i), separableRefF->row(i), imageF.mWidth * sizeof(float)) == 0;
+    printf("float filters at %s vs scalar: %s\n", CSimd::levelName(best), filtersOk ? "ok" : "MISMATCH");
+    delete separableRefF;
+    delete separableF;
+
+    return ok && filtersOk ? 0 : 1;
+}
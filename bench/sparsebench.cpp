@@ -0,0 +1,97 @@
+#include "bench.h"
+#include "CImage.h"
+#include "CSparseEdges.h"
+#include <QDir>
+#include <QFileInfo>
+
+/* Sparse edge output against the dense edge image, from sparse to dense edge maps (by the
+ * thresholds). Times hysteresis followed by the RGB32 export the GUI does, and each sparse form
+ * on its own; sizes the serialized chains, with and without directions, then deflated with
+ * directions as save() writes them, against the dense formats: 8-bit raster, and the JPEG and
+ * PNG that QImage writes for the GUI's "Save". Checks that a saved file loads back to the same
+ * edge pixels and directions. */
+
+int benchSparse(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    double sigma = 2;
+    QDir temp(QDir::tempPath());
+    QString input = temp.filePath("canny_sparse_in.ppm");
+    if(!benchWriteScene(input, w, h)) {
+        fprintf(stderr, "Could not write %s\n", qPrintable(input));
+        return 1;
+    }
+
+    CImage image(input);
+    image.mKeepDirection = true;
+    image.canny(sigma, true, true, true);
+    bool ok = true;
+
+    const double thresholds[][2] = { { 0.04, 0.12 }, { 0.02, 0.08 }, { 0.007, 0.04 } };
+    printf("%u x %u, sigma %.1f\n", w, h, sigma);
+    printf("%-13s %7s %8s %8s | %9s %8s %8s %8s %8s | %9s %9s %9s %9s %9s %9s %9s %6s\n", "thresholds", "edges", "chains", "points",
+           "dense", "runs", "points", "chains", "sparse", "raster", "jpeg", "png", "chains", "+dirs", "deflated", "jpeg/file", "same");
+    for(uint t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++) {
+        double low = thresholds[t][0], high = thresholds[t][1];
+        CMatrix<uchar> * edges = image.hysteresis(*image.mSuppressed, low, high);
+
+        // What useHysteresis() and the GUI's save start from
+        double denseTime = benchBest([&]() {
+            CMatrix<uchar> * traced = image.hysteresis(*image.mSuppressed, low, high);
+            QImage * rgb = traced->toNewImage(true, QImage::Format_RGB32);
+            delete rgb;
+            delete traced;
+        }, 3);
+
+        CSparseEdges sparse;
+        double runsTime = benchBest([&]() { sparse.extractRuns(*edges); }, 3);
+        double pointsTime = benchBest([&]() { sparse.extractPoints(image.mDirection); }, 3);
+        double chainsTime = benchBest([&]() { sparse.extractChains(*edges, image.mDirection); }, 3);
+        double sparseTime = benchBest([&]() { image.sparseHysteresis(low, high, sparse); }, 3);
+
+        // Sizes on disk
+        QImage * picture = edges->toNewImage(true, QImage::Format_RGB32);
+        QString jpg = temp.filePath("canny_sparse.jpg"), png = temp.filePath("canny_sparse.png"), raw = temp.filePath("canny_sparse.edges");
+        qint64 jpgBytes = picture->save(jpg, "JPG") ? QFileInfo(jpg).size() : -1;
+        qint64 pngBytes = picture->save(png, "PNG") ? QFileInfo(png).size() : -1;
+        delete picture;
+        qint64 deflated = sparse.serialize().size();
+        sparse.mDeflate = false;
+        qint64 withDirections = sparse.serialize().size();
+        sparse.mDirections = false;
+        qint64 chainBytes = sparse.serialize().size();
+        sparse.mDirections = true;
+        sparse.mDeflate = true;
+
+        // Round trip
+        bool same = sparse.save(raw);
+        CSparseEdges loaded;
+        same = same && loaded.load(raw) && loaded.mChainPoints.size() == sparse.mChainPoints.size();
+        if(same) {
+            CMatrix<uchar> back(h, w);
+            loaded.toMask(back);
+            for(uint i = 0; i < h && same; i++)
+                for(uint j = 0; j < w && same; j++)
+                    same = (back.at(i,j) != 0) == (edges->at(i,j) != 0);
+            for(int k = 0; k < loaded.mChainPoints.size() && same; k++)
+                same = loaded.mChainPoints[k].mDirection == image.mDirection->at(loaded.mChainPoints[k].mY, loaded.mChainPoints[k].mX);
+        }
+        ok = ok && same;
+
+        char label[32];
+        snprintf(label, sizeof(label), "%.3f-%.3f", low, high);
+        printf("%-13s %6.2f%% %8u %8d | %6.1f ms %5.1f ms %5.1f ms %5.1f ms %5.1f ms | %7.1f K %7.1f K %7.1f K %7.1f K %7.1f K %7.1f K %8.1fx %6s\n",
+               label, 100. * sparse.mChainPoints.size() / ((double)w * h), sparse.chains(), sparse.mChainPoints.size(),
+               denseTime * 1e3, runsTime * 1e3, pointsTime * 1e3, chainsTime * 1e3, sparseTime * 1e3,
+               (double)w * h / 1024, jpgBytes / 1024., pngBytes / 1024., chainBytes / 1024., withDirections / 1024.,
+               deflated / 1024., (double)jpgBytes / deflated, same ? "yes" : "NO");
+        QFile::remove(jpg);
+        QFile::remove(png);
+        QFile::remove(raw);
+        delete edges;
+    }
+    printf("sparse = hysteresis and all three forms; dense = hysteresis and the RGB32 edge image\n");
+    QFile::remove(input);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+#include "bench.h"
+#include "CImage.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+/* Every pipeline stage across resolutions from VGA to 8K, several sigmas, an edge-sparse and an
+ * edge-dense synthetic scene, and any image files given. Each case runs canny() and
+ * hysteresis() under a CProfiler a few times and keeps every stage's fastest run, then times
+ * toNewImage() on the edge map. Reports ns per pixel, and the bandwidth of each stage's
+ * compulsory traffic: its inputs read and its outputs written once (see stageBytes()).
+ *
+ * --save writes the results as CSV. --baseline reads such a file and flags every stage of a
+ * case that is slower than it was by more than --tolerance percent (default 15) and by more
+ * than 0.05 ns per pixel, so that the smallest stages do not flag timer noise; then returns 1.
+ * Cases are named scene/resolution/sigma, so a quick run compares against part of a full one. */
+
+struct CStageResult
+{
+    QString mCase, mStage;
+    double mNsPerPixel, mGBPerSecond;
+};
+
+struct CResolution
+{
+    const char * mName;
+    uint mWidth, mHeight;
+};
+
+static const CResolution sResolutions[] = {
+    { "vga", 640, 480 }, { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4k", 3840, 2160 }, { "8k", 7680, 4320 }
+};
+static const char * sStages[] = { "ingest", "blur", "gradient", "suppression", "export", "hysteresis", "toNewImage" };
+static const int sStageCount = sizeof(sStages) / sizeof(sStages[0]);
+
+// Bytes per pixel each stage must read and write at least, for input and working types of these sizes
+static double stageBytes(const QString& stage, int in, int t)
+{
+    if(stage == "ingest") return 4 + in;                    // RGB32 scan lines into the input matrix
+    if(stage == "blur") return in + 3 * t;                  // Row pass into scratch, column pass out of it
+    if(stage == "gradient") return t + t + 1;               // Magnitude and direction bin
+    if(stage == "suppression") return t + 1 + 8;            // Into mSuppressed
+    if(stage == "export") return in + 4;                    // The input matrix back into mImage
+    if(stage == "hysteresis") return 8 + 1;
+    if(stage == "toNewImage") return 1 + 4;                 // Edge map to RGB32
+    return 0;
+}
+
+static bool saveResults(const QString& path, const QVector<CStageResult>& results, const char * precision, uint threads)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+    QByteArray out = QString("# CannyBench stages, %1, %2 threads\ncase,stage,ns_per_pixel,gb_per_second\n")
+            .arg(precision).arg(threads).toUtf8();
+    for(int k = 0; k < results.size(); k++)
+        out += QString("%1,%2,%3,%4\n").arg(results[k].mCase).arg(results[k].mStage)
+                .arg(results[k].mNsPerPixel, 0, 'g', 6).arg(results[k].mGBPerSecond, 0, 'g', 6).toUtf8();
+    return file.write(out) == out.size();
+}
+
+// ns per pixel by "case,stage"
+static bool loadBaseline(const QString& path, QHash<QString, double>& baseline)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) return false;
+    while(!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if(line.isEmpty() || line.startsWith("#") || line.startsWith("case,")) continue;
+        QStringList fields = line.split(',');
+        if(fields.size() < 3) continue;
+        baseline[fields[0] + "," + fields[1]] = fields[2].toDouble();
+    }
+    return true;
+}
+
+// Runs one case and appends a result per stage
+static void runCase(const QString& name, CImage& image, const QImage& scene, double sigma, CImage::Precision precision,
+                    int repeats, QVector<CStageResult>& results)
+{
+    const int inSizes[] = { 8, 4, 1 }, tSizes[] = { 8, 4, 2 };
+    int in = inSizes[precision], t = tSizes[precision];
+    qint64 pixels = (qint64)scene.width() * scene.height();
+    const double low = 0.007, high = 0.099;
+
+    CProfiler profiler;
+    image.mProfiler = &profiler;
+    CMatrix<uchar> * edges = 0;
+    for(int r = 0; r < repeats; r++) {
+        *image.mImage = scene;              // canny() exports into it
+        image.canny(sigma, true, true, true, precision);
+        delete edges;
+        edges = image.hysteresis(*image.mSuppressed, low, high);
+    }
+    image.mProfiler = 0;
+    double toImage = benchBest([&]() { delete edges->toNewImage(true, QImage::Format_RGB32); }, repeats);
+
+    quint64 edgePixels = 0;
+    for(uint i = 0; i < edges->mHeight; i++)
+        for(uint j = 0; j < edges->mWidth; j++)
+            edgePixels += edges->at(i,j) != 0;
+    delete edges;
+
+    QVector<CStageStats> stages = profiler.stages();
+    double ns[sStageCount], totalNs = 0, totalBytes = 0;
+    for(int s = 0; s < sStageCount; s++) {
+        ns[s] = 0;
+        for(int k = 0; k < stages.size(); k++)
+            if(stages[k].mStage == sStages[s]) ns[s] = stages[k].mMinNs;
+        if(s == sStageCount - 1) ns[s] = toImage * 1e9;
+        CStageResult result;
+        result.mCase = name;
+        result.mStage = sStages[s];
+        result.mNsPerPixel = ns[s] / pixels;
+        result.mGBPerSecond = ns[s] > 0 ? stageBytes(sStages[s], in, t) * pixels / ns[s] : 0;
+        results.append(result);
+        totalNs += ns[s];
+        totalBytes += stageBytes(sStages[s], in, t) * pixels;
+    }
+
+    printf("%-24s %6.2f%% %-6s", qPrintable(name), 100. * edgePixels / pixels, "ns/px");
+    for(int s = 0; s < sStageCount; s++)
+        printf(" %11.2f", ns[s] / pixels);
+    printf(" %9.2f\n", totalNs / pixels);
+    printf("%-24s %7s %-6s", "", "", "GB/s");
+    for(int s = 0; s < sStageCount; s++)
+        printf(" %11.2f", results[results.size() - sStageCount + s].mGBPerSecond);
+    printf(" %9.2f\n", totalBytes / totalNs);
+}
+
+int benchStages(int argc, char ** argv)
+{
+    QString savePath, baselinePath;
+    double tolerance = 15;
+    int repeats = 5;
+    uint largest = sizeof(sResolutions) / sizeof(sResolutions[0]);
+    CImage::Precision precision = CImage::PrecisionDouble;
+    const char * precisionNames[] = { "double", "float", "fixed" };
+    QStringList files;
+    for(int a = 0; a < argc; a++) {
+        QString arg = argv[a];
+        bool value = a + 1 < argc;
+        if(arg == "--save" && value) savePath = argv[++a];
+        else if(arg == "--baseline" && value) baselinePath = argv[++a];
+        else if(arg == "--tolerance" && value) tolerance = atof(argv[++a]);
+        else if(arg == "--repeats" && value) repeats = qMax(1, atoi(argv[++a]));
+        else if(arg == "--largest" && value) {
+            QString name = QString(argv[++a]).toLower();
+            largest = 0;
+            while(largest < sizeof(sResolutions) / sizeof(sResolutions[0]) && name != sResolutions[largest].mName) largest++;
+            if(largest == sizeof(sResolutions) / sizeof(sResolutions[0])) {
+                fprintf(stderr, "Unknown resolution '%s': vga, 720p, 1080p, 4k or 8k\n", qPrintable(name));
+                return 2;
+            }
+            largest++;
+        } else if(arg == "--precision" && value) {
+            QString name = QString(argv[++a]).toLower();
+            int p = 0;
+            while(p < 3 && name != precisionNames[p]) p++;
+            if(p == 3) {
+                fprintf(stderr, "Unknown precision '%s'\n", qPrintable(name));
+                return 2;
+            }
+            precision = (CImage::Precision)p;
+        } else if(arg.startsWith("--")) {
+            fprintf(stderr, "Unknown option %s\n", argv[a]);
+            return 2;
+        } else files.append(arg);
+    }
+
+    QHash<QString, double> baseline;
+    if(!baselinePath.isEmpty() && !loadBaseline(baselinePath, baseline)) {
+        fprintf(stderr, "Could not read %s\n", qPrintable(baselinePath));
+        return 2;
+    }
+
+    const double sigmas[] = { 1, 2, 4 };
+    QVector<CStageResult> results;
+    CImage probe(1, 1);
+    printf("Pipeline stages, %s, %u threads, fastest of %d runs\n", precisionNames[precision], probe.threadCount(), repeats);
+    printf("%-24s %7s %-6s", "case", "edges", "");
+    for(int s = 0; s < sStageCount; s++)
+        printf(" %11s", sStages[s]);
+    printf(" %9s\n", "total");
+
+    for(uint r = 0; r < largest; r++) {
+        const CResolution& resolution = sResolutions[r];
+        for(int dense = 0; dense < 2; dense++) {
+            QImage scene = benchScene(dense ? BenchDense : BenchSparse, resolution.mWidth, resolution.mHeight);
+            CImage image(scene);
+            for(uint s = 0; s < sizeof(sigmas) / sizeof(sigmas[0]); s++)
+                runCase(QString("%1/%2/%3").arg(dense ? "dense" : "sparse").arg(resolution.mName).arg(sigmas[s]),
+                        image, scene, sigmas[s], precision, repeats, results);
+        }
+    }
+    for(int f = 0; f < files.size(); f++) {
+        QImage picture(files[f]);
+        if(picture.isNull()) {
+            fprintf(stderr, "Could not load %s\n", qPrintable(files[f]));
+            return 2;
+        }
+        picture = picture.convertToFormat(QImage::Format_RGB32);
+        CImage image(picture);
+        for(uint s = 0; s < sizeof(sigmas) / sizeof(sigmas[0]); s++)
+            runCase(QString("%1/%2").arg(QFileInfo(files[f]).fileName()).arg(sigmas[s]), image, picture, sigmas[s],
+                    precision, repeats, results);
+    }
+
+    if(!savePath.isEmpty()) {
+        if(!saveResults(savePath, results, precisionNames[precision], probe.threadCount())) {
+            fprintf(stderr, "Could not write %s\n", qPrintable(savePath));
+            return 2;
+        }
+        printf("Saved %d results to %s\n", results.size(), qPrintable(savePath));
+    }
+
+    if(baselinePath.isEmpty()) return 0;
+    int compared = 0, regressions = 0, faster = 0;
+    for(int k = 0; k < results.size(); k++) {
+        QString key = results[k].mCase + "," + results[k].mStage;
+        if(!baseline.contains(key)) continue;
+        double before = baseline[key], now = results[k].mNsPerPixel;
+        compared++;
+        if(now > before * (1 + tolerance / 100) && now - before > 0.05) {
+            if(regressions == 0) printf("\nRegressions against %s:\n", qPrintable(baselinePath));
+            printf("  %-24s %-12s %8.2f -> %8.2f ns/px (%+.0f%%)\n", qPrintable(results[k].mCase), qPrintable(results[k].mStage),
+                   before, now, 100 * (now / before - 1));
+            regressions++;
+        } else if(now < before * (1 - tolerance / 100)) faster++;
+    }
+    printf("\n%d of %d stage results slower than the baseline by more than %.0f%%, %d faster\n", regressions, compared,
+           tolerance, faster);
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+#include "bench.h"
+#include "CImage.h"
+#include "CSimd.h"
+
+/* Compile-time stencils: CImage::gradient<S> for Prewitt, Sobel and Scharr against the generic
+ * path, two 3x3 filters with every tap multiplied in (zeros and ones included), then the
+ * magnitude on Prewitt's scale and atan2 binning. Magnitudes must agree to rounding and
+ * directions up to bin-edge ties. The fixed-point stencils must match double to rounding on
+ * full-range steps, where their sums are largest. Then canny() time by operator and precision. */
+
+template<int Side, int Centre> static void stencilKernels(CStencil<Side, Centre>, CMatD& kx, CMatD& ky)
+{
+    const double smooth[3] = { Side, Centre, Side };
+    for(uint i = 0; i < 3; i++) {
+        kx[i][0] = -smooth[i];
+        kx[i][1] = 0;
+        kx[i][2] = +smooth[i];
+        ky[0][i] = -smooth[i];
+        ky[1][i] = 0;
+        ky[2][i] = +smooth[i];
+    }
+}
+
+template<typename S> static bool compareStencil(const char * name, CImage& image, CMatD& blurred)
+{
+    uint h = blurred.mHeight, w = blurred.mWidth;
+    CMatD kx(3, 3), ky(3, 3), gx(h, w), gy(h, w), reference(h, w);
+    stencilKernels(S(), kx, ky);
+    CMatrix<int> bins(h, w);
+    double tg = benchBest([&]() {
+        blurred.filterByDirect(gx, kx, 0, h);
+        blurred.filterByDirect(gy, ky, 0, h);
+        for(uint i = 0; i < h; i++)
+            for(uint j = 0; j < w; j++)
+                reference[i][j] = sqrt(gx[i][j] * gx[i][j] + gy[i][j] * gy[i][j]) * S::scale();
+        CMatD * theta = CMatD::atan2(gy, gx);
+        for(uint i = 0; i < h; i++)
+            CSimd::binAngles(bins.row(i), theta->row(i), w);
+        delete theta;
+    }, 3);
+
+    CMatD magnitude(h, w);
+    CMatrix<uchar> direction(h, w);
+    double tf = benchBest([&]() { image.gradient<S>(blurred, magnitude, direction, 0, h); }, 3);
+
+    double worst = 0;
+    quint64 directionDiffs = 0;
+    for(uint i = 0; i < h; i++)
+        for(uint j = 0; j < w; j++) {
+            worst = qMax(worst, fabs(magnitude.at(i,j) - reference.at(i,j)));
+            if(direction.at(i,j) != bins.at(i,j)) directionDiffs++;
+        }
+    bool ok = worst < 1e-12 && directionDiffs < (quint64)w * h / 10000 + 1;
+    printf("%-8s %9.1f ms %9.1f ms %8.2fx %12.2g %10llu %5s\n", name, tg * 1e3, tf * 1e3, tg / tf, worst,
+           (unsigned long long)directionDiffs, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+template<typename S> static bool compareFixed(const char * name, CImage& image, CMatrix<short>& levels, CMatD& same)
+{
+    uint h = levels.mHeight, w = levels.mWidth;
+    CMatD magnitude(h, w);
+    CMatrix<short> fixedMagnitude(h, w);
+    CMatrix<uchar> direction(h, w), fixedDirection(h, w);
+    double td = benchBest([&]() { image.gradient<S>(same, magnitude, direction, 0, h); }, 3);
+    double tx = benchBest([&]() { image.gradient<S>(levels, fixedMagnitude, fixedDirection, 0, h); }, 3);
+
+    double worst = 0;
+    quint64 directionDiffs = 0;
+    for(uint i = 0; i < h; i++)
+        for(uint j = 0; j < w; j++) {
+            worst = qMax(worst, fabs(fixedMagnitude.at(i,j) / 4096. - magnitude.at(i,j)));
+            if(direction.at(i,j) != fixedDirection.at(i,j)) directionDiffs++;
+        }
+    bool ok = worst <= 0.5 / 4096 + 1e-12 && directionDiffs == 0;
+    printf("%-8s %9.1f ms %9.1f ms %12.2g %10llu %5s\n", name, td * 1e3, tx * 1e3, worst,
+           (unsigned long long)directionDiffs, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int benchStencil(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    bool ok = true;
+
+    CImage image(w, h);
+    image.setThreadCount(1);
+    CMatD blurred(h, w);
+    benchFillRandom(blurred);
+
+    printf("Gradient stencils, %u x %u, 1 thread\n", w, h);
+    printf("%-8s %12s %12s %9s %12s %10s %5s\n", "stencil", "generic", "fused", "speedup", "max |diff|", "dir diffs", "");
+    ok = compareStencil<CPrewitt>("prewitt", image, blurred) && ok;
+    ok = compareStencil<CSobel>("sobel", image, blurred) && ok;
+    ok = compareStencil<CScharr>("scharr", image, blurred) && ok;
+
+    /* Fixed point against double on full-range steps, where the sums are largest: magnitudes
+     * must agree to the fixed-point rounding, so an overflow cannot hide */
+    CMatrix<short> levels(h, w);
+    CMatD same(h, w);
+    srand(3);
+    for(uint i = 0; i < h; i++)
+        for(uint j = 0; j < w; j++) {
+            levels.at(i,j) = rand() % 2 ? 4080 : 0;
+            same.at(i,j) = levels.at(i,j) / 4096.;
+        }
+    printf("\nFixed point vs double, steps of 0 and 255 levels\n");
+    printf("%-8s %12s %12s %12s %10s %5s\n", "stencil", "double", "fixed", "max |diff|", "dir diffs", "");
+    ok = compareFixed<CPrewitt>("prewitt", image, levels, same) && ok;
+    ok = compareFixed<CSobel>("sobel", image, levels, same) && ok;
+    ok = compareFixed<CScharr>("scharr", image, levels, same) && ok;
+
+    // canny() as a whole, by operator and precision
+    QImage scene = benchScene(BenchShapes, w, h);
+    const char * names[] = { "prewitt", "sobel", "scharr" };
+    printf("\ncanny(), sigma 1, 1 thread\n");
+    printf("%-8s %12s %12s %12s\n", "operator", "double", "float", "fixed");
+    for(int op = 0; op < 3; op++) {
+        CImage detector(scene);
+        detector.setThreadCount(1);
+        double t[3];
+        for(int p = 0; p < 3; p++)
+            t[p] = benchBest([&]() { detector.canny(1, true, true, true, (CImage::Precision)p, (CImage::Operator)op); }, 3);
+        printf("%-8s %9.1f ms %9.1f ms %9.1f ms\n", names[op], t[0] * 1e3, t[1] * 1e3, t[2] * 1e3);
+    }
+    return ok ? 0 : 1;
+}
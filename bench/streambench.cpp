@@ -0,0 +1,68 @@
+#include "bench.h"
+#include "CFrameStream.h"
+#include <QThread>
+
+/* Sustained frames per second on a synthetic video at 1080p and 4K: a CImage reused for every
+ * frame (canny() then hysteresis()) against a CFrameStream, whose two stages overlap. The
+ * sequential loop gets as many threads as the stream's two stages together. Every streamed
+ * edge map is compared with the sequential one of the same frame. */
+
+#define STREAM_BENCH_DISTINCT 4
+
+int benchStream(int argc, char ** argv)
+{
+    uint frames = argc > 0 ? atoi(argv[0]) : 40;
+    double sigma = argc > 1 ? atof(argv[1]) : 2;
+    uint ideal = qMax(1, QThread::idealThreadCount());
+    const uint sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+    printf("Frame loop, %u frames, sigma %.1f, double precision\n", frames, sigma);
+    printf("%-10s %8s %14s %14s %9s %13s %10s\n", "size", "threads", "sequential", "stream", "speedup", "mean latency", "identical");
+    bool allIdentical = true;
+    for(uint r = 0; r < 2; r++) {
+        uint w = sizes[r][0], h = sizes[r][1];
+        QImage input[STREAM_BENCH_DISTINCT];
+        for(uint f = 0; f < STREAM_BENCH_DISTINCT; f++)
+            input[f] = benchScene(BenchBlocks, w, h, 130, f);
+
+        for(uint perStage = 1; perStage <= qMax(1u, ideal / 2); perStage *= 2) {
+            CImage image(w, h);
+            image.setThreadCount(2 * perStage);
+            CMatrix<uchar> * reference[STREAM_BENCH_DISTINCT];
+            QElapsedTimer timer;
+            timer.start();
+            for(uint f = 0; f < frames; f++) {
+                *image.mImage = input[f % STREAM_BENCH_DISTINCT];
+                image.canny(sigma, true, true, true);
+                CMatrix<uchar> * edges = image.hysteresis(*image.mSuppressed, 0.007, 0.099);
+                if(f < STREAM_BENCH_DISTINCT) reference[f] = edges;
+                else delete edges;
+            }
+            double sequential = timer.nsecsElapsed() / 1e9;
+
+            CStreamOptions options;
+            options.sigma = sigma;
+            options.threadsPerStage = perStage;
+            CFrameStream stream(options);
+            bool identical = true;
+            double latency = 0;
+            stream.mOnFrame = [&](const CStreamFrame& frame) {
+                CMatrix<uchar>& expected = *reference[frame.index % STREAM_BENCH_DISTINCT];
+                for(uint i = 0; i < h && identical; i++)
+                    identical = memcmp(frame.edges->row(i), expected.row(i), w) == 0;
+                latency += frame.latencySeconds;
+            };
+            for(uint f = 0; f < frames; f++)
+                stream.push(input[f % STREAM_BENCH_DISTINCT]);
+            stream.finish();
+            allIdentical = allIdentical && identical;
+
+            printf("%4ux%-5u %4u+%-3u %10.1f fps %10.1f fps %8.2fx %10.1f ms %10s\n", w, h, perStage, perStage,
+                   frames / sequential, stream.framesPerSecond(), stream.framesPerSecond() * sequential / frames,
+                   latency / frames * 1e3, identical ? "yes" : "NO");
+            for(uint f = 0; f < STREAM_BENCH_DISTINCT && f < frames; f++)
+                delete reference[f];
+        }
+    }
+    return allIdentical ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#include "bench.h"
+#include "CImage.h"
+#include <QThread>
+
+/* Thread scaling of CImage::canny: runs the same frame at 1, 2, 4, 8, ... threads, reports
+ * the speedup over one thread and checks that every run is bit-identical to the serial one. */
+
+int benchThreads(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 3840;
+    uint h = argc > 1 ? atoi(argv[1]) : 2160;
+    uint maxThreads = argc > 2 ? atoi(argv[2]) : qMax(1, QThread::idealThreadCount());
+    double sigma = argc > 3 ? atof(argv[3]) : 2;
+
+    QImage scene = benchScene(BenchBlocks, w, h, 140);
+    CImage reference(scene);
+    reference.setThreadCount(1);
+    double serial = benchBest([&]() {
+        *reference.mImage = scene;
+        reference.canny(sigma, true, true, true);
+    }, 3);
+
+    printf("CImage::canny, %u x %u, sigma %.1f\n", w, h, sigma);
+    printf("%8s %12s %9s %10s\n", "threads", "time", "speedup", "identical");
+    printf("%8u %9.1f ms %8.2fx %10s\n", 1u, serial*1e3, 1., "yes");
+
+    bool allIdentical = true;
+    for(uint threads = 2; threads <= maxThreads; threads *= 2) {
+        CImage image(scene);
+        image.setThreadCount(threads);
+        double t = benchBest([&]() {
+            *image.mImage = scene;
+            image.canny(sigma, true, true, true);
+        }, 3);
+
+        bool identical = true;
+        for(uint i = 0; i < h && identical; i++)
+            identical = memcmp(image.mSuppressed->row(i), reference.mSuppressed->row(i), w * sizeof(double)) == 0;
+        allIdentical = allIdentical && identical;
+
+        printf("%8u %9.1f ms %8.2fx %10s\n", threads, t*1e3, serial/t, identical ? "yes" : "NO");
+    }
+    return allIdentical ? 0 : 1;
+}
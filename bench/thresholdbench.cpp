@@ -0,0 +1,78 @@
+#include "bench.h"
+#include "CImage.h"
+#include <algorithm>
+#include <vector>
+
+/* Automatic hysteresis thresholds. Runs canny() on the same scene at several contrasts and
+ * prints, per rule, the thresholds it picks and the share of pixels that end up as edges,
+ * next to the fixed GUI defaults. Checks the histogram percentile against an exact one
+ * taken by sorting the candidates, and times suppression with and without the histogram. */
+
+static double edgeShare(CImage& image, double low, double high)
+{
+    CMatrix<uchar> * edges = image.hysteresis(*image.mSuppressed, low, high);
+    quint64 n = 0;
+    for(uint i = 0; i < edges->mHeight; i++)
+        for(uint j = 0; j < edges->mWidth; j++)
+            n += edges->at(i,j);
+    delete edges;
+    return 100. * n / ((double)image.mWidth * image.mHeight);
+}
+
+int benchThresholds(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    const int contrasts[] = { 16, 64, 200 };
+    bool ok = true;
+
+    printf("Thresholds on a %u x %u scene at three contrasts, sigma 1.5\n", w, h);
+    printf("%9s %-11s %9s %9s %8s\n", "contrast", "rule", "low", "high", "edges");
+    for(int c = 0; c < 3; c++) {
+        CImage image(benchScene(BenchBlocks, w, h, contrasts[c]));
+        image.canny(1.5, true, true, true);
+
+        double low = 0.007, high = 0.099;
+        printf("%9d %-11s %9.4f %9.4f %7.2f%%\n", contrasts[c], "fixed", low, high, edgeShare(image, low, high));
+        image.autoThresholds(CMagnitudeHistogram::RulePercentile, low, high);
+        printf("%9s %-11s %9.4f %9.4f %7.2f%%\n", "", "percentile", low, high, edgeShare(image, low, high));
+        image.autoThresholds(CMagnitudeHistogram::RuleOtsu, low, high);
+        printf("%9s %-11s %9.4f %9.4f %7.2f%%\n", "", "otsu", low, high, edgeShare(image, low, high));
+
+        // The exact 80th percentile of the candidates must fall inside the bin the histogram returns
+        std::vector<double> candidates;
+        for(uint i = 0; i < h; i++)
+            for(uint j = 0; j < w; j++)
+                if(image.mSuppressed->at(i,j) > 0) candidates.push_back(image.mSuppressed->at(i,j));
+        std::sort(candidates.begin(), candidates.end());
+        double exact = candidates[qMax(1, (int)ceil(0.8 * candidates.size())) - 1];
+        double binned = image.mHistogram->percentile(0.8);
+        bool inBin = candidates.size() == image.mHistogram->mCandidates &&
+                     exact <= binned && exact > binned - 1. / CHISTOGRAM_BINS_PER_UNIT;
+        ok = ok && inBin;
+        printf("%9s %-11s %9s %9.4f %8s  exact %.4f, %s\n", "", "p80 check", "", binned, "", exact, inBin ? "ok" : "WRONG");
+    }
+
+    // Cost of counting, on the stage it rides on
+    CImage image(benchScene(BenchBlocks, w, h, 64));
+    image.setThreadCount(1);
+    image.canny(1.5, true, true, true);
+    CMatD grad(h, w), out(h, w);
+    CMatrix<uchar> direction(h, w);
+    benchFillRandom(grad);
+    for(uint i = 0; i < h; i++)
+        for(uint j = 0; j < w; j++)
+            direction.at(i,j) = 1 + (i + j) % 4;
+    CMagnitudeHistogram histogram;
+    double plain = benchBest([&]() {
+        image.mWorkspace->beginFrame();
+        image.suppression(out, grad, direction, 0, h);
+    });
+    double counted = benchBest([&]() {
+        image.mWorkspace->beginFrame();
+        histogram.clear();
+        image.suppression(out, grad, direction, 0, h, &histogram);
+    });
+    printf("\nsuppression %.2f ms, with histogram %.2f ms (+%.1f%%)\n", plain*1e3, counted*1e3, 100 * (counted/plain - 1));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include "bench.h"
+#include "CImage.h"
+
+/* Steady-state allocations of CImage::canny: every frame after the first few must be served
+ * entirely from the CCannyWorkspace. Counts heap allocations by interposing malloc and
+ * friends (glibc only), which also catches operator new, qMallocAligned and QImage buffers.
+ * Also times a reused CImage against a fresh one per frame. Exits non-zero if a steady-state
+ * frame allocated. Runs on one thread: QThreadPool itself allocates when it dispatches. */
+
+#ifdef __GLIBC__
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * p, size_t size);
+extern "C" void * __libc_memalign(size_t alignment, size_t size);
+
+static QAtomicInt gAllocations;
+
+extern "C" void * malloc(size_t size) { gAllocations.fetchAndAddRelaxed(1); return __libc_malloc(size); }
+extern "C" void * calloc(size_t count, size_t size) { gAllocations.fetchAndAddRelaxed(1); return __libc_calloc(count, size); }
+extern "C" void * realloc(void * p, size_t size) { gAllocations.fetchAndAddRelaxed(1); return __libc_realloc(p, size); }
+extern "C" void * memalign(size_t alignment, size_t size) { gAllocations.fetchAndAddRelaxed(1); return __libc_memalign(alignment, size); }
+extern "C" void * aligned_alloc(size_t alignment, size_t size) { gAllocations.fetchAndAddRelaxed(1); return __libc_memalign(alignment, size); }
+extern "C" int posix_memalign(void ** p, size_t alignment, size_t size)
+{
+    gAllocations.fetchAndAddRelaxed(1);
+    *p = __libc_memalign(alignment, size);
+    return *p ? 0 : 12;     // ENOMEM
+}
+
+static int allocations() { return gAllocations.loadAcquire(); }
+#else
+static int allocations() { return -1; }
+#endif
+
+// Copies the next frame's pixels into an image of the same size and format, without allocating
+static void loadFrame(QImage * target, const QImage& frame)
+{
+    for(int y = 0; y < frame.height(); y++)
+        memcpy(target->scanLine(y), frame.constScanLine(y), frame.bytesPerLine());
+}
+
+int benchWorkspace(int argc, char ** argv)
+{
+    uint w = argc > 0 ? atoi(argv[0]) : 1920;
+    uint h = argc > 1 ? atoi(argv[1]) : 1080;
+    const int warmup = 3, frames = 10;
+    const CImage::Precision precisions[] = { CImage::PrecisionDouble, CImage::PrecisionFloat, CImage::PrecisionFixed };
+    const char * names[] = { "double", "float", "fixed" };
+
+    QImage frame(w, h, QImage::Format_Grayscale8);
+    for(uint y = 0; y < h; y++)
+        for(uint x = 0; x < w; x++)
+            frame.scanLine(y)[x] = benchSceneLevel(BenchBlocks, x, y, w, h);
+
+    printf("CImage::canny frame loop, %u x %u, sigma 2, 1 thread, %d frames after %d warm-up\n", w, h, frames, warmup);
+    printf("%-7s %14s %12s %12s %9s %12s\n", "type", "allocs/frame", "reused", "fresh", "speedup", "workspace");
+    bool ok = true;
+    for(uint p = 0; p < 3; p++) {
+        CImage image(frame);
+        image.setThreadCount(1);
+        for(int f = 0; f < warmup; f++) {
+            loadFrame(image.mImage, frame);
+            image.canny(2, true, true, true, precisions[p]);
+        }
+
+        int before = allocations();
+        QElapsedTimer timer;
+        timer.start();
+        for(int f = 0; f < frames; f++) {
+            loadFrame(image.mImage, frame);
+            image.canny(2, true, true, true, precisions[p]);
+        }
+        double reused = timer.nsecsElapsed() / 1e9 / frames;
+        int steady = allocations() - before;
+        if(steady != 0) ok = false;
+
+        timer.start();
+        for(int f = 0; f < frames; f++) {
+            CImage fresh(frame);
+            fresh.setThreadCount(1);
+            fresh.canny(2, true, true, true, precisions[p]);
+        }
+        double fresh = timer.nsecsElapsed() / 1e9 / frames;
+
+        printf("%-7s %14.1f %9.2f ms %9.2f ms %8.2fx %9.1f MB\n", names[p], steady < 0 ? -1. : (double)steady / frames,
+               reused*1e3, fresh*1e3, fresh/reused, image.mWorkspace->mCapacity / (1024. * 1024.));
+    }
+    if(allocations() < 0) printf("allocation counting needs glibc; not checked\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Headless batch edge detection.
+# Usage: CannyBatch [options] <file|directory>...
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+CONFIG += console
+CONFIG -= app_bundle
+
+TARGET = CannyBatch
+TEMPLATE = app
+
+include(../engine.pri)
+
+SOURCES += main.cpp
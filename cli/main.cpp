@@ -0,0 +1,255 @@
+#include "CBatchPipeline.h"
+#include "CStripCanny.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <cstdio>
+
+static QStringList readList(QString path)
+{
+    QStringList files;
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) return files;
+    while(!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if(!line.isEmpty()) files.append(line);
+    }
+    return files;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CannyBatch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Canny edge detection over files and directories, without a GUI.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Image files or directories of images.", "<file|directory>...");
+
+    QCommandLineOption listOption(QStringList() << "l" << "list", "Read input paths from <file>, one per line.", "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write edge maps into <dir>, named after each input without its suffix,\n"
+                                    "so inputs need distinct base names. Without it nothing is written.", "dir");
+    QCommandLineOption formatOption("format", "Output image format (default png); pgm is written through a memory mapping,\n"
+                                    "edges as compact 8-connected chains with gradient directions.", "suffix", "png");
+    QCommandLineOption dumpOption("dump-suppressed", "Also write each image's suppressed magnitudes as <name>_suppressed.cmat,\n"
+                                  "a raw matrix dump that can be mapped back without decoding.");
+    QCommandLineOption sigmaOption(QStringList() << "s" << "sigma", "Gaussian blur sigma (default 1).", "sigma", "1");
+    QCommandLineOption channelsOption(QStringList() << "c" << "channels", "Channels to use, any of r, g, b (default rgb).", "mask", "rgb");
+    QCommandLineOption lowOption("low", "Low hysteresis threshold (default 0.007).", "value", "0.007");
+    QCommandLineOption highOption("high", "High hysteresis threshold (default 0.099).", "value", "0.099");
+    QCommandLineOption thresholdsOption("thresholds", "Hysteresis thresholds: manual (--low and --high), percentile or otsu,\n"
+                                        "the last two from each image's magnitude histogram (default manual).", "rule", "manual");
+    QCommandLineOption percentileOption("high-percentile", "Edge candidates below the high threshold, for --thresholds percentile (default 0.8).", "p", "0.8");
+    QCommandLineOption ratioOption("low-ratio", "Low threshold as a fraction of the high one, for automatic thresholds (default 0.4).", "r", "0.4");
+    QCommandLineOption precisionOption(QStringList() << "p" << "precision", "Working type: double, float or fixed (default double).", "type", "double");
+    QCommandLineOption operatorOption("operator", "Gradient stencil: prewitt, sobel or scharr (default prewitt).", "name", "prewitt");
+    QCommandLineOption pyramidOption("pyramid", "Coarse-to-fine detection for large sigmas, in double precision with Prewitt;\n"
+                                    "not with --precision float|fixed or --operator sobel|scharr.");
+    QCommandLineOption stripsOption("out-of-core", "Stream each image through in strips of <rows> rows and write a PGM edge map,\n"
+                                    "in memory bounded by the strip; needs --output. Binary PGM/PPM inputs are read incrementally.\n"
+                                    "Manual thresholds, double precision and Prewitt only: not with automatic --thresholds,\n"
+                                    "--precision, --operator, --pyramid, --format other than pgm, --dump-suppressed or --cache.", "rows");
+    QCommandLineOption cacheOption("cache", "Keep each image's suppressed magnitudes in <dir>, keyed by file contents, sigma,\n"
+                                   "channels, precision and operator; a later run with the same ones goes straight to hysteresis.", "dir");
+    QCommandLineOption cacheSizeOption("cache-size", "Disk space for --cache, least recently used entries evicted first (default 1024).", "MB", "1024");
+    QCommandLineOption workersOption(QStringList() << "j" << "workers", "Images processed concurrently (default: one per core).", "n");
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads-per-image", "Threads inside each image (default 1).", "n", "1");
+    QCommandLineOption profileOption("profile", "Write per-stage latency statistics to <file>: CSV for a .csv name, JSON otherwise.", "file");
+    QCommandLineOption queueOption(QStringList() << "q" << "queue", "Frames buffered between stages (default 4).", "n", "4");
+    parser.addOption(listOption);
+    parser.addOption(outputOption);
+    parser.addOption(formatOption);
+    parser.addOption(dumpOption);
+    parser.addOption(sigmaOption);
+    parser.addOption(channelsOption);
+    parser.addOption(lowOption);
+    parser.addOption(highOption);
+    parser.addOption(thresholdsOption);
+    parser.addOption(percentileOption);
+    parser.addOption(ratioOption);
+    parser.addOption(precisionOption);
+    parser.addOption(operatorOption);
+    parser.addOption(pyramidOption);
+    parser.addOption(stripsOption);
+    parser.addOption(cacheOption);
+    parser.addOption(cacheSizeOption);
+    parser.addOption(workersOption);
+    parser.addOption(threadsOption);
+    parser.addOption(queueOption);
+    parser.addOption(profileOption);
+    parser.process(app);
+
+    CBatchOptions options;
+    QString channels = parser.value(channelsOption).toLower();
+    options.useR = channels.contains('r');
+    options.useG = channels.contains('g');
+    options.useB = channels.contains('b');
+    options.sigma = parser.value(sigmaOption).toDouble();
+    options.thresholdLow = parser.value(lowOption).toDouble();
+    options.thresholdHigh = parser.value(highOption).toDouble();
+    QString rule = parser.value(thresholdsOption).toLower();
+    options.autoThresholds = rule != "manual";
+    if(rule == "otsu") options.thresholdRule = CMagnitudeHistogram::RuleOtsu;
+    else if(rule != "percentile" && rule != "manual") {
+        fprintf(stderr, "Unknown threshold rule '%s'. See --help.\n", qPrintable(rule));
+        return 2;
+    }
+    options.highPercentile = parser.value(percentileOption).toDouble();
+    options.lowRatio = parser.value(ratioOption).toDouble();
+    QString precision = parser.value(precisionOption).toLower();
+    if(precision == "float") options.precision = CImage::PrecisionFloat;
+    else if(precision == "fixed") options.precision = CImage::PrecisionFixed;
+    else if(precision != "double") {
+        fprintf(stderr, "Unknown precision '%s'. See --help.\n", qPrintable(precision));
+        return 2;
+    }
+    QString op = parser.value(operatorOption).toLower();
+    if(op == "sobel") options.gradientOperator = CImage::OperatorSobel;
+    else if(op == "scharr") options.gradientOperator = CImage::OperatorScharr;
+    else if(op != "prewitt") {
+        fprintf(stderr, "Unknown operator '%s'. See --help.\n", qPrintable(op));
+        return 2;
+    }
+    options.pyramid = parser.isSet(pyramidOption);
+    if(options.pyramid && (options.precision != CImage::PrecisionDouble || options.gradientOperator != CImage::OperatorPrewitt)) {
+        fprintf(stderr, "--pyramid runs in double precision with Prewitt only; drop --precision and --operator.\n");
+        return 2;
+    }
+    if(parser.isSet(workersOption)) options.workers = qMax(1u, parser.value(workersOption).toUInt());
+    options.threadsPerImage = qMax(1u, parser.value(threadsOption).toUInt());
+    options.queueDepth = qMax(1u, parser.value(queueOption).toUInt());
+    options.outputDir = parser.value(outputOption);
+    options.outputFormat = parser.value(formatOption);
+    options.dumpSuppressed = parser.isSet(dumpOption);
+
+    QStringList inputs = parser.positionalArguments();
+    if(parser.isSet(listOption)) inputs.append(readList(parser.value(listOption)));
+    QStringList files = CBatchPipeline::expandInputs(inputs);
+    if(files.isEmpty()) {
+        fprintf(stderr, "No input images. See --help.\n");
+        return 2;
+    }
+
+    QMap<QString, QString> clashes = CBatchPipeline::outputClashes(files);
+    if(!options.outputDir.isEmpty() && !clashes.isEmpty()) {
+        for(QMap<QString, QString>::iterator c = clashes.begin(); c != clashes.end(); ++c)
+            fprintf(stderr, "%s would overwrite the output of %s.\n", qPrintable(c.key()), qPrintable(c.value()));
+        fprintf(stderr, "Inputs need distinct base names with --output.\n");
+        return 2;
+    }
+
+    CProfiler profiler;
+    if(parser.isSet(profileOption)) options.profiler = &profiler;
+
+    QTextStream out(stdout);
+    if(parser.isSet(stripsOption)) {
+        if(options.outputDir.isEmpty()) {
+            fprintf(stderr, "--out-of-core needs --output.\n");
+            return 2;
+        }
+        // CStripCanny has manual thresholds, double precision and Prewitt only, and writes PGM
+        QStringList unsupported;
+        if(options.autoThresholds) unsupported << "--thresholds " + rule;
+        if(options.precision != CImage::PrecisionDouble) unsupported << "--precision " + precision;
+        if(options.gradientOperator != CImage::OperatorPrewitt) unsupported << "--operator " + op;
+        if(options.pyramid) unsupported << "--pyramid";
+        if(parser.isSet(formatOption) && options.outputFormat.toLower() != "pgm") unsupported << "--format " + options.outputFormat;
+        if(options.dumpSuppressed) unsupported << "--dump-suppressed";
+        if(parser.isSet(cacheOption)) unsupported << "--cache";
+        if(!unsupported.isEmpty()) {
+            fprintf(stderr, "--out-of-core does not support %s.\n", qPrintable(unsupported.join(", ")));
+            return 2;
+        }
+        QDir().mkpath(options.outputDir);
+        CStripOptions stripOptions;
+        stripOptions.sigma = options.sigma;
+        stripOptions.useR = options.useR;
+        stripOptions.useG = options.useG;
+        stripOptions.useB = options.useB;
+        stripOptions.thresholdLow = options.thresholdLow;
+        stripOptions.thresholdHigh = options.thresholdHigh;
+        stripOptions.stripRows = qMax(1u, parser.value(stripsOption).toUInt());
+        stripOptions.threads = options.threadsPerImage;
+        stripOptions.tempDir = options.outputDir;
+        stripOptions.profiler = options.profiler;
+        CStripCanny strips(stripOptions);
+        uint ok = 0;
+        for(int i = 0; i < files.size(); i++) {
+            QString target = QDir(options.outputDir).filePath(CBatchPipeline::outputName(files[i]) + "_edges.pgm");
+            if(!strips.run(files[i], target)) {
+                out << "FAILED " << files[i] << ": " << strips.mError << "\n";
+            } else {
+                ok++;
+                out << files[i] << "  " << strips.mWidth << "x" << strips.mHeight << "  " << strips.mStrips << " strips"
+                    << "  " << QString::number(strips.mSeconds, 'f', 2) << " s"
+                    << "  window " << QString::number(strips.mWindowBytes / 1048576., 'f', 1) << " MB"
+                    << "  tables " << QString::number(strips.mTableBytes / 1048576., 'f', 1) << " MB"
+                    << "  run file " << QString::number(strips.mTempBytes / 1048576., 'f', 1) << " MB\n";
+            }
+            out.flush();
+        }
+        if(options.profiler && !profiler.save(parser.value(profileOption))) {
+            fprintf(stderr, "Could not write %s\n", qPrintable(parser.value(profileOption)));
+            return 1;
+        }
+        return ok == (uint)files.size() ? 0 : 1;
+    }
+
+    CSuppressedCache * cache = 0;
+    if(parser.isSet(cacheOption)) {
+        cache = new CSuppressedCache(parser.value(cacheOption), parser.value(cacheSizeOption).toLongLong() << 20);
+        options.cache = cache;
+    }
+    CBatchPipeline pipeline(options);
+    pipeline.mOnImageDone = [&](const CBatchImageStats& s) {
+        if(!s.ok) {
+            out << "FAILED " << s.path << ": " << s.error << "\n";
+        } else {
+            out << s.path << "  " << s.width << "x" << s.height
+                << "  decode " << QString::number(s.decodeSeconds * 1e3, 'f', 1) << " ms"
+                << "  compute " << QString::number(s.computeSeconds * 1e3, 'f', 1) << " ms"
+                << "  encode " << QString::number(s.encodeSeconds * 1e3, 'f', 1) << " ms"
+                << "  " << QString::number(s.megapixels() / s.computeSeconds, 'f', 2) << " MP/s";
+            if(s.cached)
+                out << "  cached";
+            if(options.autoThresholds)
+                out << "  thresholds " << QString::number(s.thresholdLow, 'f', 4) << " " << QString::number(s.thresholdHigh, 'f', 4);
+            out << "\n";
+        }
+        out.flush();
+    };
+    pipeline.run(files);
+
+    uint ok = pipeline.succeeded();
+    out << "\n" << ok << " of " << files.size() << " images in "
+        << QString::number(pipeline.mWallSeconds, 'f', 2) << " s: "
+        << QString::number(ok / pipeline.mWallSeconds, 'f', 2) << " images/s, "
+        << QString::number(pipeline.megapixels() / pipeline.mWallSeconds, 'f', 2) << " MP/s ("
+        << options.workers << " workers, " << options.threadsPerImage << " threads per image)\n";
+    if(cache) {
+        out << "Cache: " << cache->summary() << "\n";
+        delete cache;
+    }
+
+    if(options.profiler) {
+        QVector<CStageStats> stages = profiler.stages();
+        out << "\n" << QString("%1 %2 %3 %4 %5\n").arg("stage", -20).arg("count", 7).arg("p50 ms", 10).arg("p99 ms", 10).arg("MP/s", 9);
+        for(int i = 0; i < stages.size(); i++) {
+            const CStageStats& s = stages[i];
+            out << QString("%1 %2 %3 %4 %5\n").arg(s.mStage, -20).arg(s.mCount, 7)
+                   .arg(s.percentile(0.5) / 1e6, 10, 'f', 2).arg(s.percentile(0.99) / 1e6, 10, 'f', 2)
+                   .arg(s.mTotalNs > 0 ? s.mPixels * 1e3 / s.mTotalNs : 0., 9, 'f', 1);
+        }
+        if(!profiler.save(parser.value(profileOption))) {
+            fprintf(stderr, "Could not write %s\n", qPrintable(parser.value(profileOption)));
+            return 1;
+        }
+    }
+
+    return ok == (uint)files.size() ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+# Edge detection engine, shared by the GUI and the tools in the subdirectories.
+
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += $$PWD/CImage.cpp \
+    $$PWD/CBatchPipeline.cpp \
+    $$PWD/CCannyWorkspace.cpp \
+    $$PWD/CComponentTracker.cpp \
+    $$PWD/CEdgeTracker.cpp \
+    $$PWD/CFrameStream.cpp \
+    $$PWD/CHysteresisIndex.cpp \
+    $$PWD/CImageBatch.cpp \
+    $$PWD/CMagnitudeHistogram.cpp \
+    $$PWD/CMappedFile.cpp \
+    $$PWD/CNetpbm.cpp \
+    $$PWD/CProfiler.cpp \
+    $$PWD/CSimd.cpp \
+    $$PWD/CSparseEdges.cpp \
+    $$PWD/CStripCanny.cpp \
+    $$PWD/CSuppressedCache.cpp
+
+HEADERS += $$PWD/CImage.h \
+    $$PWD/CBatchPipeline.h \
+    $$PWD/CBoundedQueue.h \
+    $$PWD/CCannyWorkspace.h \
+    $$PWD/CComponentTracker.h \
+    $$PWD/CEdgeTracker.h \
+    $$PWD/CFrameStream.h \
+    $$PWD/CHysteresisIndex.h \
+    $$PWD/CImageBatch.h \
+    $$PWD/CMagnitudeHistogram.h \
+    $$PWD/CMappedFile.h \
+    $$PWD/CMatrix.h \
+    $$PWD/CNetpbm.h \
+    $$PWD/CParallel.h \
+    $$PWD/CProfiler.h \
+    $$PWD/CSimd.h \
+    $$PWD/CSparseEdges.h \
+    $$PWD/CStencil.h \
+    $$PWD/CStripCanny.h \
+    $$PWD/CSuppressedCache.h \
+    $$PWD/globals.h
@@ -3,19 +3,22 @@
 
 typedef unsigned int uint;
 
+#include <QtGlobal>
 #include <QDebug>
 
 #include <QImage>
 #include <QString>
-#include <QMessageBox>
 #include <QTime>
 
 #include <cmath>
+#include <cstring>
 #include <queue>
 
 using std::queue;
 using std::pair;
 
+#include "CSimd.h"
 #include "CMatrix.h"
+#include "CParallel.h"
 
 #endif // GLOBALS_H
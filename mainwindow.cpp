@@ -1,14 +1,24 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <QFileDialog>
+#include <QMessageBox>
+#include <QProgressBar>
+#include <QStandardPaths>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
+    mCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/suppressed"),
     ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
-    mPicture = 0;
     mCurrentPath = "";
+    mWorker = new CCannyWorker(&mCache);
+
+    mProgress = new QProgressBar();
+    mProgress->setRange(0, 100);
+    mProgress->setMaximumWidth(200);
+    mProgress->hide();
+    ui->statusBar->addPermanentWidget(mProgress);
 
     //ui->scrollArea->setWidgetResizable(true);
     //ui->lblImage->setScaledContents(true);
@@ -33,10 +43,17 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->spinHysteresisLow, SIGNAL(editingFinished()), SLOT(slotUpdateFromSpins()));
     connect(ui->spinHysteresisHigh, SIGNAL(editingFinished()), SLOT(slotUpdateFromSpins()));
     connect(ui->cmdDefault,SIGNAL(clicked()),this, SLOT(slotCannyDefault()));
+    connect(ui->comboThresholds, SIGNAL(currentIndexChanged(int)), SLOT(slotAutoThresholds()));
+
+    // Worker, from its own thread
+    connect(mWorker, SIGNAL(loaded(QImage)), SLOT(slotLoaded(QImage)));
+    connect(mWorker, SIGNAL(resultReady(QImage,double,double,bool)), SLOT(slotResult(QImage,double,double,bool)));
+    connect(mWorker, SIGNAL(progress(int,QString)), SLOT(slotProgress(int,QString)));
 }
 
 MainWindow::~MainWindow()
 {
+    delete mWorker;
     delete ui;
 }
 
@@ -48,9 +65,6 @@ void MainWindow::resizeEvent(QResizeEvent * e)
 
 void MainWindow::slotLoad(QString path)
 {
-    if(mPicture != 0)
-        delete mPicture;
-
     if(path == "")
         mCurrentPath = QFileDialog::getOpenFileName(this, "Please select an image...", ".", "Images (*.png *.bmp *.gif *.xpm *.jpg)");
     else
@@ -58,7 +72,15 @@ void MainWindow::slotLoad(QString path)
 
     if(mCurrentPath == "") return;
 
-    mPicture = new CImage(mCurrentPath);
+    mWorker->load(mCurrentPath);
+}
+
+void MainWindow::slotLoaded(QImage original)
+{
+    if(original.isNull())
+        QMessageBox::critical(this, "Oops", "Couldn't load that, sorry!");
+    mOriginal = original;
+    mResult = original;
     redisplay();
 }
 
@@ -69,24 +91,20 @@ void MainWindow::slotReload()
 
 void MainWindow::slotSave()
 {
-    bool fail = (mPicture == 0);
-    if(!fail)
-        if(mPicture->mImage->isNull())
-            fail = true;
-    if(fail) {
+    if(mResult.isNull()) {
         QMessageBox::critical(this, "Error", "No file to save!");
         return;
     }
 
     QString path = QFileDialog::getSaveFileName(this, "Please select a path to save to...", "out.jpg", "*.jpg");
-    mPicture->mImage->save(path);
+    mResult.save(path);
 }
 
 void MainWindow::slotCanny()
 {
-    if(mPicture == 0) return;
+    if(mCurrentPath == "") return;
 
-    mPicture->canny(
+    mWorker->canny(
                 ui->spinBlurSigma->value(),
                 ui->chkR->isChecked(),
                 ui->chkG->isChecked(),
@@ -94,15 +112,17 @@ void MainWindow::slotCanny()
 
     if(ui->cmdShowOriginal->isChecked())
         ui->cmdShowOriginal->setChecked(false);
+    else if(ui->comboThresholds->currentIndex() > 0)
+        slotAutoThresholds();
     else
         slotUpdate();
 }
 
 void MainWindow::slotCannyDefault()
 {
-    if(mPicture == 0) return;
+    if(mCurrentPath == "") return;
 
-    mPicture->canny(
+    mWorker->canny(
                 //blur sigma
                 1.000,
                 //R is checked
@@ -111,31 +131,24 @@ void MainWindow::slotCannyDefault()
                 true,
                 //B is checked
                 true);
+    if(ui->comboThresholds->currentIndex() > 0) {
+        slotAutoThresholds();
+        return;
+    }
     double low = 0.007;
     double high = 0.099;
 
-    mPicture->useHysteresis(low, high);
-
-    if(mPicture == 0) return;
-
-    if(ui->cmdShowOriginal->isChecked())
-        mDisplayImage = QPixmap::fromImage(*mPicture->mOriginalImage);
-    else
-        mDisplayImage = QPixmap::fromImage(*mPicture->mImage);
-    ui->lblImage->setPixmap(
-                mDisplayImage.scaled(ui->lblImage->size(),
-                                     Qt::KeepAspectRatio,
-                                     Qt::SmoothTransformation));
+    mWorker->showHysteresis(low, high);
 }
 
 void MainWindow::redisplay()
 {
-    if(mPicture == 0) return;
+    if(mOriginal.isNull()) return;
 
     if(ui->cmdShowOriginal->isChecked())
-        mDisplayImage = QPixmap::fromImage(*mPicture->mOriginalImage);
+        mDisplayImage = QPixmap::fromImage(mOriginal);
     else
-        mDisplayImage = QPixmap::fromImage(*mPicture->mImage);
+        mDisplayImage = QPixmap::fromImage(mResult);
     ui->lblImage->setPixmap(
                 mDisplayImage.scaled(ui->lblImage->size(),
                                      Qt::KeepAspectRatio,
@@ -154,14 +167,15 @@ void MainWindow::slotUpdate()
     ui->spinHysteresisHigh->setValue(high);
     ui->spinHysteresisLow->setValue(low);
 
-    if(mPicture == 0) return;
+    if(mCurrentPath == "") return;
 
+    // Only a request: the result comes back through slotResult()
     if(!ui->cmdShowOriginal->isChecked()) {
         if(ui->chkHysteresis->isChecked()) {
-            mPicture->useHysteresis(low, high);
+            mWorker->showHysteresis(low, high);
             qDebug()<<"Hysteresis "<<low<<" "<<high;
         } else{
-            mPicture->useSuppressed();
+            mWorker->showSuppressed();
             qDebug("supress");}
     }
 
@@ -173,3 +187,39 @@ void MainWindow::slotUpdateFromSpins()
     ui->sliderHysteresisLow->setValue(ui->spinHysteresisLow->value()*1000);
     ui->sliderHysteresisHigh->setValue(ui->spinHysteresisHigh->value()*1000);
 }
+
+// Asks for thresholds from the histogram of the last canny(); slotResult() sets the sliders
+void MainWindow::slotAutoThresholds()
+{
+    if(mCurrentPath == "" || ui->comboThresholds->currentIndex() == 0) return;
+
+    CMagnitudeHistogram::Rule rule = ui->comboThresholds->currentIndex() == 2 ? CMagnitudeHistogram::RuleOtsu
+                                                                              : CMagnitudeHistogram::RulePercentile;
+    mWorker->showAutoThresholds(rule);
+}
+
+void MainWindow::slotResult(QImage result, double low, double high, bool automatic)
+{
+    mResult = result;
+    if(automatic) {
+        ui->sliderHysteresisLow->setValue(qRound(low*1000));
+        ui->sliderHysteresisHigh->setValue(qRound(high*1000));
+        ui->spinHysteresisLow->setValue(low);
+        ui->spinHysteresisHigh->setValue(high);
+        ui->chkHysteresis->setChecked(true);
+    }
+
+    redisplay();
+}
+
+void MainWindow::slotProgress(int percent, QString stage)
+{
+    if(percent >= 100) {
+        mProgress->hide();
+        ui->statusBar->clearMessage();
+        return;
+    }
+    mProgress->setValue(percent);
+    mProgress->show();
+    ui->statusBar->showMessage(stage);
+}
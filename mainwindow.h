@@ -4,6 +4,10 @@
 #include <QMainWindow>
 #include "globals.h"
 #include "CImage.h"
+#include "CSuppressedCache.h"
+#include "CCannyWorker.h"
+
+class QProgressBar;
 
 namespace Ui {
 class MainWindow;
@@ -16,9 +20,12 @@ class MainWindow : public QMainWindow
 public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
-    CImage * mPicture;
     QPixmap mDisplayImage;
     QString mCurrentPath;
+    CSuppressedCache mCache;                // Re-running canny() with settings tried before skips to hysteresis
+    CCannyWorker * mWorker;                 // Does all the image work; the window only shows what it sends back
+    QImage mOriginal, mResult;              // The latest mWorker sent
+    QProgressBar * mProgress;               // Through canny(), in the status bar
 
     void redisplay();
 
@@ -32,6 +39,10 @@ protected slots:
     void slotUpdate();
     void slotUpdateFromSpins();
     void slotCannyDefault();
+    void slotAutoThresholds();
+    void slotLoaded(QImage original);
+    void slotResult(QImage result, double low, double high, bool automatic);
+    void slotProgress(int percent, QString stage);
 
 private:
     Ui::MainWindow *ui;